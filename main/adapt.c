@@ -0,0 +1,241 @@
+/**
+ * @file adapt.c
+ * @brief Adaptive sampling rate: sample fast while the signal moves, back off while it is quiet.
+ *
+ * A thermistor at room temperature drifts by a few tenths of a degree per
+ * hour, so at a fixed period most of its rows repeat the previous value,
+ * while a pot that is being turned is undersampled at the same period. The
+ * controller here looks at the change between consecutive samples:
+ *
+ *   |v - prev| > delta          -> period = min_us immediately
+ *   ADAPT_QUIET_RUN quiet rows  -> period *= 2, up to max_us
+ *
+ * Jumping straight to the fastest rate catches the start of a movement; the
+ * exponential back-off returns to the slow rate within a few periods once it
+ * is over. The logger applies a new period the same way as 'rate' does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_timer.h"
+#include "adapt.h"
+#include "fs_helpers.h"
+
+static adapt_cfg_t cfgs[ADAPT_CHANNELS];
+
+/**
+ * @brief Set (or with cfg->enabled = false, clear) the adaptive schedule of a channel.
+ *
+ * Used from the next run of that channel on.
+ */
+void adapt_set(uint8_t ch_id, const adapt_cfg_t *cfg) {
+    if (ch_id >= ADAPT_CHANNELS) {
+        return;
+    }
+    adapt_cfg_t c = *cfg;
+    if (c.min_us == 0) {
+        c.min_us = 1000;
+    }
+    if (c.max_us < c.min_us) {
+        c.max_us = c.min_us;
+    }
+    cfgs[ch_id] = c;
+}
+
+void adapt_get(uint8_t ch_id, adapt_cfg_t *out) {
+    if (ch_id < ADAPT_CHANNELS) {
+        *out = cfgs[ch_id];
+    } else {
+        memset(out, 0, sizeof *out);
+    }
+}
+
+/**
+ * @brief Reset 'a' to use 'cfg', starting at 'period_us' clamped to [min_us, max_us].
+ */
+static void adapt_init(adapt_state_t *a, const adapt_cfg_t *cfg, uint32_t period_us) {
+    memset(a, 0, sizeof *a);
+    a->cfg = *cfg;
+    if (period_us < a->cfg.min_us) {
+        period_us = a->cfg.min_us;
+    }
+    if (period_us > a->cfg.max_us) {
+        period_us = a->cfg.max_us;
+    }
+    a->period_us = period_us;
+}
+
+/**
+ * @brief Start a run of a channel with its configuration, beginning at 'period_us'.
+ */
+void adapt_begin(adapt_state_t *a, uint8_t ch_id, uint32_t period_us) {
+    adapt_cfg_t cfg;
+    adapt_get(ch_id, &cfg);
+    adapt_init(a, &cfg, period_us);
+}
+
+/**
+ * @brief Feed the latest sample; returns the period to use from now on.
+ */
+uint32_t adapt_update(adapt_state_t *a, float value) {
+    if (!a->have_prev) {
+        a->have_prev = true;
+        a->prev = value;
+        return a->period_us;
+    }
+
+    float d = fabsf(value - a->prev);
+    a->prev = value;
+
+    if (d > a->cfg.delta) {
+        if (a->period_us != a->cfg.min_us) {
+            a->period_us = a->cfg.min_us;
+            a->speedups++;
+        }
+        a->quiet = 0;
+    } else if (++a->quiet >= ADAPT_QUIET_RUN && a->period_us < a->cfg.max_us) {
+        uint32_t p = a->period_us * 2;
+        a->period_us = p > a->cfg.max_us || p < a->period_us ? a->cfg.max_us : p;
+        a->backoffs++;
+        a->quiet = 0;
+    }
+    return a->period_us;
+}
+
+/**
+ * @brief Load the values of any log file (plain, lazy, lossy or compacted CSV).
+ *
+ * @return Number of values (0 if the file can't be read)
+ */
+static int adapt_load(const char *path, float *v, int max) {
+    static fs_rows_t rows;      // large (a file cache); only the console task runs the bench
+    if (!path || !fs_rows_open(&rows, path)) {
+        return 0;
+    }
+    int n = 0;
+    uint32_t index;
+    while (n < max && fs_rows_next(&rows, &index, &v[n])) {
+        n++;
+    }
+    fs_rows_close(&rows);
+    return n;
+}
+
+/**
+ * @brief Synthetic trace: long quiet stretches with a few movements.
+ *
+ * Room-temperature drift with +-1 LSB of noise, then a ramp, a step and a
+ * short oscillation, scaled to the channel (degrees or volts).
+ */
+static int adapt_synth(const logger_channel_t *ch, float *v, int n) {
+    bool therm = ch->id == LOGGER_CH_ID_THERMISTOR;
+    float base = therm ? 23.7f : 1.2f;
+    float span = therm ? 6.0f : 2.0f;
+    float lsb = therm ? 0.01f : 0.001f;
+    uint32_t rng = 1;
+    for (int i = 0; i < n; i++) {
+        float x = base + 0.4f * i / n * (therm ? 1.0f : 0.1f);   // slow drift
+        float f = (float)i / n;
+        if (f > 0.30f && f < 0.35f) {
+            x += span * (f - 0.30f) / 0.05f;                       // ramp up
+        } else if (f >= 0.35f && f < 0.60f) {
+            x += span;
+        } else if (f >= 0.60f && f < 0.62f) {
+            x += span * 0.5f * (1.0f + sinf((f - 0.60f) * 600.0f));   // oscillation
+        }
+        rng = rng * 1103515245u + 12345u;
+        v[i] = x + ((int)((rng >> 16) % 3) - 1) * lsb;
+    }
+    return n;
+}
+
+/**
+ * @brief Replay a trace recorded at a fixed 'period_us' through the controller.
+ *
+ * Uses the rows of 'path' (any log of the channel, e.g. from 'start thermistor 100')
+ * or, if it can't be read, a synthetic trace. The controller's min_us is
+ * clamped to the trace period, and a sample is taken from the row nearest to
+ * each time the controller asks for. Reports rows and bytes against the fixed
+ * rate, the error of linearly interpolating the kept rows back to the full
+ * trace, and the storage-loop CPU time (conversion + formatting) saved.
+ */
+void adapt_bench(const logger_channel_t *ch, const char *path, uint32_t period_us) {
+    const int max = 20000;
+    float *v = malloc(max * sizeof *v);
+    if (!v) {
+        printf("[-] bench adapt: out of memory\n");
+        return;
+    }
+    int n = adapt_load(path, v, max);
+    bool synthetic = n < 2;
+    if (synthetic) {
+        n = adapt_synth(ch, v, 7200);
+    }
+
+    adapt_cfg_t cfg;
+    adapt_get(ch->id, &cfg);
+    if (!cfg.enabled) {
+        cfg = (adapt_cfg_t){ .enabled = true, .min_us = period_us, .max_us = period_us * 32,
+                             .delta = ch->id == LOGGER_CH_ID_THERMISTOR ? 0.05f : 0.01f };
+    }
+    if (cfg.min_us < period_us) {
+        cfg.min_us = period_us;
+    }
+    if (cfg.max_us < cfg.min_us) {
+        cfg.max_us = cfg.min_us;
+    }
+    adapt_state_t a;
+    adapt_init(&a, &cfg, period_us);
+
+    // Walk the trace at the controller's pace; interpolate between kept rows for the error
+    char row[48];
+    int kept = 0;
+    size_t bytes_fixed = 0, bytes_adapt = 0;
+    double err_sum = 0, err_max = 0;
+    int prev = -1;
+    for (int i = 0; i < n; ) {
+        kept++;
+        bytes_adapt += snprintf(row, sizeof row, ch->row_fmt, i, v[i]);
+        if (prev >= 0) {
+            for (int k = prev + 1; k < i; k++) {
+                float est = v[prev] + (v[i] - v[prev]) * (k - prev) / (i - prev);
+                double e = fabs(est - v[k]);
+                err_sum += e;
+                err_max = e > err_max ? e : err_max;
+            }
+        }
+        prev = i;
+        uint32_t p = adapt_update(&a, v[i]);
+        uint32_t step = (p + period_us / 2) / period_us;
+        i += step > 0 ? step : 1;
+    }
+    for (int i = 0; i < n; i++) {
+        bytes_fixed += snprintf(row, sizeof row, ch->row_fmt, i, v[i]);
+    }
+
+    // Storage-loop cost of one row: conversion plus formatting
+    const int reps = 1000;
+    volatile float sink = 0;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < reps; i++) {
+        float x = ch->convert(1000 + i);
+        sink += snprintf(row, sizeof row, ch->row_fmt, i, x);
+    }
+    double us_row = (double)(esp_timer_get_time() - t0) / reps;
+
+    printf("[*] adaptive sampling bench, %s, %s trace of %d rows at %u us\n", ch->name,
+           synthetic ? "synthetic" : path, n, (unsigned)period_us);
+    printf("    schedule : %u..%u us, delta %g, %u speed-ups, %u back-offs\n",
+           (unsigned)cfg.min_us, (unsigned)cfg.max_us, cfg.delta,
+           (unsigned)a.speedups, (unsigned)a.backoffs);
+    printf("    rows     : fixed %d, adaptive %d (%.1f%%)\n", n, kept, 100.0 * kept / n);
+    printf("    bytes    : fixed %u, adaptive %u (%.1f%%)\n",
+           (unsigned)bytes_fixed, (unsigned)bytes_adapt, 100.0 * bytes_adapt / bytes_fixed);
+    printf("    error    : max %.4f, mean %.5f (linear interpolation of kept rows)\n",
+           err_max, n > kept ? err_sum / n : 0.0);
+    printf("    CPU      : %.1f us/row, %.1f ms saved over the trace\n",
+           us_row, us_row * (n - kept) / 1000.0);
+    free(v);
+}
@@ -0,0 +1,41 @@
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "logger.h"
+
+// Adaptive sampling: the storage loop asks the controller for the next sample
+// period after every sample. A change larger than 'delta' between two samples
+// drops the period to 'min_us' right away; every ADAPT_QUIET_RUN quiet samples
+// in a row double it, up to 'max_us'.
+#define ADAPT_QUIET_RUN   4                  // quiet samples before the period doubles
+#define ADAPT_CHANNELS    2                  // indexed by LOGGER_CH_ID_*
+
+typedef struct {
+    bool     enabled;
+    uint32_t min_us;         // fastest period (while the signal moves)
+    uint32_t max_us;         // slowest period (while it is quiet)
+    float    delta;          // change between samples that counts as activity, in channel units
+} adapt_cfg_t;
+
+// Controller state for one run
+typedef struct {
+    adapt_cfg_t cfg;
+    uint32_t period_us;      // current period
+    uint32_t quiet;          // quiet samples since the last change of period
+    bool     have_prev;
+    float    prev;
+    uint32_t speedups;       // times activity dropped the period to min_us
+    uint32_t backoffs;       // times the period doubled
+} adapt_state_t;
+
+void adapt_set(uint8_t ch_id, const adapt_cfg_t *cfg);
+void adapt_get(uint8_t ch_id, adapt_cfg_t *out);
+void adapt_begin(adapt_state_t *a, uint8_t ch_id, uint32_t period_us);
+uint32_t adapt_update(adapt_state_t *a, float value);
+
+// Replay a recorded CSV trace (or a synthetic one) and report the savings
+void adapt_bench(const logger_channel_t *ch, const char *path, uint32_t period_us);
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * @file blkcache.c
+ * @brief Block-level LRU read cache for SPIFFS files.
+ *
+ * Every export used to go through fopen/fgets, so printing a file twice (or
+ * printing two overlapping row ranges) read the same SPIFFS pages through
+ * stdio twice. The read APIs now go through a blkcache_file_t reader, which
+ * asks this cache for BLKCACHE_BLOCK_SIZE-sized pieces of the file:
+ *
+ *  - a hit is a memcpy from RAM;
+ *  - a miss opens the file (once per reader), reads the whole block with one
+ *    fread and keeps it, evicting the least recently used block when the
+ *    budget is used up.
+ *
+ * Blocks are allocated on first use, up to the RAM budget set with
+ * blkcache_set_budget() (budget 0 = reads go straight to SPIFFS). Writers
+ * call blkcache_invalidate() after changing a file, so a cached block is
+ * never older than the file. Like any LRU, a single scan of a file bigger
+ * than the budget evicts blocks before they are reused, so the budget should
+ * cover the files that are read repeatedly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "logger.h"
+#include "blkcache.h"
+
+static const char *TAG = "blkcache";
+
+typedef struct {
+    char path[32];
+    uint32_t block;          // block index in the file
+    uint32_t len;            // valid bytes (< BLKCACHE_BLOCK_SIZE for the last block)
+    uint32_t last_use;       // LRU clock value of the last hit
+    bool valid;
+    uint8_t *data;           // BLKCACHE_BLOCK_SIZE bytes, NULL until first used
+} blkcache_slot_t;
+
+static blkcache_slot_t slots[BLKCACHE_MAX_BLOCKS];
+static uint32_t budget_blocks = 0;
+static uint32_t lru_clock = 0;
+static blkcache_stats_t stats;
+static SemaphoreHandle_t lock = NULL;
+
+/**
+ * @brief Create the cache lock and apply the default budget. Called once at mount.
+ */
+void blkcache_init(void) {
+    if (!lock) {
+        lock = xSemaphoreCreateMutex();
+    }
+    blkcache_set_budget(BLKCACHE_BUDGET_BYTES);
+}
+
+/**
+ * @brief Change the RAM budget; blocks above it are freed right away.
+ */
+void blkcache_set_budget(size_t bytes) {
+    uint32_t blocks = bytes / BLKCACHE_BLOCK_SIZE;
+    if (blocks > BLKCACHE_MAX_BLOCKS) {
+        blocks = BLKCACHE_MAX_BLOCKS;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint32_t i = blocks; i < BLKCACHE_MAX_BLOCKS; i++) {
+        free(slots[i].data);
+        slots[i].data = NULL;
+        slots[i].valid = false;
+    }
+    budget_blocks = blocks;
+    stats.budget = blocks * BLKCACHE_BLOCK_SIZE;
+    xSemaphoreGive(lock);
+}
+
+/**
+ * @brief Drop the cached blocks of 'path' that hold bytes at or after offset 'from'.
+ *
+ * Call after changing a file: 'from' = 0 after rewriting or deleting it, the
+ * old size after appending (blocks before it are still good).
+ */
+void blkcache_invalidate(const char *path, uint32_t from) {
+    if (!lock) {
+        return;
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < budget_blocks; i++) {
+        if (slots[i].valid && (slots[i].block + 1) * BLKCACHE_BLOCK_SIZE > from &&
+            strcmp(slots[i].path, path) == 0) {
+            slots[i].valid = false;
+            stats.invalidations++;
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+/**
+ * @brief Copy cache counters.
+ */
+void blkcache_get_stats(blkcache_stats_t *out) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    *out = stats;
+    out->blocks = 0;
+    for (uint32_t i = 0; i < budget_blocks; i++) {
+        out->blocks += slots[i].valid;
+    }
+    xSemaphoreGive(lock);
+}
+
+/**
+ * @brief Pick the slot for a new block: an unused one, else the least recently used.
+ */
+static blkcache_slot_t *blkcache_victim(void) {
+    blkcache_slot_t *victim = NULL;
+    for (uint32_t i = 0; i < budget_blocks; i++) {
+        blkcache_slot_t *s = &slots[i];
+        if (!s->valid) {
+            return s;
+        }
+        if (!victim || s->last_use < victim->last_use) {
+            victim = s;
+        }
+    }
+    if (victim) {
+        stats.evictions++;
+    }
+    return victim;
+}
+
+/**
+ * @brief Copy up to 'len' bytes at file offset 'off' (not crossing a block boundary).
+ *
+ * @return Bytes copied, 0 at end of file or if the file can't be read
+ */
+static size_t blkcache_fetch(blkcache_file_t *f, uint32_t off, void *dst, size_t len) {
+    uint32_t block = off / BLKCACHE_BLOCK_SIZE;
+    uint32_t within = off % BLKCACHE_BLOCK_SIZE;
+    if (len > BLKCACHE_BLOCK_SIZE - within) {
+        len = BLKCACHE_BLOCK_SIZE - within;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    blkcache_slot_t *s = NULL;
+    for (uint32_t i = 0; i < budget_blocks; i++) {
+        if (slots[i].valid && slots[i].block == block && strcmp(slots[i].path, f->path) == 0) {
+            s = &slots[i];
+            break;
+        }
+    }
+
+    size_t n = 0;
+    if (s) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+        if (!f->fp) {
+            f->fp = fopen(f->path, "r");
+        }
+        s = f->fp ? blkcache_victim() : NULL;
+        if (s && !s->data) {
+            s->data = malloc(BLKCACHE_BLOCK_SIZE);
+            if (!s->data) {
+                ESP_LOGW(TAG, "no memory for a cache block");
+                s = NULL;
+            }
+        }
+
+        if (f->fp && !s) {
+            // Nothing to cache into (budget 0): plain read
+            fseek(f->fp, off, SEEK_SET);
+            n = fread(dst, 1, len, f->fp);
+            xSemaphoreGive(lock);
+            return n;
+        }
+        if (s) {
+            s->valid = false;
+            fseek(f->fp, (long)block * BLKCACHE_BLOCK_SIZE, SEEK_SET);
+            s->len = fread(s->data, 1, BLKCACHE_BLOCK_SIZE, f->fp);
+            s->block = block;
+            snprintf(s->path, sizeof s->path, "%s", f->path);
+            s->valid = s->len > 0;
+        }
+    }
+
+    if (s && s->valid && within < s->len) {
+        n = s->len - within < len ? s->len - within : len;
+        memcpy(dst, s->data + within, n);
+        s->last_use = ++lru_clock;
+    }
+    xSemaphoreGive(lock);
+    return n;
+}
+
+/**
+ * @brief Start reading 'path' from the beginning.
+ *
+ * @return false if the file can't be opened
+ */
+bool blkcache_open(blkcache_file_t *f, const char *path) {
+    memset(f, 0, sizeof *f);
+    snprintf(f->path, sizeof f->path, "%s", path);
+
+    // Read the first piece right away so a missing file is reported here
+    f->len = blkcache_fetch(f, 0, f->buf, sizeof f->buf);
+    f->off = f->len;
+    if (f->len == 0 && !f->fp) {
+        // Not cached and fopen failed: the file doesn't exist
+        return false;
+    }
+    f->eof = f->len == 0;
+    return true;
+}
+
+/**
+ * @brief Refill the reader's line buffer.
+ */
+static bool blkcache_fill(blkcache_file_t *f) {
+    if (f->eof) {
+        return false;
+    }
+    f->pos = 0;
+    f->len = blkcache_fetch(f, f->off, f->buf, sizeof f->buf);
+    f->off += f->len;
+    f->eof = f->len == 0;
+    return !f->eof;
+}
+
+/**
+ * @brief fread() replacement: copy up to 'len' bytes.
+ */
+size_t blkcache_read(blkcache_file_t *f, void *buf, size_t len) {
+    uint8_t *dst = buf;
+    size_t done = 0;
+
+    // Whatever the line buffer still holds first, then straight from the cache
+    size_t avail = f->len - f->pos;
+    size_t n = avail < len ? avail : len;
+    memcpy(dst, f->buf + f->pos, n);
+    f->pos += n;
+    done += n;
+
+    while (done < len && !f->eof) {
+        n = blkcache_fetch(f, f->off, dst + done, len - done);
+        f->off += n;
+        f->eof = n == 0;
+        done += n;
+    }
+    return done;
+}
+
+/**
+ * @brief fgets() replacement: read one line (including '\n') into 'buf'.
+ *
+ * @return buf, or NULL at end of file
+ */
+char *blkcache_gets(char *buf, int size, blkcache_file_t *f) {
+    int n = 0;
+    while (n < size - 1) {
+        if (f->pos == f->len && !blkcache_fill(f)) {
+            break;
+        }
+        char c = f->buf[f->pos++];
+        buf[n++] = c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+/**
+ * @brief Finish reading (closes the file if a miss had to open it).
+ */
+void blkcache_close(blkcache_file_t *f) {
+    if (f->fp) {
+        fclose(f->fp);
+        f->fp = NULL;
+    }
+}
+
+/**
+ * @brief Compare repeated full and range reads of one file with and without the cache.
+ *
+ * Writes a synthetic thermistor CSV that fits in the default budget to
+ * "/spiffs/bench.csv", then times 'passes' passes of:
+ *   - full export: fread() vs. blkcache_read(), 256-byte chunks
+ *   - range read of rows 300..399 (line by line): fgets() vs. blkcache_gets()
+ * Output goes nowhere, so only the read path is measured.
+ */
+void blkcache_bench(int passes) {
+    const char *path = "/spiffs/bench.csv";
+    const int rows = 900;   // ~12 KB: fits in BLKCACHE_BUDGET_BYTES
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        printf("[-] bench: open for write failed: %s\n", path);
+        return;
+    }
+    fprintf(f, "%s\n", LOGGER_CH_THERMISTOR.csv_header);
+    for (int i = 0; i < rows; i++) {
+        fprintf(f, LOGGER_CH_THERMISTOR.row_fmt, i, 23.7 + (i % 40) * 0.01);
+    }
+    fclose(f);
+    blkcache_invalidate(path, 0);
+
+    blkcache_stats_t before;
+    blkcache_get_stats(&before);
+    char buf[256];
+    int64_t t_stdio = 0, t_cache = 0, t_stdio_rng = 0, t_cache_rng = 0;
+
+    for (int p = 0; p < passes; p++) {
+        // Full export
+        int64_t t0 = esp_timer_get_time();
+        f = fopen(path, "r");
+        while (f && fread(buf, 1, sizeof buf, f) > 0) {
+        }
+        if (f) {
+            fclose(f);
+        }
+        t_stdio += esp_timer_get_time() - t0;
+
+        t0 = esp_timer_get_time();
+        blkcache_file_t cf;
+        if (blkcache_open(&cf, path)) {
+            while (blkcache_read(&cf, buf, sizeof buf) > 0) {
+            }
+            blkcache_close(&cf);
+        }
+        t_cache += esp_timer_get_time() - t0;
+
+        // Range read: skip to row 300, read 100 rows
+        t0 = esp_timer_get_time();
+        f = fopen(path, "r");
+        for (int row = -1; f && row < 400 && fgets(buf, sizeof buf, f); row++) {
+        }
+        if (f) {
+            fclose(f);
+        }
+        t_stdio_rng += esp_timer_get_time() - t0;
+
+        t0 = esp_timer_get_time();
+        if (blkcache_open(&cf, path)) {
+            for (int row = -1; row < 400 && blkcache_gets(buf, sizeof buf, &cf); row++) {
+            }
+            blkcache_close(&cf);
+        }
+        t_cache_rng += esp_timer_get_time() - t0;
+    }
+
+    blkcache_stats_t after;
+    blkcache_get_stats(&after);
+    int div = passes > 0 ? passes : 1;
+    printf("[*] cache bench: %d passes over %d rows, budget %u bytes\n", passes, rows, (unsigned)after.budget);
+    printf("    full export: stdio %lld us/pass, cache %lld us/pass\n",
+           (long long)(t_stdio / div), (long long)(t_cache / div));
+    printf("    rows 300-399: stdio %lld us/pass, cache %lld us/pass\n",
+           (long long)(t_stdio_rng / div), (long long)(t_cache_rng / div));
+    printf("    %u hits, %u misses, %u evictions\n",
+           (unsigned)(after.hits - before.hits), (unsigned)(after.misses - before.misses),
+           (unsigned)(after.evictions - before.evictions));
+}
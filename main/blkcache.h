@@ -0,0 +1,49 @@
+#ifndef BLKCACHE_H
+#define BLKCACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// LRU cache of SPIFFS file blocks shared by all read APIs (fs_print_*, cat,
+// print_csv_file_only). Blocks are keyed by (path, block index) and filled
+// with one fread each; repeated exports and overlapping range reads are then
+// served from RAM.
+#define BLKCACHE_BLOCK_SIZE    4096                // bytes per cached block (= LOGGER_BLOCK_SIZE)
+#define BLKCACHE_BUDGET_BYTES  (16 * 1024)         // default RAM budget
+#define BLKCACHE_MAX_BLOCKS    16                  // largest budget: 64 KB
+#define BLKCACHE_READ_BUF      256                 // per-reader line buffer
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;          // blocks read from SPIFFS
+    uint32_t evictions;       // least recently used block dropped to make room
+    uint32_t invalidations;   // blocks dropped because their file changed
+    uint32_t blocks;          // blocks currently cached
+    uint32_t budget;          // RAM budget in bytes
+} blkcache_stats_t;
+
+// Sequential reader over a file (replaces FILE* + fgets/fread on the read paths)
+typedef struct {
+    char path[32];
+    FILE *fp;                 // opened only when a block is missing from the cache
+    uint32_t off;             // file offset of buf[len]
+    bool eof;
+    uint16_t pos, len;        // unread bytes are buf[pos..len)
+    char buf[BLKCACHE_READ_BUF];
+} blkcache_file_t;
+
+void blkcache_init(void);
+void blkcache_set_budget(size_t bytes);
+void blkcache_invalidate(const char *path, uint32_t from);
+void blkcache_get_stats(blkcache_stats_t *out);
+
+bool blkcache_open(blkcache_file_t *f, const char *path);
+size_t blkcache_read(blkcache_file_t *f, void *buf, size_t len);
+char *blkcache_gets(char *buf, int size, blkcache_file_t *f);
+void blkcache_close(blkcache_file_t *f);
+
+void blkcache_bench(int passes);
+
+#endif
@@ -0,0 +1,1164 @@
+/**
+ * @file blocklog.c
+ * @brief Append-only block log on a raw flash partition, with a zero-copy export path.
+ *
+ * SPIFFS scatters a file over 256-byte pages, so reading it back always goes
+ * through VFS + stdio and a bounce buffer. The block log instead owns the
+ * "rawlog" partition directly: every block is one erased-then-programmed flash
+ * sector with a small header. Because the layout is known, export can map the
+ * partition into the address space with esp_partition_mmap() and hand payload
+ * bytes straight from flash to the console driver.
+ *
+ * Finding the append point normally means reading every block header. To keep
+ * boot fast, the write cursor is checkpointed to NVS (at most once per
+ * BLOCKLOG_CKPT_INTERVAL_S) and reloaded at startup. A checkpoint that is
+ * slightly behind is rolled forward by reading just the few blocks written
+ * after it; only a checkpoint that doesn't match the flash contents falls
+ * back to the full scan.
+ *
+ * Each header also carries a zone map (min/max value of the block), so value
+ * queries such as "when was it above 30 °C" can skip every block whose range
+ * can't match without touching its payload.
+ *
+ * Payloads are either CSV rows or, for lazy runs, raw 12-bit ADC codes packed
+ * two per three bytes (BLOCKLOG_CODEC_PACK12). Packed blocks hold about 2700
+ * samples instead of ~250 rows and are turned into the same CSV rows on
+ * export, converted with the current 'logger_conv' parameters.
+ *
+ * Blocks written by the logger also end with their rows' capture times in
+ * implicit form (blocklog_time_t): first time + nominal period, plus an
+ * explicit correction for the few rows that were off the grid. That is
+ * 24 bytes per block for a steady stream instead of 8 bytes per row, and a
+ * time can be turned into a row index without reading any rows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "driver/uart.h"
+#include "sdkconfig.h"
+#include "fs_helpers.h"
+#include "logger.h"
+#include "blocklog.h"
+#include "hotwin.h"
+#include "blkcache.h"
+#include "codec.h"
+
+// Tag used for ESP_LOG macros to identify logs from this file
+static const char *TAG = "BLOCKLOG";
+
+static const esp_partition_t *part = NULL;
+static uint32_t nblocks = 0;     // blocks in the partition
+static uint32_t head = 0;        // next slot to write (also the oldest slot once the ring wrapped)
+static uint32_t next_seq = 0;    // sequence number for the next block
+static uint32_t used = 0;        // valid blocks currently stored
+static uint32_t next_index = 0;  // sample index following the newest block
+
+// Write cursor as stored in NVS
+typedef struct {
+    uint32_t head;
+    uint32_t next_seq;
+    uint32_t next_index;
+    uint32_t used;
+} blocklog_ckpt_t;
+
+static int64_t last_ckpt_us = 0;     // when the checkpoint was last written
+static bool ckpt_dirty = false;      // blocks appended since then
+
+/**
+ * @brief Check that a header read from flash describes a usable block.
+ */
+static bool blocklog_hdr_valid(const blocklog_hdr_t *h) {
+    return h->magic == BLOCKLOG_MAGIC &&
+           h->version >= 1 && h->version <= BLOCKLOG_VERSION &&
+           h->len <= BLOCKLOG_PAYLOAD_MAX;
+}
+
+/**
+ * @brief Read the header of block slot 'i' and check it.
+ */
+static bool blocklog_read_hdr(uint32_t i, blocklog_hdr_t *h) {
+    return esp_partition_read(part, i * BLOCKLOG_BLOCK_SIZE, h, sizeof *h) == ESP_OK &&
+           blocklog_hdr_valid(h);
+}
+
+/**
+ * @brief Locate the append point by reading every block header.
+ */
+static void blocklog_scan(void) {
+    bool found = false;
+    uint32_t max_seq = 0;
+    used = 0;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        blocklog_hdr_t h;
+        if (!blocklog_read_hdr(i, &h)) {
+            continue;
+        }
+        used++;
+        if (!found || h.seq > max_seq) {
+            max_seq = h.seq;
+            head = (i + 1) % nblocks;
+            next_index = h.first_index + h.count;
+            found = true;
+        }
+    }
+    next_seq = found ? max_seq + 1 : 0;
+}
+
+/**
+ * @brief Restore the write cursor from the NVS checkpoint.
+ *
+ * The checkpoint is trusted only if the block just before its head really is
+ * the block it claims to be. Blocks appended after the checkpoint was taken
+ * are then picked up by following the sequence numbers forward.
+ *
+ * @return true if the cursor was restored, false if a full scan is needed
+ */
+static bool blocklog_load_checkpoint(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    blocklog_ckpt_t c;
+    size_t len = sizeof c;
+    esp_err_t err = nvs_get_blob(nvs, "blk_ckpt", &c, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || len != sizeof c || c.head >= nblocks || c.used > nblocks) {
+        return false;
+    }
+
+    blocklog_hdr_t h;
+    if (c.used > 0) {
+        uint32_t prev = (c.head + nblocks - 1) % nblocks;
+        if (!blocklog_read_hdr(prev, &h) || h.seq != c.next_seq - 1) {
+            return false;   // stale: the log was erased or rewritten since
+        }
+    }
+
+    head = c.head;
+    next_seq = c.next_seq;
+    next_index = c.next_index;
+    used = c.used;
+
+    // Roll forward over blocks written after the checkpoint
+    while (blocklog_read_hdr(head, &h) && h.seq == next_seq) {
+        next_seq++;
+        next_index = h.first_index + h.count;
+        used = used < nblocks ? used + 1 : nblocks;
+        head = (head + 1) % nblocks;
+    }
+    return true;
+}
+
+/**
+ * @brief Save the write cursor to NVS, at most once per BLOCKLOG_CKPT_INTERVAL_S unless forced.
+ *
+ * Rate limiting keeps NVS wear low; a checkpoint that is a few blocks behind
+ * costs only a few header reads at the next boot.
+ */
+void blocklog_checkpoint(bool force) {
+    int64_t now = esp_timer_get_time();
+    if (!part || !ckpt_dirty ||
+        (!force && now - last_ckpt_us < (int64_t)BLOCKLOG_CKPT_INTERVAL_S * 1000000)) {
+        return;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;   // NVS not initialized: next boot just scans
+    }
+    blocklog_ckpt_t c = {
+        .head = head,
+        .next_seq = next_seq,
+        .next_index = next_index,
+        .used = used,
+    };
+    if (nvs_set_blob(nvs, "blk_ckpt", &c, sizeof c) == ESP_OK) {
+        nvs_commit(nvs);
+        ckpt_dirty = false;
+        last_ckpt_us = now;
+    }
+    nvs_close(nvs);
+}
+
+/**
+ * @brief Find the raw log partition and locate the append point.
+ *
+ * Uses the NVS checkpoint when it is valid and scans every block header
+ * otherwise. Safe to call more than once.
+ */
+esp_err_t blocklog_init(void) {
+    if (part) {
+        return ESP_OK;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, BLOCKLOG_PARTITION);
+    if (!part) {
+        ESP_LOGE(TAG, "partition '%s' not found", BLOCKLOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    nblocks = part->size / BLOCKLOG_BLOCK_SIZE;
+
+    bool from_ckpt = blocklog_load_checkpoint();
+    if (!from_ckpt) {
+        blocklog_scan();
+        ckpt_dirty = true;
+        blocklog_checkpoint(true);
+    }
+
+    ESP_LOGI(TAG, "%u/%u blocks used, next seq %u, next index %u (%s, %lld us)",
+             (unsigned)used, (unsigned)nblocks, (unsigned)next_seq, (unsigned)next_index,
+             from_ckpt ? "checkpoint" : "scan", (long long)(esp_timer_get_time() - t0));
+    return ESP_OK;
+}
+
+/**
+ * @brief Sample index that follows the newest stored block.
+ */
+uint32_t blocklog_next_index(void) {
+    return next_index;
+}
+
+/**
+ * @brief Count one more record in a block header and update its zone map.
+ */
+void blocklog_hdr_add(blocklog_hdr_t *hdr, float value) {
+    if (hdr->count == 0 || value < hdr->vmin) {
+        hdr->vmin = value;
+    }
+    if (hdr->count == 0 || value > hdr->vmax) {
+        hdr->vmax = value;
+    }
+    hdr->count++;
+}
+
+/**
+ * @brief Record the capture time of row 'row' of the block being filled.
+ *
+ * Row 0 starts the grid. Any later row more than BLOCKLOG_TIME_JITTER_US away
+ * from its predicted time (last exact time + rows since * period) gets a
+ * correction and becomes the new anchor, so the error never accumulates.
+ * A new 'period_us' adds a period entry first; a row can take two entries,
+ * so the caller commits the block once fewer than two are left.
+ */
+void blocklog_stamps_add(blocklog_stamps_t *s, uint32_t row, int64_t t_us, uint32_t period_us) {
+    if (row == 0) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        s->t.t0_us = t_us;
+        s->t.wall_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+        s->t.period_us = period_us;
+        s->t.n_exc = 0;
+        s->t.jitter_us = BLOCKLOG_TIME_JITTER_US;
+        s->anchor_row = 0;
+        s->anchor_us = t_us;
+        s->period_us = period_us;
+        return;
+    }
+    if (period_us != s->period_us && s->t.n_exc < BLOCKLOG_TIME_EXC_MAX) {
+        // Rows up to this one follow the old period, later ones the new one
+        s->exc[s->t.n_exc++] = (blocklog_time_exc_t){ .row = (uint16_t)row, .flags = BLOCKLOG_EXC_PERIOD,
+                                                      .dt_us = (int32_t)period_us };
+        s->anchor_us += (int64_t)(row - s->anchor_row) * s->period_us;
+        s->anchor_row = row;
+        s->period_us = period_us;
+    }
+    int64_t dt = t_us - (s->anchor_us + (int64_t)(row - s->anchor_row) * s->period_us);
+    if ((dt > BLOCKLOG_TIME_JITTER_US || dt < -BLOCKLOG_TIME_JITTER_US) && s->t.n_exc < BLOCKLOG_TIME_EXC_MAX) {
+        s->exc[s->t.n_exc++] = (blocklog_time_exc_t){ .row = (uint16_t)row, .dt_us = (int32_t)dt };
+        s->anchor_row = row;
+        s->anchor_us = t_us;
+    }
+}
+
+/**
+ * @brief Bytes the time trailer of the current block takes.
+ */
+size_t blocklog_stamps_len(const blocklog_stamps_t *s) {
+    return s->t.n_exc * sizeof(blocklog_time_exc_t) + sizeof(blocklog_time_t);
+}
+
+/**
+ * @brief Write the time trailer (corrections, then blocklog_time_t) to 'dst'.
+ *
+ * @return blocklog_stamps_len(s)
+ */
+size_t blocklog_stamps_write(const blocklog_stamps_t *s, void *dst) {
+    size_t n = s->t.n_exc * sizeof(blocklog_time_exc_t);
+    memcpy(dst, s->exc, n);
+    memcpy((uint8_t *)dst + n, &s->t, sizeof s->t);
+    return n + sizeof s->t;
+}
+
+// Reader side of the time trailer: walks a block's rows in order
+typedef struct {
+    blocklog_time_t t;
+    const uint8_t *exc;    // corrections in the mapped payload (unaligned)
+    uint16_t next;         // next correction to apply
+    uint32_t anchor_row;
+    int64_t  anchor_us;
+    uint32_t period_us;    // current period
+} blocklog_clock_t;
+
+/**
+ * @brief Set up 'c' for a block and return how many payload bytes are rows.
+ *
+ * Blocks without a time trailer get period_us = 0 (no times known).
+ */
+static size_t blocklog_clock_init(blocklog_clock_t *c, const blocklog_hdr_t *h, const uint8_t *payload) {
+    memset(c, 0, sizeof *c);
+    if (h->version < 3 || !(h->flags & BLOCKLOG_FLAG_TIME) || h->len < sizeof c->t) {
+        return h->len;
+    }
+    memcpy(&c->t, payload + h->len - sizeof c->t, sizeof c->t);
+    size_t trailer = c->t.n_exc * sizeof(blocklog_time_exc_t) + sizeof c->t;
+    if (trailer > h->len) {
+        memset(&c->t, 0, sizeof c->t);
+        return h->len;
+    }
+    c->exc = payload + h->len - trailer;
+    c->anchor_us = c->t.t0_us;
+    c->period_us = c->t.period_us;
+    return h->len - trailer;
+}
+
+/**
+ * @brief Capture time (esp_timer) of row 'row'; rows must be asked in increasing order.
+ */
+static int64_t blocklog_clock_at(blocklog_clock_t *c, uint32_t row) {
+    while (c->next < c->t.n_exc) {
+        blocklog_time_exc_t e;
+        memcpy(&e, c->exc + c->next * sizeof e, sizeof e);
+        if (e.row > row) {
+            break;
+        }
+        c->anchor_us += (int64_t)(e.row - c->anchor_row) * c->period_us;
+        c->anchor_row = e.row;
+        if (e.flags & BLOCKLOG_EXC_PERIOD) {
+            c->period_us = (uint32_t)e.dt_us;
+        } else {
+            c->anchor_us += e.dt_us;
+        }
+        c->next++;
+    }
+    return c->anchor_us + (int64_t)(row - c->anchor_row) * c->period_us;
+}
+
+/**
+ * @brief Check that the sector at 'off' is erased (reads back all 0xFF).
+ */
+static bool blocklog_sector_blank(size_t off) {
+    static uint32_t buf[64];
+    for (size_t pos = 0; pos < BLOCKLOG_BLOCK_SIZE; pos += sizeof buf) {
+        if (esp_partition_read(part, off + pos, buf, sizeof buf) != ESP_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof buf / sizeof buf[0]; i++) {
+            if (buf[i] != 0xFFFFFFFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Append one block, overwriting the oldest block once the partition is full.
+ *
+ * The caller fills in channel, first_index, count, len and codec; magic,
+ * version, seq and crc are set here.
+ *
+ * @param hdr      Block header (updated in place)
+ * @param payload  hdr->len bytes of payload (at most BLOCKLOG_PAYLOAD_MAX)
+ */
+esp_err_t blocklog_append(blocklog_hdr_t *hdr, const void *payload) {
+    if (!part || hdr->len > BLOCKLOG_PAYLOAD_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    hdr->magic = BLOCKLOG_MAGIC;
+    hdr->version = BLOCKLOG_VERSION;
+    hdr->seq = next_seq;
+    hdr->crc = esp_rom_crc32_le(0, payload, hdr->len);
+
+    size_t off = head * BLOCKLOG_BLOCK_SIZE;
+
+    // Skip the erase only if the whole sector reads blank: a torn or failed
+    // append leaves payload bytes behind a blank header
+    blocklog_hdr_t old;
+    bool had_block = esp_partition_read(part, off, &old, sizeof old) == ESP_OK && blocklog_hdr_valid(&old);
+    if (!blocklog_sector_blank(off)) {
+        ESP_ERROR_CHECK(esp_partition_erase_range(part, off, BLOCKLOG_BLOCK_SIZE));
+        if (had_block) {
+            used--;
+        }
+    }
+
+    // Payload first, header last: a torn write leaves an invalid block, not a corrupt one
+    esp_err_t err = esp_partition_write(part, off + sizeof *hdr, payload, hdr->len);
+    if (err == ESP_OK) {
+        err = esp_partition_write(part, off, hdr, sizeof *hdr);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "write failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    used++;
+    next_seq++;
+    next_index = hdr->first_index + hdr->count;
+    head = (head + 1) % nblocks;
+
+    ckpt_dirty = true;
+    blocklog_checkpoint(false);
+    return ESP_OK;
+}
+
+/**
+ * @brief Erase the whole raw log.
+ */
+esp_err_t blocklog_erase_all(void) {
+    if (!part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = esp_partition_erase_range(part, 0, part->size);
+    hotwin_forget(RAWLOG_PATH);
+    head = 0;
+    used = 0;
+    next_index = 0;
+    ckpt_dirty = true;
+    blocklog_checkpoint(true);
+    return err;
+}
+
+/**
+ * @brief Number of valid blocks currently stored.
+ */
+uint32_t blocklog_block_count(void) {
+    return used;
+}
+
+/**
+ * @brief Find the byte offset of row 'row' in a CSV payload (one row per '\n').
+ */
+static size_t blocklog_row_offset(const uint8_t *payload, size_t len, uint32_t row) {
+    size_t off = 0;
+    while (row > 0 && off < len) {
+        const uint8_t *nl = memchr(payload + off, '\n', len - off);
+        if (!nl) {
+            return len;
+        }
+        off = nl - payload + 1;
+        row--;
+    }
+    return off;
+}
+
+/**
+ * @brief Decode rows [r, min(r + LOGGER_CONV_BATCH, to)) of a packed block into values.
+ *
+ * 'r' must be even (a pair starts on a byte boundary).
+ *
+ * @return Rows decoded
+ */
+static int blocklog_pack12_batch(const uint8_t *payload, const logger_channel_t *ch,
+                                 uint32_t r, uint32_t to, float *val) {
+    uint16_t raw[LOGGER_CONV_BATCH];
+    int n = to - r < LOGGER_CONV_BATCH ? (int)(to - r) : LOGGER_CONV_BATCH;
+    codec_unpack12(payload + r / 2 * 3, n, raw);
+    logger_convert_batch(ch, &logger_conv, raw, val, n);
+    return n;
+}
+
+/**
+ * @brief Format rows [from, to) of a packed block as CSV and pass them to 'write'.
+ *
+ * Packed payloads can't be handed out zero-copy; each batch is converted and
+ * formatted into a RAM buffer first.
+ */
+static void blocklog_export_pack12(const blocklog_hdr_t *h, const uint8_t *payload,
+                                   uint32_t from, uint32_t to, blocklog_write_fn write, void *ctx) {
+    static char text[LOGGER_CONV_BATCH * 32];
+    float val[LOGGER_CONV_BATCH];
+    const logger_channel_t *ch = logger_channel_by_id(h->channel);
+    if (!ch) {
+        return;
+    }
+
+    for (uint32_t r = from & ~1u; r < to; r += LOGGER_CONV_BATCH) {
+        int n = blocklog_pack12_batch(payload, ch, r, to, val);
+        size_t len = 0;
+        for (int i = 0; i < n; i++) {
+            if (r + i >= from) {
+                len += snprintf(text + len, sizeof text - len, ch->row_fmt, (int)(h->first_index + r + i), val[i]);
+            }
+        }
+        write(text, len, ctx);
+    }
+}
+
+/**
+ * @brief Stream every stored payload, oldest first, directly from mapped flash.
+ */
+esp_err_t blocklog_export(blocklog_write_fn write, void *ctx) {
+    return blocklog_export_range(0, UINT32_MAX, write, ctx);
+}
+
+/**
+ * @brief Stream rows with sample index in [first, first + count), oldest first.
+ *
+ * The whole partition is mapped once; payload bytes are passed to 'write' as
+ * pointers into flash, in chunks of BLOCKLOG_EXPORT_CHUNK bytes. Blocks that
+ * lie completely outside the range are skipped using their header alone, and
+ * blocks with a bad CRC are skipped.
+ */
+esp_err_t blocklog_export_range(uint32_t first, uint32_t count, blocklog_write_fn write, void *ctx) {
+    uint32_t last = (count > UINT32_MAX - first) ? UINT32_MAX : first + count;   // exclusive
+
+    if (!part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const void *map;
+    esp_partition_mmap_handle_t map_handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &map_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mmap failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Starting at 'head' visits the blocks in the order they were written
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint8_t *blk = (const uint8_t *)map + ((head + i) % nblocks) * BLOCKLOG_BLOCK_SIZE;
+        const blocklog_hdr_t *h = (const blocklog_hdr_t *)blk;
+        if (!blocklog_hdr_valid(h) ||
+            h->first_index >= last || h->first_index + h->count <= first) {
+            continue;
+        }
+
+        const uint8_t *payload = blk + sizeof *h;
+        if (esp_rom_crc32_le(0, payload, h->len) != h->crc) {
+            ESP_LOGW(TAG, "block seq %u: bad crc, skipped", (unsigned)h->seq);
+            continue;
+        }
+
+        if (h->codec == BLOCKLOG_CODEC_PACK12) {
+            uint32_t from = first > h->first_index ? first - h->first_index : 0;
+            uint32_t to = last < h->first_index + h->count ? last - h->first_index : h->count;
+            blocklog_export_pack12(h, payload, from, to, write, ctx);
+            continue;
+        }
+
+        // Trim rows outside the range (only at the two edge blocks)
+        blocklog_clock_t clk;
+        size_t rows_len = blocklog_clock_init(&clk, h, payload);
+        size_t start = 0, end = rows_len;
+        if (first > h->first_index) {
+            start = blocklog_row_offset(payload, rows_len, first - h->first_index);
+        }
+        if (last < h->first_index + h->count) {
+            end = blocklog_row_offset(payload, rows_len, last - h->first_index);
+        }
+
+        for (size_t off = start; off < end; off += BLOCKLOG_EXPORT_CHUNK) {
+            size_t n = end - off;
+            write(payload + off, n < BLOCKLOG_EXPORT_CHUNK ? n : BLOCKLOG_EXPORT_CHUNK, ctx);
+        }
+    }
+
+    esp_partition_munmap(map_handle);
+    return ESP_OK;
+}
+
+/**
+ * @brief Export sink that writes to the console UART through the driver.
+ *
+ * With a TX ring buffer size of 0 the UART driver copies straight from the
+ * caller's pointer into the hardware FIFO, so mapped flash goes to the wire
+ * without an intermediate RAM copy. The driver must be installed
+ * (blocklog_print_csv() takes care of that).
+ */
+void blocklog_console_write(const void *data, size_t len, void *ctx) {
+    uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, data, len);
+}
+
+/**
+ * @brief Discard sink used to measure the read side of an export on its own.
+ */
+static void blocklog_null_write(const void *data, size_t len, void *ctx) {
+    *(size_t *)ctx += len;
+}
+
+/**
+ * @brief Print the raw log as pure CSV over the console (raw-log version of print_csv_file_only()).
+ */
+void blocklog_print_csv(void) {
+    blocklog_print_range(0, UINT32_MAX);
+}
+
+/**
+ * @brief Print rows [first, first + count) of the raw log as pure CSV over the console.
+ *
+ * Suppresses ESP-IDF logs, prints the CSV header of the logged channel and
+ * then the selected rows, using the zero-copy export path.
+ */
+void blocklog_print_range(uint32_t first, uint32_t count) {
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    if (blocklog_init() != ESP_OK || used == 0) {
+        printf("error,message\r\n,Raw log is empty\r\n");
+        return;
+    }
+
+    // Header comes from the channel of the oldest block
+    blocklog_hdr_t h;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        esp_partition_read(part, ((head + i) % nblocks) * BLOCKLOG_BLOCK_SIZE, &h, sizeof h);
+        if (blocklog_hdr_valid(&h)) {
+            break;
+        }
+    }
+    const logger_channel_t *ch = logger_channel_by_id(h.channel);
+    printf("%s\n", ch ? ch->csv_header : "index,value");
+    fflush(stdout);
+
+    // Install the UART driver just for the export if nobody else did
+    uart_port_t port = CONFIG_ESP_CONSOLE_UART_NUM;
+    bool installed = false;
+    if (!uart_is_driver_installed(port)) {
+        ESP_ERROR_CHECK(uart_driver_install(port, 256, 0, 0, NULL, 0));
+        installed = true;
+    }
+
+    blocklog_export_range(first, count, blocklog_console_write, NULL);
+    uart_wait_tx_done(port, portMAX_DELAY);
+
+    if (installed) {
+        uart_driver_delete(port);
+    }
+}
+
+/**
+ * @brief Print the wall-clock time of row 'row' as the first CSV column (empty if unknown).
+ */
+static void blocklog_print_time(blocklog_clock_t *c, uint32_t row) {
+    if (c->t.period_us == 0) {
+        printf(", ");
+        return;
+    }
+    int64_t t = blocklog_clock_at(c, row) + c->t.wall_us;
+    printf("%lld.%06d, ", (long long)(t / 1000000), (int)(t % 1000000));
+}
+
+/**
+ * @brief Print rows [first, first + count) of the raw log with a capture time column.
+ *
+ * Times are rebuilt from each block's trailer (seconds, wall clock; seconds
+ * since boot if the clock was never set). Blocks written before timestamps
+ * were stored get an empty time column.
+ */
+void blocklog_print_timed(uint32_t first, uint32_t count) {
+    uint32_t last = (count > UINT32_MAX - first) ? UINT32_MAX : first + count;
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    if (blocklog_init() != ESP_OK || used == 0) {
+        printf("error,message\r\n,Raw log is empty\r\n");
+        return;
+    }
+    const void *map;
+    esp_partition_mmap_handle_t map_handle;
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &map_handle) != ESP_OK) {
+        return;
+    }
+
+    bool header = false;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint8_t *blk = (const uint8_t *)map + ((head + i) % nblocks) * BLOCKLOG_BLOCK_SIZE;
+        const blocklog_hdr_t *h = (const blocklog_hdr_t *)blk;
+        const uint8_t *payload = blk + sizeof *h;
+        if (!blocklog_hdr_valid(h) || h->first_index >= last || h->first_index + h->count <= first ||
+            esp_rom_crc32_le(0, payload, h->len) != h->crc) {
+            continue;
+        }
+        const logger_channel_t *ch = logger_channel_by_id(h->channel);
+        if (!header) {
+            printf("time_s,%s\n", ch ? ch->csv_header : "index,value");
+            header = true;
+        }
+
+        blocklog_clock_t clk;
+        size_t rows_len = blocklog_clock_init(&clk, h, payload);
+        uint32_t from = first > h->first_index ? first - h->first_index : 0;
+        uint32_t to = last < h->first_index + h->count ? last - h->first_index : h->count;
+
+        if (h->codec == BLOCKLOG_CODEC_PACK12) {
+            float val[LOGGER_CONV_BATCH];
+            for (uint32_t r = from & ~1u; ch && r < to; r += LOGGER_CONV_BATCH) {
+                int n = blocklog_pack12_batch(payload, ch, r, to, val);
+                for (int k = 0; k < n; k++) {
+                    if (r + k >= from) {
+                        blocklog_print_time(&clk, r + k);
+                        printf(ch->row_fmt, (int)(h->first_index + r + k), val[k]);
+                    }
+                }
+            }
+            continue;
+        }
+
+        const uint8_t *p = payload + blocklog_row_offset(payload, rows_len, from);
+        const uint8_t *end = payload + rows_len;
+        for (uint32_t r = from; r < to && p < end; r++) {
+            const uint8_t *nl = memchr(p, '\n', end - p);
+            if (!nl) {
+                break;
+            }
+            blocklog_print_time(&clk, r);
+            fwrite(p, 1, nl - p + 1, stdout);
+            p = nl + 1;
+        }
+    }
+    fflush(stdout);
+    esp_partition_munmap(map_handle);
+}
+
+/**
+ * @brief Find the first row captured at or after 'wall_us' (same clock as blocklog_print_timed()).
+ *
+ * Only block headers and trailers are read: the block is picked by its time
+ * span, and the row inside it by binary search over the implicit times. If
+ * several blocks cover the time (clock not set, so every boot starts at 0),
+ * the most recently written one wins.
+ *
+ * @return ESP_ERR_NOT_FOUND if no timed block ends at or after 'wall_us'
+ */
+esp_err_t blocklog_seek_time(int64_t wall_us, uint32_t *index) {
+    if (!part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const void *map;
+    esp_partition_mmap_handle_t map_handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &map_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const uint8_t *found = NULL;   // block covering wall_us, else the first one after it
+    bool covers = false;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint8_t *blk = (const uint8_t *)map + ((head + i) % nblocks) * BLOCKLOG_BLOCK_SIZE;
+        const blocklog_hdr_t *h = (const blocklog_hdr_t *)blk;
+        blocklog_clock_t clk;
+        if (!blocklog_hdr_valid(h) || h->count == 0) {
+            continue;
+        }
+        blocklog_clock_init(&clk, h, blk + sizeof *h);
+        if (clk.t.period_us == 0) {
+            continue;
+        }
+        int64_t t_first = clk.t.t0_us + clk.t.wall_us;
+        int64_t t_last = blocklog_clock_at(&clk, h->count - 1) + clk.t.wall_us;
+        if (wall_us >= t_first && wall_us <= t_last) {
+            found = blk;
+            covers = true;
+        } else if (!covers && !found && t_first > wall_us) {
+            found = blk;
+        }
+    }
+
+    err = ESP_ERR_NOT_FOUND;
+    if (found) {
+        const blocklog_hdr_t *h = (const blocklog_hdr_t *)found;
+        uint32_t lo = 0, hi = h->count - 1;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            blocklog_clock_t clk;
+            blocklog_clock_init(&clk, h, found + sizeof *h);
+            if (blocklog_clock_at(&clk, mid) + clk.t.wall_us < wall_us) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        *index = h->first_index + lo;
+        err = ESP_OK;
+    }
+    esp_partition_munmap(map_handle);
+    return err;
+}
+
+/**
+ * @brief Benchmarks fill the raw log with synthetic blocks: refuse to wipe a real one.
+ */
+static bool blocklog_bench_empty(void) {
+    if (used > 0) {
+        printf("[-] raw log holds %u blocks: 'rm raw' first\n", (unsigned)used);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Compare export throughput of the stdio path and the mmap path.
+ *
+ * Writes the same 'rows' synthetic thermistor rows to "/spiffs/bench.csv"
+ * and to the raw log (which must be empty: 'rm raw' first), then times:
+ *   - read only: fread() into a 256-byte buffer vs. walking the mapped blocks
+ *   - to console: print_csv_file_only() vs. blocklog_print_csv()
+ * The console numbers are bounded by the baud rate; the read-only numbers
+ * show the cost of the storage path itself. SPIFFS must be mounted.
+ */
+void blocklog_bench_export(int rows) {
+    const char *path = "/spiffs/bench.csv";
+
+    if (blocklog_init() != ESP_OK || !blocklog_bench_empty()) {
+        return;
+    }
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        printf("open for write failed: %s\n", path);
+        return;
+    }
+    blocklog_erase_all();
+
+    // Same bytes go to both stores
+    static char payload[BLOCKLOG_PAYLOAD_MAX];
+    blocklog_hdr_t h = { .channel = LOGGER_CH_THERMISTOR.id, .codec = BLOCKLOG_CODEC_CSV };
+    size_t len = 0;
+    fprintf(f, "%s\n", LOGGER_CH_THERMISTOR.csv_header);
+    for (int i = 0; i < rows; i++) {
+        char row[32];
+        int n = snprintf(row, sizeof row, LOGGER_CH_THERMISTOR.row_fmt, i, 23.7 + (i % 40) * 0.01);
+        if (len + n > sizeof payload) {
+            h.len = len;
+            blocklog_append(&h, payload);
+            h.first_index = i;
+            h.count = 0;
+            len = 0;
+        }
+        memcpy(payload + len, row, n);
+        len += n;
+        blocklog_hdr_add(&h, 23.7f + (i % 40) * 0.01f);
+        fwrite(row, 1, n, f);
+    }
+    h.len = len;
+    blocklog_append(&h, payload);
+    fclose(f);
+    blkcache_invalidate(path, 0);
+
+    // Read only: stdio
+    size_t bytes_stdio = 0;
+    int64_t t0 = esp_timer_get_time();
+    f = fopen(path, "r");
+    if (f) {
+        char buf[256];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, f)) > 0) {
+            bytes_stdio += n;
+        }
+        fclose(f);
+    }
+    int64_t t_stdio = esp_timer_get_time() - t0;
+
+    // Read only: mmap
+    size_t bytes_mmap = 0;
+    t0 = esp_timer_get_time();
+    blocklog_export(blocklog_null_write, &bytes_mmap);
+    int64_t t_mmap = esp_timer_get_time() - t0;
+
+    // To console: both paths end up waiting for the UART
+    t0 = esp_timer_get_time();
+    print_csv_file_only(path);
+    fflush(stdout);
+    int64_t t_stdio_con = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    blocklog_print_csv();
+    int64_t t_mmap_con = esp_timer_get_time() - t0;
+
+    remove(path);
+    esp_log_level_set("*", ESP_LOG_INFO);
+
+    printf("\n[*] export bench, %d rows\n", rows);
+    printf("    read only : stdio %u B in %lld us (%lld KB/s), mmap %u B in %lld us (%lld KB/s)\n",
+           (unsigned)bytes_stdio, (long long)t_stdio, (long long)(bytes_stdio * 1000LL / (t_stdio + 1)),
+           (unsigned)bytes_mmap, (long long)t_mmap, (long long)(bytes_mmap * 1000LL / (t_mmap + 1)));
+    printf("    to console: stdio %lld us, mmap %lld us\n",
+           (long long)t_stdio_con, (long long)t_mmap_con);
+}
+
+/**
+ * @brief Time the 12-bit pack/unpack kernels and compare bytes per sample with CSV.
+ *
+ * Uses 'samples' synthetic thermistor codes (slow drift plus noise, i.e.
+ * what the logger stores). Each kernel runs over the whole array a few
+ * times; the scalar and SWAR versions must produce identical bytes and the
+ * round trip must give back every code.
+ */
+void blocklog_bench_pack(int samples) {
+    const int passes = 8;
+    uint16_t *codes = malloc(samples * sizeof *codes);
+    uint16_t *back = malloc(samples * sizeof *back);
+    uint8_t *a = malloc(codec_pack12_len(samples));
+    uint8_t *b = malloc(codec_pack12_len(samples));
+    if (!codes || !back || !a || !b) {
+        printf("[-] bench pack: out of memory for %d samples\n", samples);
+        free(codes);
+        free(back);
+        free(a);
+        free(b);
+        return;
+    }
+
+    size_t csv_bytes = 0;
+    uint32_t rng = 1;
+    for (int i = 0; i < samples; i++) {
+        rng = rng * 1103515245u + 12345u;
+        codes[i] = (uint16_t)(2048 + 600 * sinf(i / 5000.0f) + (int)((rng >> 16) % 9) - 4);
+        char row[32];
+        csv_bytes += snprintf(row, sizeof row, LOGGER_CH_THERMISTOR.row_fmt, i,
+                              LOGGER_CH_THERMISTOR.convert(codes[i]));
+    }
+
+    static const char *names[] = { "pack scalar", "pack SWAR", "unpack scalar", "unpack SWAR" };
+    int64_t us[4];
+    int64_t t0 = esp_timer_get_time();
+    for (int p = 0; p < passes; p++) {
+        codec_pack12_scalar(codes, samples, a);
+    }
+    us[0] = esp_timer_get_time() - t0;
+    t0 = esp_timer_get_time();
+    for (int p = 0; p < passes; p++) {
+        codec_pack12(codes, samples, b);
+    }
+    us[1] = esp_timer_get_time() - t0;
+    bool same = memcmp(a, b, codec_pack12_len(samples)) == 0;
+
+    t0 = esp_timer_get_time();
+    for (int p = 0; p < passes; p++) {
+        codec_unpack12_scalar(a, samples, back);
+    }
+    us[2] = esp_timer_get_time() - t0;
+    same = same && memcmp(codes, back, samples * sizeof *back) == 0;
+    t0 = esp_timer_get_time();
+    for (int p = 0; p < passes; p++) {
+        codec_unpack12(a, samples, back);
+    }
+    us[3] = esp_timer_get_time() - t0;
+    same = same && memcmp(codes, back, samples * sizeof *back) == 0;
+
+    printf("[*] 12-bit packing bench, %d samples x %d passes%s\n", samples, passes,
+           same ? "" : " - MISMATCH");
+    for (int i = 0; i < 4; i++) {
+        printf("    %-13s: %lld us, %lld ksamples/s\n", names[i], (long long)us[i],
+               (long long)samples * passes * 1000LL / (us[i] + 1));
+    }
+    printf("    bytes/sample: packed %.2f, uint16 2.00, CSV rows %.2f\n",
+           (double)codec_pack12_len(samples) / samples, (double)csv_bytes / samples);
+
+    free(codes);
+    free(back);
+    free(a);
+    free(b);
+}
+
+/**
+ * @brief Check whether a block's [vmin, vmax] range can contain a match.
+ */
+static bool blocklog_zone_may_match(const blocklog_hdr_t *h, const blocklog_pred_t *p) {
+    if (h->version < 2) {
+        return true;   // no zone map: must read the block
+    }
+    float vmin = h->vmin, vmax = h->vmax;
+    if (h->codec == BLOCKLOG_CODEC_PACK12) {
+        // Raw codes, decoded with the current parameters: so is the zone map.
+        // Before version 4 it holds values converted with whatever parameters
+        // were current at write time, which may no longer match the rows.
+        const logger_channel_t *ch = logger_channel_by_id(h->channel);
+        if (h->version < 4 || !ch) {
+            return true;
+        }
+        // Both conversions are monotonic, so the extreme codes give the extreme values
+        float a = ch->convert((int)h->vmin), b = ch->convert((int)h->vmax);
+        if (isnan(a) || isnan(b)) {
+            return true;
+        }
+        vmin = a < b ? a : b;
+        vmax = a < b ? b : a;
+    }
+    switch (p->op) {
+    case BLOCKLOG_GT:      return vmax > p->a;
+    case BLOCKLOG_LT:      return vmin < p->a;
+    case BLOCKLOG_BETWEEN: return vmax >= p->a && vmin <= p->b;
+    }
+    return true;
+}
+
+/**
+ * @brief Evaluate the predicate for one value.
+ */
+static bool blocklog_pred_match(float v, const blocklog_pred_t *p) {
+    switch (p->op) {
+    case BLOCKLOG_GT:      return v > p->a;
+    case BLOCKLOG_LT:      return v < p->a;
+    case BLOCKLOG_BETWEEN: return v >= p->a && v <= p->b;
+    }
+    return false;
+}
+
+/**
+ * @brief Find all rows of 'channel' whose value satisfies 'pred', oldest first.
+ *
+ * Blocks whose zone map rules out a match are skipped using the header only;
+ * the others are parsed straight from mapped flash. 'match' (may be NULL) is
+ * called for every matching row. 'st' (may be NULL) receives how many blocks
+ * had to be read, which is the point of the zone maps.
+ */
+esp_err_t blocklog_query(uint8_t channel, const blocklog_pred_t *pred,
+                         blocklog_match_fn match, void *ctx, blocklog_query_stats_t *st) {
+    blocklog_query_stats_t q = {0};
+    if (!part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const void *map;
+    esp_partition_mmap_handle_t map_handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &map_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    bool stop = false;
+    for (uint32_t i = 0; i < nblocks && !stop; i++) {
+        const uint8_t *blk = (const uint8_t *)map + ((head + i) % nblocks) * BLOCKLOG_BLOCK_SIZE;
+        const blocklog_hdr_t *h = (const blocklog_hdr_t *)blk;
+        if (!blocklog_hdr_valid(h) || h->channel != channel) {
+            continue;
+        }
+        q.blocks++;
+        if (!blocklog_zone_may_match(h, pred)) {
+            continue;
+        }
+        q.blocks_read++;
+
+        if (h->codec == BLOCKLOG_CODEC_PACK12) {
+            const logger_channel_t *ch = logger_channel_by_id(h->channel);
+            float val[LOGGER_CONV_BATCH];
+            for (uint32_t r = 0; ch && r < h->count && !stop; r += LOGGER_CONV_BATCH) {
+                int n = blocklog_pack12_batch(blk + sizeof *h, ch, r, h->count, val);
+                for (int i = 0; i < n && !stop; i++) {
+                    q.rows_scanned++;
+                    if (blocklog_pred_match(val[i], pred)) {
+                        q.matches++;
+                        if (match && !match(h->first_index + r + i, val[i], ctx)) {
+                            stop = true;
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Rows look like "#<index>, <value><unit>\n"
+        const char *p = (const char *)blk + sizeof *h;
+        blocklog_clock_t clk;
+        const char *end = p + blocklog_clock_init(&clk, h, blk + sizeof *h);
+        while (p < end && !stop) {
+            const char *nl = memchr(p, '\n', end - p);
+            if (!nl) {
+                break;
+            }
+            if (*p == '#') {
+                char *after;
+                uint32_t index = strtoul(p + 1, &after, 10);
+                float v = strtof(after + 1, NULL);   // skip the ','
+                q.rows_scanned++;
+                if (blocklog_pred_match(v, pred)) {
+                    q.matches++;
+                    if (match && !match(index, v, ctx)) {
+                        stop = true;
+                    }
+                }
+            }
+            p = nl + 1;
+        }
+    }
+
+    esp_partition_munmap(map_handle);
+    if (st) {
+        *st = q;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Report the fraction of blocks read for typical threshold queries on a full raw log.
+ *
+ * Fills every block of the (empty) raw log with a synthetic thermistor trace
+ * (slow 18–32 °C swing plus noise, i.e. what a day of room/outdoor logging
+ * looks like), then runs a few threshold queries and prints blocks read vs.
+ * total for each.
+ */
+void blocklog_bench_query(void) {
+    if (blocklog_init() != ESP_OK || !blocklog_bench_empty()) {
+        return;
+    }
+    blocklog_erase_all();
+
+    static char payload[BLOCKLOG_PAYLOAD_MAX];
+    blocklog_hdr_t h = { .channel = LOGGER_CH_THERMISTOR.id, .codec = BLOCKLOG_CODEC_CSV };
+    size_t len = 0;
+    uint32_t rng = 1;
+    uint32_t index = 0;
+    const uint32_t rows = nblocks * 300;   // roughly fills every block
+
+    for (uint32_t blocks = 0; blocks < nblocks; index++) {
+        // One full swing over the partition, +-0.1 °C of noise
+        float phase = (float)index / rows;
+        float t = 25.0f - 7.0f * cosf(2.0f * 3.14159265f * phase);
+        rng = rng * 1103515245u + 12345u;
+        t += ((int)((rng >> 16) % 21) - 10) * 0.01f;
+
+        char row[32];
+        int n = snprintf(row, sizeof row, LOGGER_CH_THERMISTOR.row_fmt, (int)index, t);
+        if (len + n > sizeof payload) {
+            h.len = len;
+            blocklog_append(&h, payload);
+            blocks++;
+            h.first_index = index;
+            h.count = 0;
+            len = 0;
+        }
+        memcpy(payload + len, row, n);
+        len += n;
+        blocklog_hdr_add(&h, t);
+    }
+
+    static const blocklog_pred_t queries[] = {
+        { BLOCKLOG_GT, 30.0f, 0 },
+        { BLOCKLOG_GT, 25.0f, 0 },
+        { BLOCKLOG_LT, 20.0f, 0 },
+        { BLOCKLOG_BETWEEN, 24.0f, 24.5f },
+    };
+    static const char *names[] = { "> 30", "> 25", "< 20", "24..24.5" };
+
+    printf("[*] zone map bench, %u blocks\n", (unsigned)nblocks);
+    for (size_t i = 0; i < sizeof queries / sizeof queries[0]; i++) {
+        blocklog_query_stats_t st;
+        int64_t t0 = esp_timer_get_time();
+        blocklog_query(LOGGER_CH_THERMISTOR.id, &queries[i], NULL, NULL, &st);
+        int64_t dt = esp_timer_get_time() - t0;
+        printf("    %-9s: %u matches, read %u/%u blocks (%u%%), %lld us\n",
+               names[i], (unsigned)st.matches, (unsigned)st.blocks_read, (unsigned)st.blocks,
+               (unsigned)(st.blocks ? st.blocks_read * 100 / st.blocks : 0), (long long)dt);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef BLOCKLOG_H
+#define BLOCKLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Raw block log on the "rawlog" data partition (see partitions.csv).
+// The partition is used as a ring of fixed-size blocks, one flash sector each,
+// so it can be memory-mapped and exported without going through SPIFFS/VFS.
+#define BLOCKLOG_PARTITION    "rawlog"
+#define BLOCKLOG_BLOCK_SIZE   4096         // one flash sector
+#define BLOCKLOG_MAGIC        0x314B4C42   // "BLK1"
+#define BLOCKLOG_VERSION      4            // 2: zone map (vmin/vmax) in the header, 3: flags + time trailer,
+                                           // 4: PACK12 zone map in raw codes
+#define BLOCKLOG_EXPORT_CHUNK 2048         // bytes handed to the console driver per write
+#define BLOCKLOG_CKPT_INTERVAL_S 60        // min. time between NVS checkpoints of the write cursor
+
+// Payload formats
+#define BLOCKLOG_CODEC_CSV    0            // CSV rows, exactly as they would appear in a .csv file
+#define BLOCKLOG_CODEC_PACK12 1            // raw ADC codes, 12 bits each (codec_pack12()), converted on export
+
+// Header flags (version >= 3)
+#define BLOCKLOG_FLAG_TIME    0x01         // payload ends with capture times (blocklog_time_t trailer)
+
+// Implicit timestamps: a periodic stream only needs its first capture time and
+// the nominal period; a row whose real capture time is more than
+// BLOCKLOG_TIME_JITTER_US off the grid gets an explicit correction, and the
+// grid continues from that row. A change of sample period ('rate', adaptive
+// sampling) is an entry of its own, so a block can span several periods.
+// Records are contiguous within a block (row k has index first_index + k), so
+// a row's time follows from its position.
+#define BLOCKLOG_TIME_JITTER_US 100        // largest error of an implicit timestamp
+#define BLOCKLOG_TIME_EXC_MAX   32         // corrections per block before it is committed early
+
+#define BLOCKLOG_EXC_PERIOD     0x01       // entry sets a new period ('dt_us') from its row on
+
+// Correction for one row: its capture time minus the time predicted for it
+typedef struct {
+    uint16_t row;          // position in the block
+    uint16_t flags;        // BLOCKLOG_EXC_*
+    int32_t  dt_us;        // correction, or the new period with BLOCKLOG_EXC_PERIOD
+} blocklog_time_exc_t;
+
+// Last bytes of a timed payload, preceded by 'n_exc' blocklog_time_exc_t
+typedef struct {
+    int64_t  t0_us;        // capture time of row 0 (esp_timer, microseconds since boot)
+    int64_t  wall_us;      // wall clock minus esp_timer when the block started
+    uint32_t period_us;    // nominal sample period of row 0
+    uint16_t n_exc;        // corrections stored before this trailer
+    uint16_t jitter_us;    // BLOCKLOG_TIME_JITTER_US when written
+} blocklog_time_t;
+
+// Writer side: builds the trailer while a block fills up
+typedef struct {
+    blocklog_time_t t;
+    blocklog_time_exc_t exc[BLOCKLOG_TIME_EXC_MAX];
+    uint32_t anchor_row;   // last row with an exact time (0 or a corrected row)
+    int64_t  anchor_us;
+    uint32_t period_us;    // current period
+} blocklog_stamps_t;
+
+// Header at the start of every block. The header is written after the payload,
+// so a block only becomes valid once its data is completely in flash.
+typedef struct {
+    uint32_t magic;        // BLOCKLOG_MAGIC (erased flash reads 0xFFFFFFFF)
+    uint32_t seq;          // block sequence number, +1 per block written
+    uint32_t first_index;  // sample index of the first record
+    uint16_t count;        // records in this block
+    uint16_t len;          // payload bytes
+    uint8_t  version;      // BLOCKLOG_VERSION
+    uint8_t  codec;        // BLOCKLOG_CODEC_*
+    uint8_t  channel;      // logger channel id
+    uint8_t  flags;        // BLOCKLOG_FLAG_* (0 before version 3)
+    float    vmin;         // zone map: smallest value in the block (version >= 2; PACK12
+    float    vmax;         //   from version 4: smallest/largest raw code, converted when queried)
+    uint32_t crc;          // crc32 of the payload
+} blocklog_hdr_t;
+
+#define BLOCKLOG_PAYLOAD_MAX  (BLOCKLOG_BLOCK_SIZE - sizeof(blocklog_hdr_t))
+
+// Destination for exported bytes
+typedef void (*blocklog_write_fn)(const void *data, size_t len, void *ctx);
+
+// Value predicate for blocklog_query()
+typedef enum {
+    BLOCKLOG_GT,           // value > a
+    BLOCKLOG_LT,           // value < a
+    BLOCKLOG_BETWEEN,      // a <= value <= b
+} blocklog_op_t;
+
+typedef struct {
+    blocklog_op_t op;
+    float a;
+    float b;
+} blocklog_pred_t;
+
+// What a query had to touch
+typedef struct {
+    uint32_t blocks;       // blocks of the channel in the log
+    uint32_t blocks_read;  // blocks whose zone map could match (payload scanned)
+    uint32_t rows_scanned;
+    uint32_t matches;
+} blocklog_query_stats_t;
+
+// Called for every matching row; return false to stop the query
+typedef bool (*blocklog_match_fn)(uint32_t index, float value, void *ctx);
+
+esp_err_t blocklog_init(void);
+esp_err_t blocklog_append(blocklog_hdr_t *hdr, const void *payload);
+void blocklog_checkpoint(bool force);
+void blocklog_hdr_add(blocklog_hdr_t *hdr, float value);
+void blocklog_stamps_add(blocklog_stamps_t *s, uint32_t row, int64_t t_us, uint32_t period_us);
+size_t blocklog_stamps_len(const blocklog_stamps_t *s);
+size_t blocklog_stamps_write(const blocklog_stamps_t *s, void *dst);
+uint32_t blocklog_next_index(void);
+esp_err_t blocklog_erase_all(void);
+uint32_t blocklog_block_count(void);
+
+// Zero-copy export (Demo 3.5)
+esp_err_t blocklog_export(blocklog_write_fn write, void *ctx);
+esp_err_t blocklog_export_range(uint32_t first, uint32_t count, blocklog_write_fn write, void *ctx);
+void blocklog_console_write(const void *data, size_t len, void *ctx);
+void blocklog_print_csv(void);
+void blocklog_print_range(uint32_t first, uint32_t count);
+void blocklog_print_timed(uint32_t first, uint32_t count);
+esp_err_t blocklog_seek_time(int64_t wall_us, uint32_t *index);
+void blocklog_bench_export(int rows);
+void blocklog_bench_pack(int samples);
+
+// Zone-map queries
+esp_err_t blocklog_query(uint8_t channel, const blocklog_pred_t *pred,
+                         blocklog_match_fn match, void *ctx, blocklog_query_stats_t *st);
+void blocklog_bench_query(void);
+
+#endif
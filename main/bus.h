@@ -0,0 +1,89 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "pool.h"
+
+// Publish/subscribe bus for pool blocks: the producer publishes each block
+// once and every subscriber reads the same block in place, each at its own
+// pace through its own cursor. Blocks are reference counted; the last one to
+// let go of a block returns it to the pool.
+//
+// The bus keeps the last 'len' blocks in a ring and holds one reference on
+// each, so a subscriber can fall up to 'len' blocks behind. What happens when
+// it falls further is its overflow policy:
+//   BUS_LOSSLESS  the producer can't publish while this subscriber is a full
+//                 ring behind (bus_publish() fails; the producer drops data)
+//   BUS_DROP      the subscriber skips ahead to the newest block and counts
+//                 the blocks it missed; the producer never waits for it
+// The pool needs more blocks than the ring: 'len' are held by the ring, plus
+// one per subscriber reading, plus the one the producer is filling.
+#define BUS_SUBS_MAX   4
+
+// Every published block starts with this header
+typedef struct {
+    uint32_t seq;            // bus sequence number (the pool's free-list link while free)
+    uint32_t ref;            // references: the ring slot plus subscribers reading it; 0 = free
+} bus_hdr_t;
+
+typedef enum {
+    BUS_LOSSLESS,
+    BUS_DROP,
+} bus_policy_t;
+
+typedef struct {
+    const char *name;
+    bus_policy_t policy;
+    TaskHandle_t task;       // notified on every publish (NULL: the subscriber polls)
+    uint32_t epoch;          // bus epoch it subscribed in (see bus_attached())
+    uint32_t cursor;         // sequence number of the next block to read
+    uint32_t blocks;         // blocks read
+    uint32_t missed;         // blocks skipped because the ring lapped this subscriber (BUS_DROP)
+} bus_sub_t;
+
+typedef struct {
+    const char *name;
+    pool_t   *pool;
+    bus_hdr_t **ring;        // owner's static storage, 'len' entries
+    uint32_t len;            // power of two
+    uint32_t head;           // sequence number of the next block to publish
+    uint32_t epoch;          // bumped by every bus_init(): subscribers of an earlier one are detached
+    bool     closed;         // bus_close() was called: bus_next() returns NULL
+    bus_sub_t *subs[BUS_SUBS_MAX];
+    uint32_t published;
+    uint32_t refused;        // bus_publish() calls refused for a lossless subscriber
+} bus_t;
+
+typedef struct {
+    const char *name;
+    uint32_t published;
+    uint32_t refused;
+    uint32_t n_subs;
+    struct {
+        const char *name;
+        bus_policy_t policy;
+        uint32_t blocks;
+        uint32_t missed;
+        uint32_t lag;        // blocks published but not yet read
+    } sub[BUS_SUBS_MAX];
+} bus_stats_t;
+
+void bus_init(bus_t *b, const char *name, pool_t *pool, bus_hdr_t **ring, uint32_t len);
+void bus_close(bus_t *b);
+bool bus_publish(bus_t *b, bus_hdr_t *blk, BaseType_t *woken);
+esp_err_t bus_subscribe(bus_t *b, bus_sub_t *s, const char *name, bus_policy_t policy, TaskHandle_t task);
+void bus_unsubscribe(bus_t *b, bus_sub_t *s);
+bool bus_attached(const bus_t *b, const bus_sub_t *s);
+bus_hdr_t *bus_next(bus_t *b, bus_sub_t *s);
+void bus_release(bus_t *b, bus_sub_t *s, bus_hdr_t *blk);
+uint32_t bus_lag(const bus_t *b, const bus_sub_t *s);
+void bus_get_stats(const bus_t *b, bus_stats_t *out);
+
+// Publish and read back blocks with 0..BUS_SUBS_MAX subscribers; time the fan-out per consumer
+void bus_bench(int blocks);
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @file chstats.c
+ * @brief Streaming statistics per channel: Welford mean/variance and P² percentiles.
+ *
+ * Mean, standard deviation and percentiles of a run used to mean exporting
+ * the whole CSV to Excel. The logger's statistics task (reading the sample
+ * bus) now feeds every sample into constant-size accumulators instead:
+ *
+ *   Welford:  mean += d / n;  m2 += d * (x - mean)   with d = x - old mean
+ *             (variance = m2 / (n - 1), without the cancellation of sum(x²))
+ *   P²:       (Jain & Chlamtac) five markers per quantile at the min, p/2, p,
+ *             (1 + p)/2 and the max. Each sample shifts the markers above it;
+ *             a marker that drifts a whole position away from where it should
+ *             be is moved by one, its height adjusted by a parabola through
+ *             its neighbours (or linearly if that would break the ordering).
+ *
+ * Every channel has a since-boot accumulator and a tumbling time window; the
+ * window that just ended is kept for readers. One writer (the statistics task),
+ * any number of readers: like the hot window, 'gen' is odd while an update is
+ * in progress and a reader retries its copy until it saw a stable one.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_timer.h"
+#include "chstats.h"
+
+static const float quantiles[CHSTATS_QUANTILES] = { 0.50f, 0.95f, 0.99f };
+
+typedef struct {
+    uint32_t gen;                  // odd while the writer updates the accumulators
+    chstats_acc_t acc[3];          // indexed by chstats_span_t
+    uint32_t window_s;
+    uint32_t reset_req;            // bumped by chstats_reset() ...
+    uint32_t reset_done;           // ... and applied by the writer
+} chstats_ch_t;
+
+static chstats_ch_t chs[CHSTATS_CHANNELS];
+static volatile bool enabled = true;
+
+/**
+ * @brief Empty accumulator with its P² estimators set up.
+ */
+static void chstats_clear(chstats_acc_t *a) {
+    memset(a, 0, sizeof *a);
+    for (int i = 0; i < CHSTATS_QUANTILES; i++) {
+        chstats_p2_t *e = &a->pct[i];
+        e->p = quantiles[i];
+        for (int k = 0; k < 5; k++) {
+            e->n[k] = k;
+        }
+    }
+}
+
+/**
+ * @brief Add a sample to one P² estimator; 'count' includes this sample.
+ */
+static void chstats_p2_add(chstats_p2_t *e, uint32_t count, float x) {
+    float *q = e->q;
+    if (count <= 5) {
+        // Collect the first five samples in order
+        int k = (int)count - 1;
+        while (k > 0 && q[k - 1] > x) {
+            q[k] = q[k - 1];
+            k--;
+        }
+        q[k] = x;
+        return;
+    }
+
+    // Cell the sample falls into; the extreme markers follow new extremes
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= q[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++) {
+        e->n[i]++;
+    }
+    // Desired positions of the middle markers: (count - 1) * {p/2, p, (1+p)/2}.
+    // Computed from the count rather than summed up per sample, which drifts
+    // in float after some 10^5 samples.
+    const float dn[5] = { 0, e->p / 2, e->p, (1 + e->p) / 2, 1 };
+
+    // Move the middle markers that are off by a whole position
+    for (int i = 1; i < 4; i++) {
+        float d = (float)(count - 1) * dn[i] - e->n[i];
+        if ((d >= 1 && e->n[i + 1] - e->n[i] > 1) || (d <= -1 && e->n[i - 1] - e->n[i] < -1)) {
+            int s = d > 0 ? 1 : -1;
+            float n0 = e->n[i - 1], n1 = e->n[i], n2 = e->n[i + 1];
+            float qp = q[i] + s / (n2 - n0) * ((n1 - n0 + s) * (q[i + 1] - q[i]) / (n2 - n1) +
+                                               (n2 - n1 - s) * (q[i] - q[i - 1]) / (n1 - n0));
+            if (q[i - 1] < qp && qp < q[i + 1]) {
+                q[i] = qp;
+            } else {
+                q[i] += s * (q[i + s] - q[i]) / (float)(e->n[i + s] - e->n[i]);
+            }
+            e->n[i] += s;
+        }
+    }
+}
+
+/**
+ * @brief Current estimate of a P² quantile.
+ */
+static float chstats_p2_get(const chstats_p2_t *e, uint32_t count) {
+    if (count == 0) {
+        return NAN;
+    }
+    if (count < 5) {
+        return e->q[(int)lroundf(e->p * (count - 1))];   // exact on the sorted samples
+    }
+    return e->q[2];
+}
+
+static void chstats_acc_add(chstats_acc_t *a, int64_t t_us, float x) {
+    uint32_t n = ++a->count;
+    if (n == 1) {
+        a->min = a->max = x;
+        a->first_us = t_us;
+    } else {
+        a->min = x < a->min ? x : a->min;
+        a->max = x > a->max ? x : a->max;
+    }
+    a->last_us = t_us;
+
+    float d = x - a->mean;
+    a->mean += d / n;
+    a->m2 += d * (x - a->mean);
+
+    for (int i = 0; i < CHSTATS_QUANTILES; i++) {
+        chstats_p2_add(&a->pct[i], n, x);
+    }
+}
+
+/**
+ * @brief Add one sample of a channel to its accumulators. Statistics task only.
+ */
+void chstats_push(uint8_t ch_id, int64_t t_us, float value) {
+    if (ch_id >= CHSTATS_CHANNELS || isnan(value)) {
+        return;
+    }
+    chstats_ch_t *c = &chs[ch_id];
+    __atomic_fetch_add(&c->gen, 1, __ATOMIC_ACQ_REL);   // odd: readers retry
+
+    uint32_t req = __atomic_load_n(&c->reset_req, __ATOMIC_ACQUIRE);
+    if (c->reset_done != req || c->acc[CHSTATS_BOOT].pct[0].p == 0) {
+        for (int s = 0; s < 3; s++) {
+            chstats_clear(&c->acc[s]);
+        }
+        c->reset_done = req;
+    }
+
+    // Tumbling window: the current one becomes the last one when it is over
+    chstats_acc_t *w = &c->acc[CHSTATS_WINDOW];
+    uint32_t window_s = c->window_s ? c->window_s : CHSTATS_WINDOW_S;
+    if (w->count > 0 && t_us - w->first_us >= (int64_t)window_s * 1000000) {
+        c->acc[CHSTATS_LAST_WINDOW] = *w;
+        chstats_clear(w);
+    }
+
+    chstats_acc_add(&c->acc[CHSTATS_BOOT], t_us, value);
+    chstats_acc_add(w, t_us, value);
+
+    __atomic_fetch_add(&c->gen, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Summary of one span of a channel; safe to call from any task at any time.
+ *
+ * @return false if the span has no samples (yet)
+ */
+bool chstats_get(uint8_t ch_id, chstats_span_t span, chstats_summary_t *out) {
+    if (ch_id >= CHSTATS_CHANNELS || span > CHSTATS_LAST_WINDOW) {
+        return false;
+    }
+    chstats_ch_t *c = &chs[ch_id];
+    chstats_acc_t a;
+    uint32_t gen;
+    do {
+        gen = __atomic_load_n(&c->gen, __ATOMIC_ACQUIRE);
+        a = c->acc[span];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((gen & 1) || __atomic_load_n(&c->gen, __ATOMIC_ACQUIRE) != gen);
+
+    if (a.count == 0 || __atomic_load_n(&c->reset_req, __ATOMIC_ACQUIRE) != c->reset_done) {
+        return false;
+    }
+    out->count = a.count;
+    out->min = a.min;
+    out->max = a.max;
+    out->mean = a.mean;
+    out->stddev = a.count > 1 ? sqrtf(a.m2 / (a.count - 1)) : 0;
+    out->p50 = chstats_p2_get(&a.pct[0], a.count);
+    out->p95 = chstats_p2_get(&a.pct[1], a.count);
+    out->p99 = chstats_p2_get(&a.pct[2], a.count);
+    out->first_us = a.first_us;
+    out->last_us = a.last_us;
+    return true;
+}
+
+/**
+ * @brief Start all spans of a channel over; applied with its next sample.
+ */
+void chstats_reset(uint8_t ch_id) {
+    if (ch_id < CHSTATS_CHANNELS) {
+        __atomic_fetch_add(&chs[ch_id].reset_req, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief Length of a channel's window; the current window keeps its start.
+ */
+void chstats_set_window(uint8_t ch_id, uint32_t window_s) {
+    if (ch_id < CHSTATS_CHANNELS && window_s > 0) {
+        chs[ch_id].window_s = window_s;
+    }
+}
+
+uint32_t chstats_get_window(uint8_t ch_id) {
+    if (ch_id >= CHSTATS_CHANNELS) {
+        return 0;
+    }
+    return chs[ch_id].window_s ? chs[ch_id].window_s : CHSTATS_WINDOW_S;
+}
+
+/**
+ * @brief Turn the per-sample update on/off (from the next run on).
+ *
+ * Lazy runs convert every sample while it is on, since the statistics are
+ * kept in channel units.
+ */
+void chstats_enable(bool on) {
+    enabled = on;
+}
+
+bool chstats_enabled(void) {
+    return enabled;
+}
+
+/**
+ * @brief Cost of one update and accuracy of the P² estimates on a known distribution.
+ *
+ * Feeds 'samples' values of a scratch accumulator (not a channel's): uniform
+ * noise from a fixed LCG, so the exact quantiles are known, and times the
+ * updates.
+ */
+void chstats_bench(int samples) {
+    static chstats_acc_t a;
+    chstats_clear(&a);
+    uint32_t rng = 1;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < samples; i++) {
+        rng = rng * 1103515245u + 12345u;
+        float x = (float)((rng >> 8) & 0xFFFF) / 65536.0f;   // uniform [0, 1)
+        chstats_acc_add(&a, i, x);
+    }
+    int64_t dt = esp_timer_get_time() - t0;
+
+    printf("[*] chstats bench: %d samples, %.2f us per update (%d quantiles)\n",
+           samples, samples ? (double)dt / samples : 0.0, CHSTATS_QUANTILES);
+    printf("    mean %.4f (exact 0.5), stddev %.4f (exact %.4f)\n",
+           a.mean, a.count > 1 ? sqrtf(a.m2 / (a.count - 1)) : 0.0f, sqrtf(1.0f / 12));
+    for (int i = 0; i < CHSTATS_QUANTILES; i++) {
+        printf("    p%02d  %.4f (exact %.2f)\n", (int)lroundf(quantiles[i] * 100),
+               chstats_p2_get(&a.pct[i], a.count), quantiles[i]);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CHSTATS_H
+#define CHSTATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming statistics per channel, updated by the logger's statistics task
+// (a subscriber of the sample bus) for every sample: count, min, max, mean and variance (Welford) and p50/p95/p99 (P²
+// estimators, five markers each). Memory is constant, whatever the number of
+// samples. Three accumulators per channel: since boot (or 'reset'), the
+// current time window, and the last complete window.
+#define CHSTATS_CHANNELS    2                   // indexed by LOGGER_CH_ID_*
+#define CHSTATS_WINDOW_S    60                  // default window length
+#define CHSTATS_QUANTILES   3                   // p50, p95, p99
+
+typedef enum {
+    CHSTATS_BOOT,            // since boot or the last chstats_reset()
+    CHSTATS_WINDOW,          // current window (still filling)
+    CHSTATS_LAST_WINDOW,     // last complete window
+} chstats_span_t;
+
+// P² estimator of one quantile
+typedef struct {
+    float    p;              // quantile (0.5 = median)
+    float    q[5];           // marker heights; the first 5 samples, sorted, until count >= 5
+    int32_t  n[5];           // actual marker positions
+} chstats_p2_t;
+
+// Accumulator of one span
+typedef struct {
+    uint32_t count;
+    float    min, max;
+    float    mean;
+    float    m2;             // sum of squared deviations from the mean (Welford)
+    int64_t  first_us;       // capture time of the first sample
+    int64_t  last_us;
+    chstats_p2_t pct[CHSTATS_QUANTILES];
+} chstats_acc_t;
+
+// What a reader gets
+typedef struct {
+    uint32_t count;
+    float    min, max, mean, stddev;
+    float    p50, p95, p99;
+    int64_t  first_us, last_us;
+} chstats_summary_t;
+
+void chstats_push(uint8_t ch_id, int64_t t_us, float value);    // single writer: the statistics task
+bool chstats_get(uint8_t ch_id, chstats_span_t span, chstats_summary_t *out);
+void chstats_reset(uint8_t ch_id);
+void chstats_set_window(uint8_t ch_id, uint32_t window_s);
+uint32_t chstats_get_window(uint8_t ch_id);
+void chstats_enable(bool on);
+bool chstats_enabled(void);
+void chstats_bench(int samples);
+
+#endif
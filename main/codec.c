@@ -0,0 +1,151 @@
+/**
+ * @file codec.c
+ * @brief Delta + zigzag + bit-packing of integer sequences.
+ *
+ * Sensor data changes slowly from one sample to the next, so the deltas are
+ * small: an oversampled ADC code or a temperature with 0.01 °C resolution
+ * typically needs 2-6 bits per sample instead of 16 or 32. One width per
+ * sequence keeps the decoder branch-free; callers choose how long a
+ * sequence (block) is, trading a larger first value + header against
+ * outliers widening the whole block.
+ *
+ * 12-bit packing is the cheap alternative: every raw code keeps exactly its
+ * ADC_BITS, whatever the signal does.
+ */
+
+#include <string.h>
+#include "codec.h"
+
+/**
+ * @brief Smallest width (bits) that fits every zigzag delta of v[0..n).
+ */
+uint8_t codec_delta_width(const int32_t *v, int n) {
+    uint32_t all = 0;
+    for (int i = 1; i < n; i++) {
+        all |= codec_zigzag((int32_t)((uint32_t)v[i] - (uint32_t)v[i - 1]));
+    }
+    return all ? (uint8_t)(32 - __builtin_clz(all)) : 0;
+}
+
+/**
+ * @brief Pack the deltas of v[0..n) with 'width' bits each (v[0] is not stored).
+ *
+ * @return Bytes written to 'out' (codec_delta_len(n, width))
+ */
+size_t codec_delta_pack(const int32_t *v, int n, uint8_t width, uint8_t *out) {
+    uint64_t acc = 0;
+    int bits = 0;
+    size_t len = 0;
+    for (int i = 1; i < n && width; i++) {
+        acc |= (uint64_t)codec_zigzag((int32_t)((uint32_t)v[i] - (uint32_t)v[i - 1])) << bits;
+        bits += width;
+        while (bits >= 8) {
+            out[len++] = (uint8_t)acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits > 0) {
+        out[len++] = (uint8_t)acc;
+    }
+    return len;
+}
+
+/**
+ * @brief Rebuild n values from 'first' and the packed deltas.
+ */
+void codec_delta_unpack(const uint8_t *in, int n, uint8_t width, int32_t first, int32_t *out) {
+    uint64_t mask = width ? (1ull << width) - 1 : 0;
+    uint64_t acc = 0;
+    int bits = 0;
+    size_t pos = 0;
+
+    if (n > 0) {
+        out[0] = first;
+    }
+    for (int i = 1; i < n; i++) {
+        while (bits < width) {
+            acc |= (uint64_t)in[pos++] << bits;
+            bits += 8;
+        }
+        out[i] = (int32_t)((uint32_t)out[i - 1] + (uint32_t)codec_unzigzag((uint32_t)(acc & mask)));
+        acc >>= width;
+        bits -= width;
+    }
+}
+
+/**
+ * @brief Pack n 12-bit codes, one pair at a time (upper 4 bits of each code are ignored).
+ */
+void codec_pack12_scalar(const uint16_t *in, size_t n, uint8_t *out) {
+    size_t i = 0;
+    for (; i + 1 < n; i += 2) {
+        uint16_t a = in[i] & 0xFFF, b = in[i + 1] & 0xFFF;
+        *out++ = (uint8_t)a;
+        *out++ = (uint8_t)((a >> 8) | (b << 4));
+        *out++ = (uint8_t)(b >> 4);
+    }
+    if (i < n) {
+        // Odd count: the last code takes a byte and a half
+        *out++ = (uint8_t)in[i];
+        *out = (uint8_t)((in[i] >> 8) & 0x0F);
+    }
+}
+
+/**
+ * @brief Unpack n 12-bit codes, one pair at a time.
+ */
+void codec_unpack12_scalar(const uint8_t *in, size_t n, uint16_t *out) {
+    size_t i = 0;
+    for (; i + 1 < n; i += 2, in += 3) {
+        out[i] = in[0] | ((in[1] & 0x0F) << 8);
+        out[i + 1] = (in[1] >> 4) | (in[2] << 4);
+    }
+    if (i < n) {
+        out[i] = in[0] | ((in[1] & 0x0F) << 8);
+    }
+}
+
+/**
+ * @brief Pack n 12-bit codes, eight at a time in 32-bit words.
+ *
+ * SWAR version of codec_pack12_scalar() (same output): eight codes are 96
+ * bits, exactly three words, so each group is assembled with shifts in
+ * registers and leaves with three word stores instead of twelve byte
+ * stores. The ESP32-S3 SIMD unit has no 12-bit lane layout and is only
+ * reachable from assembly, so this is the vector kernel.
+ */
+void codec_pack12(const uint16_t *in, size_t n, uint8_t *out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8, out += 12) {
+        uint32_t c0 = in[i] & 0xFFF, c1 = in[i + 1] & 0xFFF, c2 = in[i + 2] & 0xFFF, c3 = in[i + 3] & 0xFFF;
+        uint32_t c4 = in[i + 4] & 0xFFF, c5 = in[i + 5] & 0xFFF, c6 = in[i + 6] & 0xFFF, c7 = in[i + 7] & 0xFFF;
+        uint32_t w[3] = {
+            c0 | (c1 << 12) | (c2 << 24),
+            (c2 >> 8) | (c3 << 4) | (c4 << 16) | (c5 << 28),
+            (c5 >> 4) | (c6 << 8) | (c7 << 20),
+        };
+        memcpy(out, w, sizeof w);   // little-endian; becomes plain word stores when 'out' is aligned
+    }
+    codec_pack12_scalar(in + i, n - i, out);
+}
+
+/**
+ * @brief Unpack n 12-bit codes, eight at a time from 32-bit words.
+ */
+void codec_unpack12(const uint8_t *in, size_t n, uint16_t *out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8, in += 12) {
+        uint32_t w[3];
+        memcpy(w, in, sizeof w);
+        out[i]     = w[0] & 0xFFF;
+        out[i + 1] = (w[0] >> 12) & 0xFFF;
+        out[i + 2] = (w[0] >> 24) | ((w[1] & 0x0F) << 8);
+        out[i + 3] = (w[1] >> 4) & 0xFFF;
+        out[i + 4] = (w[1] >> 16) & 0xFFF;
+        out[i + 5] = (w[1] >> 28) | ((w[2] & 0xFF) << 4);
+        out[i + 6] = (w[2] >> 8) & 0xFFF;
+        out[i + 7] = w[2] >> 20;
+    }
+    codec_unpack12_scalar(in, n - i, out + i);
+}
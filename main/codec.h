@@ -0,0 +1,42 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Integer codecs shared by the RAM history and the compacted log tier.
+// Delta coding: a sequence is stored as its first value plus the differences
+// between neighbours, zigzag-mapped to unsigned (0, -1, 1, -2 -> 0, 1, 2, 3)
+// and bit-packed LSB first, all with the same width.
+
+static inline uint32_t codec_zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t codec_unzigzag(uint32_t z) {
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+// Bytes taken by the packed deltas of 'n' values
+static inline size_t codec_delta_len(int n, uint8_t width) {
+    return n > 1 ? ((size_t)(n - 1) * width + 7) / 8 : 0;
+}
+
+uint8_t codec_delta_width(const int32_t *v, int n);
+size_t codec_delta_pack(const int32_t *v, int n, uint8_t width, uint8_t *out);
+void codec_delta_unpack(const uint8_t *in, int n, uint8_t width, int32_t first, int32_t *out);
+
+// 12-bit packing: raw ADC codes stored back to back, two per three bytes.
+// Code i occupies bits [12 i, 12 i + 12) of the stream, LSB first, so code i
+// (i even) starts at byte 3 i / 2. No modelling, no data-dependent branches:
+// a fixed 1.5 B/sample for when the CPU budget is too tight for delta coding.
+static inline size_t codec_pack12_len(size_t n) {
+    return (n * 3 + 1) / 2;
+}
+
+void codec_pack12(const uint16_t *in, size_t n, uint8_t *out);
+void codec_unpack12(const uint8_t *in, size_t n, uint16_t *out);
+void codec_pack12_scalar(const uint16_t *in, size_t n, uint8_t *out);
+void codec_unpack12_scalar(const uint8_t *in, size_t n, uint16_t *out);
+
+#endif
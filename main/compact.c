@@ -0,0 +1,564 @@
+/**
+ * @file compact.c
+ * @brief Background compaction of closed CSV logs into denser ".csz" segments.
+ *
+ * Logs are written as CSV because appending a text row is cheap and the file
+ * can be exported as-is, but at ~13 bytes per row that wastes most of the
+ * 960 KB SPIFFS partition on data nobody appends to any more. Like the lower
+ * levels of an LSM tree, closed files are rewritten later, off the hot path:
+ *
+ *  - a low-priority task wakes every COMPACT_INTERVAL_MS (or on compact_kick())
+ *    and picks up every "*.csv" in /spiffs that the logger is not writing;
+ *  - rows are parsed back into (index, value). Values are stored in fixed
+ *    point with the number of decimals of the channel's row format, so
+ *    rendering them with that format gives back the exact same text. Every
+ *    row is checked for that while compacting; a file that doesn't round-trip
+ *    (edited by hand, other format) is left as CSV;
+ *  - values go into blocks of COMPACT_BLOCK_ROWS, delta coded (codec.c);
+ *  - the segment is written to a temporary name and then swapped in with
+ *    rename(), and only after that is the CSV removed. A reboot at any point
+ *    leaves either the CSV or the finished segment (or both; the next pass
+ *    redoes the work). The last "is the logger writing it?" check and the
+ *    swap happen under compact_lock(), which the logger also holds while it
+ *    claims and opens its files, so a run can't start on the file in between.
+ *
+ * Readers (fs_print_range(), print_csv_file_only(), cat) still use the CSV
+ * name: when the CSV is gone they decode the segment instead and print the
+ * same bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fs_helpers.h"
+#include "logger.h"
+#include "blkcache.h"
+#include "codec.h"
+#include "compact.h"
+
+static const char *TAG = "compact";
+
+static TaskHandle_t compact_task = NULL;
+static SemaphoreHandle_t swap_lock = NULL;   // see compact_lock()
+static compact_stats_t stats = { .enabled = true };
+
+// Writer state (compactor task only)
+static int32_t blk_values[COMPACT_BLOCK_ROWS];
+static uint8_t blk_packed[COMPACT_BLOCK_ROWS * 4 + 8];
+
+static const int32_t pow10_tab[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+// Files found not to be representable, by path hash and size, so each one is
+// counted in 'skipped' once and not re-read on every pass until it changes
+static struct {
+    uint32_t hash;
+    long     size;
+} skip_memo[COMPACT_SKIP_MEMO];
+static uint32_t skip_next = 0;
+
+static uint32_t compact_hash(const char *s) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619u;
+    }
+    return h;
+}
+
+static bool compact_skip_known(uint32_t hash, long size) {
+    for (int i = 0; i < COMPACT_SKIP_MEMO; i++) {
+        if (skip_memo[i].hash == hash && skip_memo[i].size == size && size > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Record a file left as CSV; counted in 'skipped' the first time only.
+ */
+static void compact_skip_note(uint32_t hash, long size) {
+    if (compact_skip_known(hash, size)) {
+        return;
+    }
+    uint32_t i = skip_next++ % COMPACT_SKIP_MEMO;
+    skip_memo[i].hash = hash;
+    skip_memo[i].size = size;
+    stats.skipped++;
+}
+
+/**
+ * @brief Build the path of a file next to 'csv_path' with another extension.
+ *
+ * @return false if 'csv_path' doesn't end in ".csv" or the result doesn't fit
+ */
+static bool compact_sibling(const char *csv_path, const char *ext, char *out, size_t len) {
+    size_t n = strlen(csv_path);
+    if (n < 4 || strcmp(csv_path + n - 4, ".csv") != 0) {
+        return false;
+    }
+    return snprintf(out, len, "%.*s%s", (int)(n - 4), csv_path, ext) < (int)len;
+}
+
+/**
+ * @brief Number of decimals printed by a row format ("%.3f" -> 3).
+ */
+static int compact_decimals(const char *row_fmt) {
+    const char *p = strstr(row_fmt, "%.");
+    if (!p || p[2] < '0' || p[2] > '6' || p[3] != 'f') {
+        return -1;
+    }
+    return p[2] - '0';
+}
+
+/**
+ * @brief Parse "#<index>, <value>..." into the index and the fixed-point value.
+ */
+static bool compact_parse_row(const char *line, int decimals, uint32_t *index, int32_t *value) {
+    if (line[0] != '#') {
+        return false;
+    }
+    char *p;
+    *index = strtoul(line + 1, &p, 10);
+    if (p[0] != ',' || p[1] != ' ') {
+        return false;
+    }
+    p += 2;
+
+    bool neg = *p == '-';
+    if (neg) {
+        p++;
+    }
+    int64_t v = 0;
+    int frac = -1;   // digits seen after '.', -1 = none yet
+    for (; (*p >= '0' && *p <= '9') || (*p == '.' && frac < 0); p++) {
+        if (*p == '.') {
+            frac = 0;
+            continue;
+        }
+        v = v * 10 + (*p - '0');
+        if (frac >= 0) {
+            frac++;
+        }
+        if (v > INT32_MAX) {
+            return false;
+        }
+    }
+    if ((decimals > 0 && frac != decimals) || (decimals == 0 && frac >= 0)) {
+        return false;
+    }
+    *value = (int32_t)(neg ? -v : v);
+    return true;
+}
+
+/**
+ * @brief Append one finished block (header + packed deltas) to the segment.
+ */
+static size_t compact_write_block(FILE *out, uint32_t first_index, int count) {
+    compact_blk_t b = {
+        .first_index = first_index,
+        .first_value = blk_values[0],
+        .count = (uint16_t)count,
+        .width = codec_delta_width(blk_values, count),
+    };
+    size_t len = codec_delta_pack(blk_values, count, b.width, blk_packed);
+    fwrite(&b, sizeof b, 1, out);
+    fwrite(blk_packed, 1, len, out);
+    return sizeof b + len;
+}
+
+/**
+ * @brief Rewrite one closed CSV log as a ".csz" segment and swap it in.
+ *
+ * @return ESP_OK when the CSV was replaced, ESP_ERR_INVALID_STATE if the
+ *         logger is writing it, ESP_ERR_NOT_SUPPORTED if it isn't a log this
+ *         tier can represent exactly, ESP_FAIL on I/O errors
+ */
+esp_err_t compact_file(const char *csv_path) {
+    char seg_path[48], tmp_path[48];
+    if (!compact_sibling(csv_path, COMPACT_EXT, seg_path, sizeof seg_path) ||
+        !compact_sibling(csv_path, COMPACT_TMP_EXT, tmp_path, sizeof tmp_path)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (logger_is_writing(csv_path)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct stat st;
+    uint32_t hash = compact_hash(csv_path);
+    long size = stat(csv_path, &st) == 0 ? (long)st.st_size : 0;
+    if (compact_skip_known(hash, size)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    FILE *in = fopen(csv_path, "r");
+    if (!in) {
+        return ESP_FAIL;
+    }
+
+    // The header line tells which channel (and so which row format) wrote the file
+    char line[64];
+    const logger_channel_t *ch = NULL;
+    if (fgets(line, sizeof line, in)) {
+        if (line[0] == '%') {
+            fclose(in);         // lazy or lossy log: not a format this tier handles, by design
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        for (uint8_t id = 0; logger_channel_by_id(id); id++) {
+            if (strcmp(line, logger_channel_by_id(id)->csv_header) == 0) {
+                ch = logger_channel_by_id(id);
+            }
+        }
+    }
+    int decimals = ch ? compact_decimals(ch->row_fmt) : -1;
+    if (decimals < 0) {
+        fclose(in);
+        compact_skip_note(hash, size);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fclose(in);
+        return ESP_FAIL;
+    }
+    int64_t t0 = esp_timer_get_time();
+    compact_hdr_t hdr = { .magic = COMPACT_MAGIC, .version = 1, .channel = ch->id, .decimals = (uint8_t)decimals };
+    fwrite(&hdr, sizeof hdr, 1, out);
+    size_t bytes_out = sizeof hdr;
+    size_t bytes_in = strlen(ch->csv_header) + 1;
+
+    uint32_t first_index = 0;
+    int n = 0;
+    bool ok = true;
+    while (fgets(line, sizeof line, in)) {
+        bytes_in += strlen(line);
+
+        // Must render back to exactly the same text, or the segment isn't lossless
+        uint32_t index;
+        int32_t value;
+        char check[64];
+        if (!compact_parse_row(line, decimals, &index, &value) ||
+            snprintf(check, sizeof check, ch->row_fmt, (int)index, (double)value / pow10_tab[decimals]) <= 0 ||
+            strcmp(check, line) != 0) {
+            ok = false;
+            break;
+        }
+
+        // Blocks hold consecutive indices
+        if (n > 0 && (n == COMPACT_BLOCK_ROWS || index != first_index + n)) {
+            bytes_out += compact_write_block(out, first_index, n);
+            hdr.blocks++;
+            n = 0;
+            vTaskDelay(1);   // let the logger at the flash between blocks
+        }
+        if (n == 0) {
+            first_index = index;
+        }
+        blk_values[n++] = value;
+        hdr.rows++;
+    }
+    if (ok && n > 0) {
+        bytes_out += compact_write_block(out, first_index, n);
+        hdr.blocks++;
+    }
+    fclose(in);
+
+    // Header again, now with the counts
+    if (ok) {
+        ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof hdr, 1, out) == 1;
+    }
+    ok = (fclose(out) == 0) && ok;
+
+    // Swap: segment in first, CSV out last
+    compact_lock();
+    if (!ok || logger_is_writing(csv_path)) {
+        compact_unlock();
+        remove(tmp_path);
+        if (!ok) {
+            compact_skip_note(hash, size);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+    remove(seg_path);
+    if (rename(tmp_path, seg_path) != 0) {
+        compact_unlock();
+        remove(tmp_path);
+        return ESP_FAIL;
+    }
+    remove(csv_path);
+    compact_unlock();
+    blkcache_invalidate(csv_path, 0);
+    blkcache_invalidate(seg_path, 0);
+
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    stats.segments++;
+    stats.rows += hdr.rows;
+    stats.bytes_in += bytes_in;
+    stats.bytes_out += bytes_out;
+    stats.total_us += dt;
+    ESP_LOGI(TAG, "%s: %u rows, %u -> %u bytes (%.2f -> %.2f B/sample), %u ms",
+             csv_path, (unsigned)hdr.rows, (unsigned)bytes_in, (unsigned)bytes_out,
+             hdr.rows ? (double)bytes_in / hdr.rows : 0.0, hdr.rows ? (double)bytes_out / hdr.rows : 0.0,
+             (unsigned)(dt / 1000));
+    return ESP_OK;
+}
+
+/**
+ * @brief Delete the segment of 'csv_path' (the CSV is being rewritten or removed).
+ *
+ * @return true if there was one
+ */
+bool compact_forget(const char *csv_path) {
+    char seg_path[48];
+    if (!compact_sibling(csv_path, COMPACT_EXT, seg_path, sizeof seg_path) || remove(seg_path) != 0) {
+        return false;
+    }
+    blkcache_invalidate(seg_path, 0);
+    return true;
+}
+
+/**
+ * @brief One pass over /spiffs: compact every closed CSV log.
+ */
+static void compact_pass(void) {
+    DIR *dir = opendir("/spiffs");
+    if (!dir) {
+        return;
+    }
+    struct dirent *e;
+    char path[48];
+    while ((e = readdir(dir)) != NULL) {
+        size_t n = strlen(e->d_name);
+        if (n < 4 || strcmp(e->d_name + n - 4, ".csv") != 0) {
+            continue;
+        }
+        snprintf(path, sizeof path, "/spiffs/%s", e->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || st.st_size < COMPACT_MIN_BYTES) {
+            continue;
+        }
+        compact_file(path);
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Low-priority task: compacts closed logs while nothing else needs the CPU.
+ */
+static void compact_task_fn(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(COMPACT_INTERVAL_MS));
+        if (stats.enabled) {
+            compact_pass();
+        }
+    }
+}
+
+/**
+ * @brief Serialise swapping a segment in against the logger claiming a file.
+ *
+ * Held by the compactor from its last logger_is_writing() check until the CSV
+ * is removed, and by the logger from setting its active paths until its
+ * files are open. A no-op until compact_start() (nothing swaps before that).
+ */
+void compact_lock(void) {
+    if (swap_lock) {
+        xSemaphoreTake(swap_lock, portMAX_DELAY);
+    }
+}
+
+void compact_unlock(void) {
+    if (swap_lock) {
+        xSemaphoreGive(swap_lock);
+    }
+}
+
+/**
+ * @brief Start the background compactor (priority 1, like SPIFFS GC).
+ */
+void compact_start(void) {
+    if (compact_task) {
+        return;
+    }
+    swap_lock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(compact_task_fn, "compact", 4096, NULL, 1, &compact_task, 0);
+}
+
+/**
+ * @brief Run a pass now instead of waiting for the next interval.
+ */
+void compact_kick(void) {
+    if (compact_task) {
+        xTaskNotifyGive(compact_task);
+    }
+}
+
+/**
+ * @brief Turn background compaction on/off.
+ */
+void compact_enable(bool on) {
+    stats.enabled = on;
+    printf("[*] compaction %s\n", on ? "on" : "off");
+}
+
+/**
+ * @brief Copy compaction counters.
+ */
+void compact_get_stats(compact_stats_t *out) {
+    *out = stats;
+}
+
+/**
+ * @brief Read exactly 'len' bytes from a cached reader.
+ */
+static bool compact_read(blkcache_file_t *f, void *buf, size_t len) {
+    return blkcache_read(f, buf, len) == len;
+}
+
+/**
+ * @brief Print the header (if 'header') and the rows with index [first, first + count) of a compacted log.
+ *
+ * Output is identical to fs_print_range() on the original CSV. Blocks before
+ * 'first' are skipped without decoding. Deltas are decoded on the fly, so no
+ * block-sized buffer is needed on the caller's stack.
+ *
+ * @return false if 'csv_path' has no segment
+ */
+bool compact_print_range(const char *csv_path, int first, int count, bool header) {
+    char seg_path[48];
+    blkcache_file_t f;
+    if (!compact_sibling(csv_path, COMPACT_EXT, seg_path, sizeof seg_path) || !blkcache_open(&f, seg_path)) {
+        return false;
+    }
+
+    compact_hdr_t hdr;
+    const logger_channel_t *ch = NULL;
+    if (compact_read(&f, &hdr, sizeof hdr) && hdr.magic == COMPACT_MAGIC && hdr.decimals <= 6) {
+        ch = logger_channel_by_id(hdr.channel);
+    }
+    if (!ch) {
+        blkcache_close(&f);
+        return false;
+    }
+    if (header) {
+        printf("%s\n", ch->csv_header);
+    }
+
+    // Rows are selected by index, like in fs_print_range(): a scope log's
+    // blocks start wherever its indices jump
+    int64_t end = (int64_t)first + count;
+    for (uint32_t b = 0; b < hdr.blocks; b++) {
+        compact_blk_t blk;
+        if (!compact_read(&f, &blk, sizeof blk) || blk.first_index >= end) {
+            break;
+        }
+        size_t len = codec_delta_len(blk.count, blk.width);
+
+        // Whole block before the range: skip its packed bytes
+        if ((int64_t)blk.first_index + blk.count <= first) {
+            uint8_t skip[64];
+            while (len > 0) {
+                size_t n = len < sizeof skip ? len : sizeof skip;
+                if (!compact_read(&f, skip, n)) {
+                    break;
+                }
+                len -= n;
+            }
+            continue;
+        }
+
+        uint64_t acc = 0;
+        int bits = 0;
+        uint64_t mask = blk.width ? (1ull << blk.width) - 1 : 0;
+        int32_t v = blk.first_value;
+        for (int i = 0; i < blk.count; i++) {
+            if (i > 0) {
+                while (bits < blk.width) {
+                    uint8_t byte = 0;
+                    compact_read(&f, &byte, 1);
+                    acc |= (uint64_t)byte << bits;
+                    bits += 8;
+                }
+                v = (int32_t)((uint32_t)v + (uint32_t)codec_unzigzag((uint32_t)(acc & mask)));
+                acc >>= blk.width;
+                bits -= blk.width;
+            }
+            int64_t index = (int64_t)blk.first_index + i;
+            if (index >= first && index < end) {
+                printf(ch->row_fmt, (int)index, (double)v / pow10_tab[hdr.decimals]);
+            }
+        }
+    }
+    blkcache_close(&f);
+    return true;
+}
+
+/**
+ * @brief Open the segment of 'csv_path' for reading row by row.
+ *
+ * For code that consumes rows instead of printing them (e.g. the resampler);
+ * decodes one delta at a time, like compact_print_range().
+ *
+ * @param channel  Set to the logger channel id of the segment
+ * @return false if 'csv_path' has no (valid) segment
+ */
+bool compact_reader_open(compact_reader_t *r, const char *csv_path, uint8_t *channel) {
+    char seg_path[48];
+    memset(r, 0, sizeof *r);
+    if (!compact_sibling(csv_path, COMPACT_EXT, seg_path, sizeof seg_path) || !blkcache_open(&r->f, seg_path)) {
+        return false;
+    }
+    if (!compact_read(&r->f, &r->hdr, sizeof r->hdr) || r->hdr.magic != COMPACT_MAGIC || r->hdr.decimals > 6) {
+        blkcache_close(&r->f);
+        return false;
+    }
+    r->blocks_left = r->hdr.blocks;
+    *channel = r->hdr.channel;
+    return true;
+}
+
+/**
+ * @brief Next row of the segment.
+ *
+ * @return false at the end of the segment (or on a short read)
+ */
+bool compact_reader_next(compact_reader_t *r, uint32_t *index, float *value) {
+    if (r->row == r->blk.count) {
+        if (r->blocks_left == 0 || !compact_read(&r->f, &r->blk, sizeof r->blk) || r->blk.count == 0) {
+            return false;
+        }
+        r->blocks_left--;
+        r->row = 0;
+        r->bits = 0;
+        r->acc = 0;
+        r->v = r->blk.first_value;
+    } else {
+        uint64_t mask = r->blk.width ? (1ull << r->blk.width) - 1 : 0;
+        while (r->bits < r->blk.width) {
+            uint8_t byte;
+            if (!compact_read(&r->f, &byte, 1)) {
+                return false;
+            }
+            r->acc |= (uint64_t)byte << r->bits;
+            r->bits += 8;
+        }
+        r->v = (int32_t)((uint32_t)r->v + (uint32_t)codec_unzigzag((uint32_t)(r->acc & mask)));
+        r->acc >>= r->blk.width;
+        r->bits -= r->blk.width;
+    }
+    *index = r->blk.first_index + r->row++;
+    *value = (float)((double)r->v / pow10_tab[r->hdr.decimals]);
+    return true;
+}
+
+void compact_reader_close(compact_reader_t *r) {
+    blkcache_close(&r->f);
+}
@@ -0,0 +1,75 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "blkcache.h"
+
+// Cold tier for SPIFFS logs: closed CSV files are rewritten by a background
+// task into ".csz" segments (delta-coded fixed-point values, large blocks).
+// Readers fall back to the segment transparently once the CSV is gone.
+#define COMPACT_EXT          ".csz"
+#define COMPACT_TMP_EXT      ".czt"         // segment being written (not yet swapped in)
+#define COMPACT_MAGIC        0x315A5343     // "CSZ1"
+#define COMPACT_BLOCK_ROWS   256            // rows per block (one width / first value each)
+#define COMPACT_INTERVAL_MS  30000          // how often the task looks for closed logs
+#define COMPACT_MIN_BYTES    1024           // smaller CSVs are left alone
+#define COMPACT_SKIP_MEMO    16             // non-representable files remembered (counted once)
+
+// Segment header (start of every .csz file)
+typedef struct {
+    uint32_t magic;          // COMPACT_MAGIC
+    uint8_t  version;        // 1
+    uint8_t  channel;        // logger channel id (decides header, row format, unit)
+    uint8_t  decimals;       // values are stored as value * 10^decimals
+    uint8_t  reserved;
+    uint32_t rows;
+    uint32_t blocks;
+} compact_hdr_t;
+
+// Block header; followed by codec_delta_len(count, width) bytes of packed value deltas
+typedef struct {
+    uint32_t first_index;    // row index of the first row (indices are consecutive within a block)
+    int32_t  first_value;    // fixed-point value of the first row
+    uint16_t count;
+    uint8_t  width;
+    uint8_t  reserved;
+} compact_blk_t;
+
+// Row-by-row reader of a segment (see compact_reader_open())
+typedef struct {
+    blkcache_file_t f;
+    compact_hdr_t hdr;
+    compact_blk_t blk;
+    uint32_t blocks_left;    // blocks not started yet
+    uint16_t row;            // rows of 'blk' already returned
+    int      bits;           // delta bits buffered in 'acc'
+    uint64_t acc;
+    int32_t  v;              // fixed-point value of the last row returned
+} compact_reader_t;
+
+typedef struct {
+    bool     enabled;
+    uint32_t segments;       // CSV files compacted
+    uint32_t rows;
+    uint32_t bytes_in;       // CSV bytes before
+    uint32_t bytes_out;      // segment bytes after
+    uint32_t skipped;        // files left as CSV (unknown format, not exactly representable), each counted once
+    uint32_t total_us;       // time spent compacting
+} compact_stats_t;
+
+void compact_start(void);
+void compact_kick(void);
+void compact_enable(bool on);
+void compact_get_stats(compact_stats_t *out);
+esp_err_t compact_file(const char *csv_path);
+bool compact_forget(const char *csv_path);
+void compact_lock(void);
+void compact_unlock(void);
+bool compact_print_range(const char *csv_path, int first, int count, bool header);
+bool compact_reader_open(compact_reader_t *r, const char *csv_path, uint8_t *channel);
+bool compact_reader_next(compact_reader_t *r, uint32_t *index, float *value);
+void compact_reader_close(compact_reader_t *r);
+
+#endif
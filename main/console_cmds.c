@@ -0,0 +1,1141 @@
+/**
+ * @file console_cmds.c
+ * @brief Interactive serial shell (esp_console REPL) for operating the logger without reflashing.
+ *
+ * Commands only ever talk to the logger through its background API
+ * (logger_start/stop/set_period) or read its RAM state, so a command that
+ * takes a while (export, tail, bench) blocks the console task only; the
+ * acquisition task keeps sampling at its own, higher priority.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fs_helpers.h"
+#include "logger.h"
+#include "blocklog.h"
+#include "hotwin.h"
+#include "hist.h"
+#include "blkcache.h"
+#include "compact.h"
+#include "scope.h"
+#include "adapt.h"
+#include "lossy.h"
+#include "resample.h"
+#include "heapaudit.h"
+#include "chstats.h"
+#include "spectrum.h"
+#include "noise.h"
+#include "console_cmds.h"
+
+// Period used by the next 'start' (changed with 'rate')
+static uint32_t next_period_ms = SAMPLE_PERIOD_MS;
+
+/**
+ * @brief Look up a channel by its name on the command line.
+ *
+ * @return The channel, or NULL (after saying so) if there is none by that name
+ */
+static const logger_channel_t *console_channel(const char *name) {
+    for (uint8_t id = 0; logger_channel_by_id(id); id++) {
+        if (strcmp(name, logger_channel_by_id(id)->name) == 0) {
+            return logger_channel_by_id(id);
+        }
+    }
+    printf("unknown channel '%s'\n", name);
+    return NULL;
+}
+
+/**
+ * @brief Default log file of a channel.
+ */
+static const char *console_default_path(const logger_channel_t *ch) {
+    return ch->id == LOGGER_CH_ID_POT ? LOG_PATH : TEMP_PATH;
+}
+
+/**
+ * @brief Turn a command-line file argument into a path ("raw" = raw block log).
+ */
+static void console_path(const char *arg, char *out, size_t len) {
+    if (strcmp(arg, "raw") == 0) {
+        snprintf(out, len, "%s", RAWLOG_PATH);
+    } else if (arg[0] == '/') {
+        snprintf(out, len, "%s", arg);
+    } else {
+        snprintf(out, len, "/spiffs/%s", arg);
+    }
+}
+
+/**
+ * @brief start <pot|thermistor> [period_ms] [samples] [file|raw]
+ */
+static int cmd_start(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: start <pot|thermistor> [period_ms] [samples] [file|raw]\n");
+        return 1;
+    }
+
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    uint32_t period_ms = argc > 2 ? (uint32_t)atoi(argv[2]) : next_period_ms;
+    int samples = argc > 3 ? atoi(argv[3]) : 0;   // 0 = until 'stop'
+    char path[32];
+    console_path(argc > 4 ? argv[4] : console_default_path(ch), path, sizeof path);
+
+    if (period_ms == 0) {
+        printf("period must be >= 1 ms\n");
+        return 1;
+    }
+    scope_set(NULL);   // store every sample
+    spectrum_set(NULL);
+    esp_err_t err = logger_start(ch, path, samples, period_ms * 1000);
+    if (err != ESP_OK) {
+        printf("start failed: %s\n", err == ESP_ERR_INVALID_STATE ? "already logging" : esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief multi <pot|thermistor>:<period_ms>[:samples][:file|raw] ...
+ *
+ * e.g. "multi pot:10 thermistor:1000" logs the pot at 100 Hz and the
+ * thermistor at 1 Hz, each to its default file, until 'stop'.
+ */
+static int cmd_multi(int argc, char **argv) {
+    if (argc < 2 || argc - 1 > LOGGER_LANES_MAX) {
+        printf("usage: multi <pot|thermistor>:<period_ms>[:samples][:file|raw] ... (up to %d)\n", LOGGER_LANES_MAX);
+        return 1;
+    }
+
+    logger_lane_t lanes[LOGGER_LANES_MAX];
+    char paths[LOGGER_LANES_MAX][32];
+    for (int i = 0; i < argc - 1; i++) {
+        char name[16], file[24] = "";
+        unsigned period_ms = 0;
+        int samples = 0;
+        if (sscanf(argv[i + 1], "%15[^:]:%u:%d:%23s", name, &period_ms, &samples, file) < 2) {
+            printf("bad channel spec '%s'\n", argv[i + 1]);
+            return 1;
+        }
+        lanes[i].ch = console_channel(name);
+        if (!lanes[i].ch) {
+            return 1;
+        }
+        if (period_ms == 0) {
+            printf("period must be >= 1 ms\n");
+            return 1;
+        }
+        console_path(file[0] ? file : console_default_path(lanes[i].ch), paths[i], sizeof paths[i]);
+        lanes[i].path = paths[i];
+        lanes[i].samples = samples;
+        lanes[i].period_us = period_ms * 1000;
+    }
+
+    scope_set(NULL);   // store every sample
+    spectrum_set(NULL);
+    esp_err_t err = logger_start_multi(lanes, argc - 1);
+    if (err != ESP_OK) {
+        printf("start failed: %s\n", err == ESP_ERR_INVALID_STATE ? "already logging" : esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief scope <pot|thermistor> <rising|falling|either|slope> <level> [period_us] [pre] [post] [file|raw]
+ */
+static int cmd_scope(int argc, char **argv) {
+    if (argc < 4) {
+        printf("usage: scope <pot|thermistor> <rising|falling|either|slope> <level> [period_us] [pre] [post] [file|raw]\n");
+        return 1;
+    }
+
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    scope_cfg_t cfg = {
+        .level = strtof(argv[3], NULL),
+        .pre = argc > 5 ? (uint16_t)atoi(argv[5]) : 200,
+        .post = argc > 6 ? (uint16_t)atoi(argv[6]) : 800,
+    };
+    if (!scope_parse_trig(argv[2], &cfg.trig) || cfg.trig == SCOPE_OFF) {
+        printf("unknown trigger '%s'\n", argv[2]);
+        return 1;
+    }
+    uint32_t period_us = argc > 4 ? (uint32_t)atoi(argv[4]) : 1000;
+    if (period_us < 500) {
+        printf("period must be >= 500 us\n");
+        return 1;
+    }
+    char path[32];
+    console_path(argc > 7 ? argv[7] : "scope.csv", path, sizeof path);
+
+    scope_set(&cfg);
+    spectrum_set(NULL);
+    esp_err_t err = logger_start(ch, path, 0, period_us);
+    if (err != ESP_OK) {
+        printf("start failed: %s\n", err == ESP_ERR_INVALID_STATE ? "already logging" : esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief spectrum <pot|thermistor> [period_us] [n] [avg] [bands] [rows] [file]
+ *
+ * e.g. "spectrum pot 1000 256 4" writes a 128-bin amplitude spectrum (3.9 Hz
+ * per bin up to 500 Hz) of every 1.024 s of pot samples; "spectrum pot 1000
+ * 1024 1 16 60" writes 60 rows of 16 band RMS values.
+ */
+static int cmd_spectrum(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: spectrum <pot|thermistor> [period_us] [n] [avg] [bands] [rows] [file]\n");
+        return 1;
+    }
+
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    uint32_t period_us = argc > 2 ? (uint32_t)atoi(argv[2]) : 1000;
+    spectrum_cfg_t cfg = {
+        .n = argc > 3 ? (uint16_t)atoi(argv[3]) : 256,
+        .avg = argc > 4 ? (uint16_t)atoi(argv[4]) : 4,
+        .bands = argc > 5 ? (uint16_t)atoi(argv[5]) : 0,
+        .oversample = 1,   // single reads: the noise is what we are after
+    };
+    int rows = argc > 6 ? atoi(argv[6]) : 0;   // 0 = until 'stop'
+    if (period_us < SPECTRUM_PERIOD_MIN) {
+        printf("period must be >= %d us\n", SPECTRUM_PERIOD_MIN);
+        return 1;
+    }
+    if (cfg.n < SPECTRUM_N_MIN || cfg.n > SPECTRUM_N_MAX || (cfg.n & (cfg.n - 1)) || cfg.avg == 0) {
+        printf("n must be a power of two in %d..%d, avg >= 1\n", SPECTRUM_N_MIN, SPECTRUM_N_MAX);
+        return 1;
+    }
+    if (rows < 0 || (int64_t)rows * cfg.n * cfg.avg > INT32_MAX) {
+        printf("rows out of range\n");
+        return 1;
+    }
+    char path[32];
+    console_path(argc > 7 ? argv[7] : "spectrum.csv", path, sizeof path);
+    if (strcmp(path, RAWLOG_PATH) == 0) {
+        printf("spectra go to a CSV file\n");
+        return 1;
+    }
+
+    scope_set(NULL);
+    spectrum_set(&cfg);
+    esp_err_t err = logger_start(ch, path, rows * cfg.n * cfg.avg, period_us);
+    if (err != ESP_OK) {
+        printf("start failed: %s\n", err == ESP_ERR_INVALID_STATE ? "already logging" : esp_err_to_name(err));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief stop
+ */
+static int cmd_stop(int argc, char **argv) {
+    if (!logger_is_running()) {
+        printf("not logging\n");
+        return 1;
+    }
+    logger_stop();
+    return 0;
+}
+
+/**
+ * @brief rate <period_ms>
+ */
+static int cmd_rate(int argc, char **argv) {
+    if (argc < 2 || atoi(argv[1]) <= 0) {
+        printf("usage: rate <period_ms>\n");
+        return 1;
+    }
+    next_period_ms = (uint32_t)atoi(argv[1]);
+    logger_set_period(next_period_ms * 1000);
+    printf("period = %u ms\n", (unsigned)next_period_ms);
+    return 0;
+}
+
+/**
+ * @brief ls
+ */
+static int cmd_ls(int argc, char **argv) {
+    fs_list();
+    if (blocklog_init() == ESP_OK) {
+        printf("[*] raw log: %u blocks\n", (unsigned)blocklog_block_count());
+    }
+    return 0;
+}
+
+/**
+ * @brief rm <file>
+ */
+static int cmd_rm(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: rm <file|raw>\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "raw") == 0) {
+        if (logger_is_running() || blocklog_init() != ESP_OK) {
+            printf("raw log busy or missing\n");
+            return 1;
+        }
+        return blocklog_erase_all() == ESP_OK ? 0 : 1;
+    }
+
+    char path[32];
+    console_path(argv[1], path, sizeof path);
+    if (logger_is_writing(path)) {
+        printf("file busy\n");
+        return 1;
+    }
+    // A closed log may only exist in compacted form by now
+    bool removed = remove(path) == 0;
+    if (!compact_forget(path) && !removed) {
+        printf("remove failed: %s\n", path);
+        return 1;
+    }
+    hotwin_forget(path);
+    blkcache_invalidate(path, 0);
+    return 0;
+}
+
+/**
+ * @brief cat <file|raw> [first] [count]
+ */
+static int cmd_cat(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: cat <file|raw> [first] [count]\n");
+        return 1;
+    }
+    int first = argc > 2 ? atoi(argv[2]) : 0;
+    int count = argc > 3 ? atoi(argv[3]) : INT32_MAX;
+    if (first < 0 || count < 0) {
+        printf("first and count must be >= 0\n");
+        return 1;
+    }
+    if (count > INT32_MAX - first) {
+        count = INT32_MAX - first;
+    }
+
+    // Recent rows come from the hot window, older ones from flash
+    char path[32];
+    console_path(argv[1], path, sizeof path);
+    hotwin_print_range(path, (uint32_t)first, (uint32_t)count);
+    return 0;
+}
+
+/**
+ * @brief resample <grid_ms> <linear|hold|decimate> <file>:<period_ms> ...
+ *
+ * e.g. "resample 100 decimate potdata.csv:10 thermodata.csv:1000" prints both
+ * logs of a 'multi pot:10 thermistor:1000' run as one table, 10 rows per second.
+ */
+static int cmd_resample(int argc, char **argv) {
+    if (argc < 4 || argc - 3 > RESAMPLE_SOURCES_MAX) {
+        printf("usage: resample <grid_ms> <linear|hold|decimate> <file>:<period_ms> ... (up to %d)\n",
+               RESAMPLE_SOURCES_MAX);
+        return 1;
+    }
+    uint32_t grid_ms = (uint32_t)atoi(argv[1]);
+    resample_mode_t mode;
+    if (grid_ms == 0 || !resample_parse_mode(argv[2], &mode)) {
+        printf("usage: resample <grid_ms> <linear|hold|decimate> <file>:<period_ms> ...\n");
+        return 1;
+    }
+
+    resample_src_cfg_t srcs[RESAMPLE_SOURCES_MAX];
+    char paths[RESAMPLE_SOURCES_MAX][32];
+    for (int i = 0; i < argc - 3; i++) {
+        char file[24];
+        unsigned period_ms = 0;
+        if (sscanf(argv[i + 3], "%23[^:]:%u", file, &period_ms) != 2 || period_ms == 0) {
+            printf("bad source '%s' (expected file:period_ms)\n", argv[i + 3]);
+            return 1;
+        }
+        console_path(file, paths[i], sizeof paths[i]);
+        srcs[i].path = paths[i];
+        srcs[i].period_us = period_ms * 1000;
+    }
+
+    esp_err_t err = resample_export(srcs, argc - 3, grid_ms * 1000, mode);
+    if (err != ESP_OK) {
+        printf("error,message\r\n,%s\r\n", err == ESP_ERR_NOT_FOUND ? "Could not open file" : "Bad parameters");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief times [first] [count]
+ */
+static int cmd_times(int argc, char **argv) {
+    uint32_t first = argc > 1 ? strtoul(argv[1], NULL, 10) : 0;
+    uint32_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : UINT32_MAX;
+    blocklog_print_timed(first, count);
+    return 0;
+}
+
+/**
+ * @brief seek <time_s> [count]
+ */
+static int cmd_seek(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: seek <time_s> [count]\n");
+        return 1;
+    }
+    int64_t t_us = (int64_t)(strtod(argv[1], NULL) * 1e6);
+    uint32_t index;
+    if (blocklog_init() != ESP_OK || blocklog_seek_time(t_us, &index) != ESP_OK) {
+        printf("no raw log rows at or after %s s\n", argv[1]);
+        return 1;
+    }
+    blocklog_print_timed(index, argc > 2 ? strtoul(argv[2], NULL, 10) : 20);
+    return 0;
+}
+
+// Row budget for one 'query' command
+typedef struct {
+    const logger_channel_t *ch;
+    int left;
+} console_query_t;
+
+static bool console_query_print(uint32_t index, float value, void *ctx) {
+    console_query_t *q = ctx;
+    printf(q->ch->row_fmt, (int)index, value);
+    return --q->left > 0;
+}
+
+/**
+ * @brief query <pot|thermistor> <gt|lt|between> <a> [b] [max_rows]
+ */
+static int cmd_query(int argc, char **argv) {
+    if (argc < 4) {
+        printf("usage: query <pot|thermistor> <gt|lt|between> <a> [b] [max_rows]\n");
+        return 1;
+    }
+
+    console_query_t q = { .left = 20 };
+    q.ch = console_channel(argv[1]);
+    if (!q.ch) {
+        return 1;
+    }
+
+    blocklog_pred_t pred = { .a = strtof(argv[3], NULL) };
+    int next = 4;
+    if (strcmp(argv[2], "gt") == 0) {
+        pred.op = BLOCKLOG_GT;
+    } else if (strcmp(argv[2], "lt") == 0) {
+        pred.op = BLOCKLOG_LT;
+    } else if (strcmp(argv[2], "between") == 0 && argc > 4) {
+        pred.op = BLOCKLOG_BETWEEN;
+        pred.b = strtof(argv[4], NULL);
+        next = 5;
+    } else {
+        printf("unknown predicate '%s'\n", argv[2]);
+        return 1;
+    }
+    if (argc > next) {
+        q.left = atoi(argv[next]);
+    }
+
+    blocklog_query_stats_t st;
+    if (blocklog_init() != ESP_OK ||
+        blocklog_query(q.ch->id, &pred, q.left > 0 ? console_query_print : NULL, &q, &st) != ESP_OK) {
+        printf("raw log missing\n");
+        return 1;
+    }
+    printf("[*] %u matches, read %u/%u blocks, scanned %u rows\n",
+           (unsigned)st.matches, (unsigned)st.blocks_read, (unsigned)st.blocks, (unsigned)st.rows_scanned);
+    return 0;
+}
+
+/**
+ * @brief last [pot|thermistor]
+ */
+static int cmd_last(int argc, char **argv) {
+    const logger_channel_t *only = NULL;
+    if (argc > 1 && !(only = console_channel(argv[1]))) {
+        return 1;
+    }
+    int shown = 0;
+    const logger_channel_t *ch;
+    for (uint8_t id = 0; (ch = logger_channel_by_id(id)); id++) {
+        if (only && ch != only) {
+            continue;
+        }
+        logger_record_t r;
+        if (hotwin_latest(ch->id, &r)) {
+            printf("%-10s %lld ms ago: ", ch->name, (long long)((esp_timer_get_time() - r.t_us) / 1000));
+            printf(ch->row_fmt, (int)r.seq, logger_record_value(ch, &r));
+            shown++;
+        }
+    }
+    if (shown == 0) {
+        printf("no recent samples\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Row budget for one 'hist' command
+typedef struct {
+    const logger_channel_t *ch;
+    int left;
+} console_hist_t;
+
+static bool console_hist_print(uint32_t index, int64_t t_us, float value, void *ctx) {
+    console_hist_t *q = ctx;
+    printf(q->ch->row_fmt, (int)index, value);
+    return --q->left > 0;
+}
+
+/**
+ * @brief hist <pot|thermistor> [seconds] [max_rows]
+ */
+static int cmd_hist(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: hist <pot|thermistor> [seconds] [max_rows]\n");
+        return 1;
+    }
+    console_hist_t q = { .left = argc > 3 ? atoi(argv[3]) : 100 };
+    q.ch = console_channel(argv[1]);
+    if (!q.ch) {
+        return 1;
+    }
+
+    hist_stats_t st;
+    if (!hist_get_stats(q.ch->id, &st) || q.left <= 0) {
+        printf("no history\n");
+        return 1;
+    }
+    int64_t seconds = argc > 2 ? atoi(argv[2]) : 60;
+    printf("%s\n", q.ch->csv_header);
+    hist_read(q.ch->id, st.newest_us - seconds * 1000000, st.newest_us, console_hist_print, &q);
+    return 0;
+}
+
+/**
+ * @brief tail [seconds]
+ */
+static int cmd_tail(int argc, char **argv) {
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    logger_tail(seconds * 1000);
+    return 0;
+}
+
+/**
+ * @brief watch [seconds]
+ */
+static int cmd_watch(int argc, char **argv) {
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    logger_watch(seconds * 1000);
+    return 0;
+}
+
+/**
+ * @brief stats
+ */
+static int cmd_stats(int argc, char **argv) {
+    logger_stats_t st;
+    logger_get_stats(&st);
+
+    printf("logger   : %s, period %u us\n", logger_is_running() ? "running" : "idle", (unsigned)st.period_us);
+    printf("samples  : %u acquired, %u written, %u dropped, %u overruns\n",
+           (unsigned)st.samples, (unsigned)st.written, (unsigned)st.dropped, (unsigned)st.overruns);
+    printf("jitter   : mean %u us, max %u us\n",
+           (unsigned)(st.jitter_sum_us / (st.samples > 1 ? st.samples - 1 : 1)), (unsigned)st.jitter_max_us);
+    if (st.lanes > 1) {
+        printf("schedule : %u channels on a %u us tick, %u ticks, %u with coalesced reads\n",
+               (unsigned)st.lanes, (unsigned)st.tick_us, (unsigned)st.ticks, (unsigned)st.coalesced);
+    }
+    printf("tick     : %u us max with nothing due, %u us max / %u us mean with ADC reads\n",
+           (unsigned)st.tick_idle_max_us, (unsigned)st.tick_busy_max_us, (unsigned)st.tick_busy_mean_us);
+    printf("boot     : first sample %lld ms after boot\n", (long long)(st.first_sample_us / 1000));
+    printf("storage  : %u blocks, %u bytes, %lld ms\n",
+           (unsigned)st.blocks, (unsigned)st.bytes, (long long)(st.elapsed_us / 1000));
+    logger_latency_t lat;
+    logger_get_write_latency(&lat);
+    printf("writes   : p50 %u us, p99 %u us, max %u us (last %u)\n",
+           (unsigned)lat.p50_us, (unsigned)lat.p99_us, (unsigned)lat.max_us, (unsigned)lat.count);
+
+    for (uint8_t id = 0; id < HOTWIN_CHANNELS; id++) {
+        hotwin_info_t hw;
+        if (hotwin_get_info(id, &hw)) {
+            printf("hot %-5.5s: rows %u..%u of %s in RAM (%lld s)\n", logger_channel_by_id(id)->name,
+                   (unsigned)hw.first, (unsigned)(hw.next - 1), hw.path, (long long)(hw.span_us / 1000000));
+        }
+    }
+
+    for (uint8_t id = 0; id < HIST_CHANNELS; id++) {
+        hist_stats_t hs;
+        if (hist_get_stats(id, &hs)) {
+            printf("hist %-4.4s: %u samples over %lld min in %u blocks, %u bytes (%.2f B/sample, %u reserved)\n",
+                   logger_channel_by_id(id)->name, (unsigned)hs.samples,
+                   (long long)((hs.newest_us - hs.oldest_us) / 60000000), (unsigned)hs.blocks,
+                   (unsigned)hs.bytes, (double)hs.bytes / hs.samples, (unsigned)hs.footprint);
+        }
+    }
+
+    blkcache_stats_t bc;
+    blkcache_get_stats(&bc);
+    printf("cache    : %u/%u blocks, %u hits, %u misses, %u evictions, %u invalidated\n",
+           (unsigned)bc.blocks, (unsigned)(bc.budget / BLKCACHE_BLOCK_SIZE), (unsigned)bc.hits,
+           (unsigned)bc.misses, (unsigned)bc.evictions, (unsigned)bc.invalidations);
+
+    compact_stats_t cs;
+    compact_get_stats(&cs);
+    printf("compact  : %s, %u files, %u rows, %u -> %u bytes (%.2f -> %.2f B/sample), %u skipped\n",
+           cs.enabled ? "on" : "off", (unsigned)cs.segments, (unsigned)cs.rows,
+           (unsigned)cs.bytes_in, (unsigned)cs.bytes_out,
+           cs.rows ? (double)cs.bytes_in / cs.rows : 0.0, cs.rows ? (double)cs.bytes_out / cs.rows : 0.0,
+           (unsigned)cs.skipped);
+
+    fs_gc_stats_t gc;
+    fs_gc_get_stats(&gc);
+    printf("gc       : %s, %u calls, %u failed, %u ms total, %u us max\n",
+           gc.enabled ? "on" : "off", (unsigned)gc.calls, (unsigned)gc.failures,
+           (unsigned)(gc.total_us / 1000), (unsigned)gc.max_us);
+    scope_stats_t sc;
+    scope_get_stats(&sc);
+    if (sc.cfg.trig != SCOPE_OFF) {
+        printf("scope    : %u events, kept %u of %u samples (%u pre / %u post)\n",
+               (unsigned)sc.events, (unsigned)sc.kept, (unsigned)sc.seen,
+               (unsigned)sc.cfg.pre, (unsigned)sc.cfg.post);
+    }
+    const logger_channel_t *nch;
+    for (uint8_t id = 0; (nch = logger_channel_by_id(id)); id++) {
+        noise_stats_t ns;
+        noise_get_stats(nch->id, &ns);
+        if (ns.samples > 0) {
+            printf("noise    : %s %u reads for %u samples (%.2f each, now %u, %u probes, %.0f%% fewer than %d), "
+                   "sigma %.2f LSB, standard error %.2f LSB (target %.2f)\n",
+                   nch->name, (unsigned)ns.reads, (unsigned)ns.samples,
+                   (double)ns.reads / ns.samples, (unsigned)ns.reads_now, (unsigned)ns.probes,
+                   100.0 - 100.0 * ns.reads / ((double)ns.samples * nch->oversample),
+                   nch->oversample, ns.sigma_lsb, ns.se_lsb, ns.cfg.se_lsb);
+        }
+    }
+    spectrum_stats_t sp;
+    spectrum_get_stats(&sp);
+    if (sp.cfg.n != 0) {
+        printf("spectrum : %u-point FFT (%s) every %u us, %u blocks -> %u rows, %u bytes "
+               "(%.2f B/sample), FFT mean %u us / max %u us, peak %.2f Hz (%.4g)\n",
+               (unsigned)sp.cfg.n, sp.dsp ? "ESP-DSP" : "scalar", (unsigned)sp.period_us,
+               (unsigned)sp.blocks, (unsigned)sp.rows, (unsigned)sp.bytes,
+               sp.samples ? (double)sp.bytes / sp.samples : 0.0, (unsigned)sp.fft_mean_us,
+               (unsigned)sp.fft_max_us, sp.peak_hz, sp.peak_amp);
+    }
+    resample_stats_t rs;
+    resample_get_stats(&rs);
+    if (rs.sources > 0) {
+        printf("resample : %u logs, %u rows in, %u rows out in %lld ms, %u bytes of state\n",
+               (unsigned)rs.sources, (unsigned)rs.rows_in, (unsigned)rs.rows_out,
+               (long long)(rs.elapsed_us / 1000), (unsigned)rs.state_bytes);
+    }
+    bus_stats_t bs;
+    logger_get_bus_stats(&bs);
+    if (bs.published > 0) {
+        printf("bus      : %u blocks published, %u refused (a lossless reader a full ring behind)\n",
+               (unsigned)bs.published, (unsigned)bs.refused);
+    }
+    for (uint32_t i = 0; i < bs.n_subs; i++) {
+        printf("  %-7s: %s, read %u blocks, %u behind, %u missed\n", bs.sub[i].name,
+               bs.sub[i].policy == BUS_LOSSLESS ? "lossless" : "drop", (unsigned)bs.sub[i].blocks,
+               (unsigned)bs.sub[i].lag, (unsigned)bs.sub[i].missed);
+    }
+    pool_stats_t ps;
+    logger_get_pool_stats(&ps);
+    if (ps.allocs > 0) {
+        printf("pool     : %s %u blocks of %u B, %u in use, peak %u, %u allocs, %u frees, %u exhausted\n",
+               ps.name, (unsigned)ps.count, (unsigned)ps.block_size, (unsigned)ps.in_use, (unsigned)ps.peak,
+               (unsigned)ps.allocs, (unsigned)ps.frees, (unsigned)ps.exhausted);
+    }
+    heapaudit_t ha;
+    heapaudit_get(&ha);
+    if (ha.window_us > 0) {
+        printf("heapaudit: %s%s, %u mallocs / %u frees by the logger, %u in ISRs, %u by others, "
+               "%d net blocks over %lld ms\n",
+               ha.active ? "running" : "last run", ha.hooks ? "" : " (no heap hooks: net blocks only)",
+               (unsigned)ha.mallocs, (unsigned)ha.frees, (unsigned)ha.isr_mallocs, (unsigned)ha.other_mallocs,
+               (int)ha.net_blocks, (long long)(ha.window_us / 1000));
+    }
+    printf("heap     : %u free, %u min free, %u largest block\n",
+           (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    return 0;
+}
+
+/**
+ * @brief bench <export [rows] | jitter [period_us] [samples] | query | hist [hours] | cache [passes] | pack [samples] | chstats [samples] | fft [n] | bus [blocks] | noise <pot|thermistor> [se_lsb] [samples] | adapt <pot|thermistor> [file] [period_ms]>
+ */
+static int cmd_bench(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: bench <export [rows] | jitter [period_us] [samples] | query | hist [hours] | cache [passes] | pack [samples] | chstats [samples] | fft [n] | bus [blocks] | noise <pot|thermistor> [se_lsb] [samples] | adapt <pot|thermistor> [file] [period_ms]>\n");
+        return 1;
+    }
+    if (logger_is_running()) {
+        printf("stop logging first (benchmarks overwrite logs)\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "export") == 0) {
+        blocklog_bench_export(argc > 2 ? atoi(argv[2]) : 5000);
+        return 0;
+    }
+    if (strcmp(argv[1], "jitter") == 0) {
+        logger_bench_jitter(argc > 2 ? (uint32_t)atoi(argv[2]) : 1000, argc > 3 ? atoi(argv[3]) : 5000);
+        return 0;
+    }
+    if (strcmp(argv[1], "query") == 0) {
+        blocklog_bench_query();
+        return 0;
+    }
+    if (strcmp(argv[1], "cache") == 0) {
+        blkcache_bench(argc > 2 ? atoi(argv[2]) : 5);
+        return 0;
+    }
+    if (strcmp(argv[1], "hist") == 0) {
+        hist_bench(argc > 2 ? atoi(argv[2]) : 4);
+        return 0;
+    }
+    if (strcmp(argv[1], "adapt") == 0 && argc > 2) {
+        const logger_channel_t *ch = console_channel(argv[2]);
+        if (!ch) {
+            return 1;
+        }
+        uint32_t period_ms = argc > 4 ? (uint32_t)atoi(argv[4]) : next_period_ms;
+        if (period_ms == 0) {
+            printf("period must be >= 1 ms\n");
+            return 1;
+        }
+        char path[32];
+        console_path(argc > 3 ? argv[3] : console_default_path(ch), path, sizeof path);
+        adapt_bench(ch, path, period_ms * 1000);
+        return 0;
+    }
+    if (strcmp(argv[1], "pack") == 0) {
+        blocklog_bench_pack(argc > 2 ? atoi(argv[2]) : 20000);
+        return 0;
+    }
+    if (strcmp(argv[1], "noise") == 0 && argc > 2) {
+        const logger_channel_t *ch = console_channel(argv[2]);
+        if (!ch) {
+            return 1;
+        }
+        noise_bench(ch, argc > 3 ? strtof(argv[3], NULL) : 1.0f, argc > 4 ? atoi(argv[4]) : 2000);
+        return 0;
+    }
+    if (strcmp(argv[1], "fft") == 0) {
+        spectrum_bench(argc > 2 ? atoi(argv[2]) : SPECTRUM_N_MAX);
+        return 0;
+    }
+    if (strcmp(argv[1], "bus") == 0) {
+        bus_bench(argc > 2 ? atoi(argv[2]) : 20000);
+        return 0;
+    }
+    if (strcmp(argv[1], "chstats") == 0) {
+        chstats_bench(argc > 2 ? atoi(argv[2]) : 20000);
+        return 0;
+    }
+    printf("unknown benchmark '%s'\n", argv[1]);
+    return 1;
+}
+
+/**
+ * @brief cache [budget_bytes]
+ */
+static int cmd_cache(int argc, char **argv) {
+    if (argc > 1) {
+        int bytes = atoi(argv[1]);
+        if (bytes < 0) {
+            printf("usage: cache [budget_bytes]\n");
+            return 1;
+        }
+        blkcache_set_budget((size_t)bytes);
+    }
+    blkcache_stats_t bc;
+    blkcache_get_stats(&bc);
+    printf("budget %u bytes (%u blocks of %u), %u cached, %u hits, %u misses\n",
+           (unsigned)bc.budget, (unsigned)(bc.budget / BLKCACHE_BLOCK_SIZE), (unsigned)BLKCACHE_BLOCK_SIZE,
+           (unsigned)bc.blocks, (unsigned)bc.hits, (unsigned)bc.misses);
+    return 0;
+}
+
+/**
+ * @brief compact <now|on|off|file>
+ */
+static int cmd_compact(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: compact <now|on|off|file>\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "now") == 0) {
+        compact_kick();
+    } else if (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0) {
+        compact_enable(strcmp(argv[1], "on") == 0);
+    } else {
+        char path[32];
+        console_path(argv[1], path, sizeof path);
+        esp_err_t err = compact_file(path);
+        if (err != ESP_OK) {
+            printf("not compacted: %s\n", err == ESP_ERR_INVALID_STATE ? "being logged" :
+                   err == ESP_ERR_NOT_SUPPORTED ? "not a logger CSV" : esp_err_to_name(err));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief adapt <pot|thermistor> [off | <min_ms> <max_ms> <delta>]
+ */
+static int cmd_adapt(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: adapt <pot|thermistor> [off | <min_ms> <max_ms> <delta>]\n");
+        return 1;
+    }
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    adapt_cfg_t cfg;
+    if (argc == 3 && strcmp(argv[2], "off") == 0) {
+        cfg = (adapt_cfg_t){ .enabled = false };
+        adapt_set(ch->id, &cfg);
+    } else if (argc == 5) {
+        cfg = (adapt_cfg_t){
+            .enabled = true,
+            .min_us = (uint32_t)atoi(argv[2]) * 1000,
+            .max_us = (uint32_t)atoi(argv[3]) * 1000,
+            .delta = strtof(argv[4], NULL),
+        };
+        if (cfg.min_us == 0) {
+            printf("period must be >= 1 ms\n");
+            return 1;
+        }
+        adapt_set(ch->id, &cfg);
+    } else if (argc != 2) {
+        printf("usage: adapt <pot|thermistor> [off | <min_ms> <max_ms> <delta>]\n");
+        return 1;
+    }
+
+    adapt_get(ch->id, &cfg);
+    if (cfg.enabled) {
+        printf("%s: %u..%u ms, delta %g (from the next run)\n", ch->name,
+               (unsigned)(cfg.min_us / 1000), (unsigned)(cfg.max_us / 1000), cfg.delta);
+    } else {
+        printf("%s: fixed rate\n", ch->name);
+    }
+    return 0;
+}
+
+/**
+ * @brief lossy <pot|thermistor> [off | <deadband|sdt> <eps>]
+ */
+static int cmd_lossy(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: lossy <pot|thermistor> [off | <deadband|sdt> <eps>]\n");
+        return 1;
+    }
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    lossy_cfg_t cfg = { .mode = LOSSY_OFF };
+    if (argc == 3 && strcmp(argv[2], "off") == 0) {
+        lossy_set(ch->id, &cfg);
+    } else if (argc == 4 && lossy_parse_mode(argv[2], &cfg.mode) && cfg.mode != LOSSY_OFF) {
+        cfg.eps = strtof(argv[3], NULL);
+        if (!(cfg.eps > 0)) {
+            printf("eps must be > 0\n");
+            return 1;
+        }
+        lossy_set(ch->id, &cfg);
+    } else if (argc != 2) {
+        printf("usage: lossy <pot|thermistor> [off | <deadband|sdt> <eps>]\n");
+        return 1;
+    }
+
+    lossy_get(ch->id, &cfg);
+    if (cfg.mode != LOSSY_OFF) {
+        printf("%s: %s, max error %g (CSV files, from the next run)\n", ch->name,
+               lossy_mode_name(cfg.mode), cfg.eps);
+    } else {
+        printf("%s: every row stored\n", ch->name);
+    }
+    return 0;
+}
+
+/**
+ * @brief Print one span of a channel's running statistics.
+ */
+static void console_print_chstats(const logger_channel_t *ch, chstats_span_t span, const char *label) {
+    chstats_summary_t sm;
+    if (!chstats_get(ch->id, span, &sm)) {
+        printf("  %-11s no samples\n", label);
+        return;
+    }
+    printf("  %-11s n=%u over %.1f s  min %.4f  max %.4f  mean %.4f  sd %.4f  p50 %.4f  p95 %.4f  p99 %.4f\n",
+           label, (unsigned)sm.count, (sm.last_us - sm.first_us) / 1e6, sm.min, sm.max, sm.mean,
+           sm.stddev, sm.p50, sm.p95, sm.p99);
+}
+
+/**
+ * @brief chstats [pot|thermistor] [window <s> | reset | on | off]
+ */
+static int cmd_chstats(int argc, char **argv) {
+    if (argc > 1 && (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0)) {
+        chstats_enable(strcmp(argv[1], "on") == 0);
+        printf("running statistics %s (from the next run)\n", chstats_enabled() ? "on" : "off");
+        return 0;
+    }
+
+    const logger_channel_t *only = NULL;
+    if (argc > 1 && !(only = console_channel(argv[1]))) {
+        return 1;
+    }
+    if (argc == 4 && strcmp(argv[2], "window") == 0 && atoi(argv[3]) > 0) {
+        chstats_set_window(only->id, (uint32_t)atoi(argv[3]));
+    } else if (argc == 3 && strcmp(argv[2], "reset") == 0) {
+        chstats_reset(only->id);
+        printf("%s: statistics start over with the next sample\n", only->name);
+        return 0;
+    } else if (argc > 2) {
+        printf("usage: chstats [pot|thermistor] [window <s> | reset | on | off]\n");
+        return 1;
+    }
+
+    if (!chstats_enabled()) {
+        printf("(running statistics are off)\n");
+    }
+    const logger_channel_t *ch;
+    for (uint8_t id = 0; (ch = logger_channel_by_id(id)); id++) {
+        if (only && ch != only) {
+            continue;
+        }
+        printf("%s (window %u s):\n", ch->name, (unsigned)chstats_get_window(ch->id));
+        console_print_chstats(ch, CHSTATS_BOOT, "since boot");
+        console_print_chstats(ch, CHSTATS_WINDOW, "window");
+        console_print_chstats(ch, CHSTATS_LAST_WINDOW, "last window");
+    }
+    return 0;
+}
+
+/**
+ * @brief noise <pot|thermistor> [off | <se_lsb> [min_reads] [max_reads]]
+ */
+static int cmd_noise(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: noise <pot|thermistor> [off | <se_lsb> [min_reads] [max_reads]]\n");
+        return 1;
+    }
+    const logger_channel_t *ch = console_channel(argv[1]);
+    if (!ch) {
+        return 1;
+    }
+
+    noise_cfg_t cfg = { .enabled = false };
+    if (argc == 3 && strcmp(argv[2], "off") == 0) {
+        noise_set(ch->id, &cfg);
+    } else if (argc >= 3) {
+        cfg = (noise_cfg_t){
+            .enabled = true,
+            .se_lsb = strtof(argv[2], NULL),
+            .min_reads = argc > 3 ? (uint16_t)atoi(argv[3]) : 1,
+            .max_reads = argc > 4 ? (uint16_t)atoi(argv[4]) : NOISE_READS_MAX,
+        };
+        if (!(cfg.se_lsb > 0)) {
+            printf("se_lsb must be > 0\n");
+            return 1;
+        }
+        noise_set(ch->id, &cfg);
+    }
+
+    noise_get(ch->id, &cfg);
+    if (cfg.enabled) {
+        printf("%s: reads per sample chosen for a standard error of %.2f LSB, %u..%u (from the next run)\n",
+               ch->name, cfg.se_lsb, (unsigned)cfg.min_reads, (unsigned)cfg.max_reads);
+    } else {
+        printf("%s: fixed %d reads per sample\n", ch->name, ch->oversample);
+    }
+    return 0;
+}
+
+/**
+ * @brief mode [eager|lazy]
+ */
+static int cmd_mode(int argc, char **argv) {
+    if (argc > 1) {
+        if (strcmp(argv[1], "eager") != 0 && strcmp(argv[1], "lazy") != 0) {
+            printf("usage: mode [eager|lazy]\n");
+            return 1;
+        }
+        logger_set_lazy(strcmp(argv[1], "lazy") == 0);
+    }
+    printf("%s conversion%s\n", logger_is_lazy() ? "lazy" : "eager",
+           logger_is_running() ? " (from the next run)" : "");
+    return 0;
+}
+
+/**
+ * @brief cal [vin|r_fixed|r0|t0|beta|gain|offset <value> | apply <file>]
+ */
+static int cmd_cal(int argc, char **argv) {
+    struct { const char *name; float *p; } params[] = {
+        { "vin", &logger_conv.vin }, { "r_fixed", &logger_conv.r_fixed }, { "r0", &logger_conv.r0 },
+        { "t0", &logger_conv.t0_c }, { "beta", &logger_conv.beta }, { "gain", &logger_conv.gain },
+        { "offset", &logger_conv.offset },
+    };
+
+    if (argc == 3 && strcmp(argv[1], "apply") == 0) {
+        char path[32];
+        console_path(argv[2], path, sizeof path);
+        esp_err_t err = logger_recalibrate(path);
+        if (err != ESP_OK) {
+            printf("not recalibrated: %s\n", err == ESP_ERR_INVALID_STATE ? "being logged" :
+                   err == ESP_ERR_NOT_SUPPORTED ? "not a lazy file" : esp_err_to_name(err));
+            return 1;
+        }
+    } else if (argc == 3) {
+        size_t i = 0;
+        while (i < sizeof params / sizeof params[0] && strcmp(argv[1], params[i].name) != 0) {
+            i++;
+        }
+        if (i == sizeof params / sizeof params[0]) {
+            printf("unknown parameter '%s'\n", argv[1]);
+            return 1;
+        }
+        // Lazy rows in the tail ring and hot windows are converted with the
+        // current parameters, so they can only change between runs
+        if (logger_is_running()) {
+            printf("stop logging first\n");
+            return 1;
+        }
+        *params[i].p = strtof(argv[2], NULL);
+
+        // Windows of finished lazy runs would now disagree with their files
+        for (uint8_t id = 0; id < HOTWIN_CHANNELS; id++) {
+            hotwin_info_t info;
+            if (hotwin_get_info(id, &info)) {
+                hotwin_forget(info.path);
+            }
+        }
+    } else if (argc != 1) {
+        printf("usage: cal [vin|r_fixed|r0|t0|beta|gain|offset <value> | apply <file>]\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof params / sizeof params[0]; i++) {
+        printf("%s=%g ", params[i].name, *params[i].p);
+    }
+    printf("\n");
+    return 0;
+}
+
+/**
+ * @brief gc <on|off>
+ */
+static int cmd_gc(int argc, char **argv) {
+    if (argc < 2 || (strcmp(argv[1], "on") != 0 && strcmp(argv[1], "off") != 0)) {
+        printf("usage: gc <on|off>\n");
+        return 1;
+    }
+    fs_gc_enable(strcmp(argv[1], "on") == 0);
+    return 0;
+}
+
+static const esp_console_cmd_t commands[] = {
+    { .command = "start", .help = "Start logging in the background (samples 0 = until stop)",
+      .hint = "<pot|thermistor> [period_ms] [samples] [file|raw]", .func = cmd_start },
+    { .command = "multi", .help = "Log several channels at independent rates in the background, each to its own file",
+      .hint = "<pot|thermistor>:<period_ms>[:samples][:file|raw] ...", .func = cmd_multi },
+    { .command = "scope", .help = "Sample fast, store only the samples around trigger events (until stop)",
+      .hint = "<pot|thermistor> <rising|falling|either|slope> <level> [period_us] [pre] [post] [file|raw]", .func = cmd_scope },
+    { .command = "spectrum", .help = "Sample fast and store FFT amplitude spectra or band RMS values instead of samples",
+      .hint = "<pot|thermistor> [period_us] [n] [avg] [bands] [rows] [file]", .func = cmd_spectrum },
+    { .command = "stop",  .help = "Stop logging and close the file", .func = cmd_stop },
+    { .command = "rate",  .help = "Set the sample period (also changes a running log)",
+      .hint = "<period_ms>", .func = cmd_rate },
+    { .command = "ls",    .help = "List SPIFFS files and raw log usage", .func = cmd_ls },
+    { .command = "rm",    .help = "Delete a file ('raw' erases the raw log)",
+      .hint = "<file|raw>", .func = cmd_rm },
+    { .command = "resample", .help = "Export several logs as one CSV table on a common time grid",
+      .hint = "<grid_ms> <linear|hold|decimate> <file>:<period_ms> ...", .func = cmd_resample },
+    { .command = "cat",   .help = "Export a file (or rows [first, first+count)) as CSV",
+      .hint = "<file|raw> [first] [count]", .func = cmd_cat },
+    { .command = "times", .help = "Export the raw log with a capture time column",
+      .hint = "[first] [count]", .func = cmd_times },
+    { .command = "seek",  .help = "Print raw log rows starting at a capture time (seconds, as shown by 'times')",
+      .hint = "<time_s> [count]", .func = cmd_seek },
+    { .command = "query", .help = "Find raw log rows by value, skipping blocks via their min/max",
+      .hint = "<pot|thermistor> <gt|lt|between> <a> [b] [max_rows]", .func = cmd_query },
+    { .command = "last",  .help = "Show the latest value of each channel (from RAM)",
+      .hint = "[pot|thermistor]", .func = cmd_last },
+    { .command = "hist",  .help = "Print the last seconds of a channel from the compressed RAM history",
+      .hint = "<pot|thermistor> [seconds] [max_rows]", .func = cmd_hist },
+    { .command = "tail",  .help = "Stream new rows while logging", .hint = "[seconds]", .func = cmd_tail },
+    { .command = "watch", .help = "Show the latest value of each channel while logging", .hint = "[seconds]", .func = cmd_watch },
+    { .command = "stats", .help = "Show logger, storage and heap statistics", .func = cmd_stats },
+    { .command = "cache", .help = "Show read cache counters or set its RAM budget",
+      .hint = "[budget_bytes]", .func = cmd_cache },
+    { .command = "compact", .help = "Compact closed CSV logs now, turn the background compactor on/off, or compact one file",
+      .hint = "<now|on|off|file>", .func = cmd_compact },
+    { .command = "adapt", .help = "Let a channel's sample rate follow its activity (fast while it moves, backing off while quiet)",
+      .hint = "<pot|thermistor> [off | <min_ms> <max_ms> <delta>]", .func = cmd_adapt },
+    { .command = "lossy", .help = "Store only the rows needed to rebuild a channel within eps (deadband or swinging door); export fills the gaps",
+      .hint = "<pot|thermistor> [off | <deadband|sdt> <eps>]", .func = cmd_lossy },
+    { .command = "chstats", .help = "Show running statistics per channel (since boot, current and last window; percentiles estimated with P²)",
+      .hint = "[pot|thermistor] [window <s> | reset | on | off]", .func = cmd_chstats },
+    { .command = "noise", .help = "Choose a channel's ADC reads per sample from its measured noise, for a target standard error",
+      .hint = "<pot|thermistor> [off | <se_lsb> [min_reads] [max_reads]]", .func = cmd_noise },
+    { .command = "mode",  .help = "Store converted values (eager) or raw codes converted on export (lazy: text in CSV files, 12-bit packed in the raw log)",
+      .hint = "[eager|lazy]", .func = cmd_mode },
+    { .command = "cal",   .help = "Show or set the conversion parameters, or re-convert a lazy file with them",
+      .hint = "[vin|r_fixed|r0|t0|beta|gain|offset <value> | apply <file>]", .func = cmd_cal },
+    { .command = "gc",    .help = "Turn background SPIFFS garbage collection on/off",
+      .hint = "<on|off>", .func = cmd_gc },
+    { .command = "bench", .help = "Run a benchmark", .hint = "<export [rows] | jitter [period_us] [samples] | query | hist [hours] | cache [passes] | pack [samples] | chstats [samples] | fft [n] | bus [blocks] | noise <pot|thermistor> [se_lsb] [samples] | adapt <pot|thermistor> [file] [period_ms]>", .func = cmd_bench },
+};
+
+/**
+ * @brief Register the logger commands and start the REPL on the console UART.
+ *
+ * The REPL runs in its own low-priority task; this function returns right away.
+ */
+void console_start(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "lab6>";
+    repl_config.max_cmdline_length = 128;
+
+    // Creating the REPL also initializes esp_console, so commands are registered after it
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
+
+    esp_console_register_help_command();
+    for (size_t i = 0; i < sizeof commands / sizeof commands[0]; i++) {
+        ESP_ERROR_CHECK(esp_console_cmd_register(&commands[i]));
+    }
+
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+}
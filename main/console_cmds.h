@@ -0,0 +1,7 @@
+#ifndef CONSOLE_CMDS_H
+#define CONSOLE_CMDS_H
+
+// Interactive command shell on the serial console (Demo 4)
+void console_start(void);
+
+#endif
@@ -4,16 +4,27 @@
  */
 
 #include <stdio.h>
-#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"          
 #include "esp_err.h"  
 #include "esp_log.h"     
 #include "esp_spiffs.h"     // SPIFFS filesystem support
+#include "nvs_flash.h"      // NVS (key/value store in the "nvs" partition)
 #include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "esp_adc/adc_oneshot.h"
 #include "hal/adc_types.h"
 #include "fs_helpers.h"
+#include "logger.h"
+#include "blkcache.h"
+#include "compact.h"
+#include "lossy.h"
+#include "hotwin.h"
 
 // Handle for oneshot ADC
 static adc_oneshot_unit_handle_t adc1_handle = NULL;
@@ -21,6 +32,10 @@ static adc_oneshot_unit_handle_t adc1_handle = NULL;
 // Tag used for ESP_LOG macros to identify logs from this file
 static const char *TAG = "FS";
 
+// Background garbage collection task and its counters
+static TaskHandle_t gc_task = NULL;
+static fs_gc_stats_t gc_stats = { .enabled = true };
+
 /**
  * @brief Mount the SPIFFS filesystem and log its total/used size.
  *
@@ -56,6 +71,24 @@ void fs_mount_or_die() {
     // Log the result
     ESP_LOGI(TAG, "SPIFFS mounted. total=%u bytes, used=%u bytes",
              (unsigned)total, (unsigned)used);
+
+    // All file reads go through the block cache
+    blkcache_init();
+}
+
+/**
+ * @brief Initialize NVS, erasing the partition if its layout is outdated or full.
+ *
+ * NVS holds small pieces of state that must survive a reboot (e.g. the raw
+ * log write cursor). On failure the program aborts (due to ESP_ERROR_CHECK).
+ */
+void nvs_init_or_die(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
 }
 
 /**
@@ -69,12 +102,15 @@ void fs_mount_or_die() {
  * @return void
  */
 void fs_print_file(const char *path) {
-    // Try to open the file in read mode
-    FILE *f = fopen(path, "r");
-
-    // If opening fails, print an error and return
-    if (!f) {
-        printf("[-] open for read failed: %s\n", path);
+    // Try to open the file for reading (through the block cache)
+    blkcache_file_t f;
+
+    // If opening fails, try the compacted copy, else print an error and return
+    if (!blkcache_open(&f, path)) {
+        printf("[*] contents of %s:\n", path);
+        if (!compact_print_range(path, 0, INT32_MAX, true)) {
+            printf("[-] open for read failed: %s\n", path);
+        }
         return;
     }
 
@@ -85,12 +121,12 @@ void fs_print_file(const char *path) {
     char buf[128];
 
     // Read and print each line until EOF is reached
-    while (fgets(buf, sizeof buf, f)) {
+    while (blkcache_gets(buf, sizeof buf, &f)) {
         printf("%s", buf);
     }
 
     // Close the file after reading
-    fclose(f);
+    blkcache_close(&f);
 
     // Add a newline for readability
     printf("\n");
@@ -132,6 +168,19 @@ void log_csv_sample(const char *path, int samples) {
 
     // Step 4: Close the file to flush buffers and save changes.
     fclose(f);
+    blkcache_invalidate(path, 0);
+}
+
+/**
+ * @brief Forget everything held about a file that is about to be rewritten.
+ *
+ * Drops its cached blocks, its compacted copy and its hot window, so readers
+ * don't serve the old contents from RAM or from the segment.
+ */
+void fs_forget(const char *path) {
+    compact_forget(path);
+    hotwin_forget(path);
+    blkcache_invalidate(path, 0);
 }
 
 /**
@@ -166,59 +215,74 @@ int adc_read_avg(adc_channel_t ch, int samples) {
         int raw = 0;
         adc_oneshot_read(adc1_handle, ch, &raw);
         sum += raw;
-        vTaskDelay(pdMS_TO_TICKS(2));  // small pause for stability
+        // No delay between reads: at CONFIG_FREERTOS_HZ=100 a 2 ms delay rounds
+        // to zero ticks anyway, and real sleeps here would cap the sample rate
     }
     return (int)(sum / samples);
 }
 
 /**
- * @brief Append potentiometer readings to a CSV file.
- * 
+ * @brief ISR-safe version of adc_read_avg(), used by the logger's timer ISR.
+ *
+ * Placed in IRAM and built on adc_oneshot_read_isr(), which is itself in IRAM
+ * with CONFIG_ADC_ONESHOT_CTRL_FUNC_IN_IRAM, so it keeps working while flash
+ * writes have the cache disabled. Unlike adc_oneshot_read() it takes no lock:
+ * don't call adc_read_avg() on the same unit while the logger is running.
+ *
+ * Also returns the spread of the reads for noise-adaptive averaging (noise.c),
+ * in integer math only: the ISR must not use the FPU.
+ *
+ * @param ch       ADC channel to read from
+ * @param samples  Number of samples to average (<= 64, so the sum of squares fits in 32 bits)
+ * @param m2       Out: sum of squared deviations of the reads from their mean (may be NULL)
+ * @return int     Average raw ADC value (0–4095 for 12-bit)
+ */
+int IRAM_ATTR adc_read_avg_isr(adc_channel_t ch, int samples, uint32_t *m2) {
+    int sum = 0;
+    uint32_t sq = 0;
+    for (int i = 0; i < samples; ++i) {
+        int raw = 0;
+        adc_oneshot_read_isr(adc1_handle, ch, &raw);
+        sum += raw;
+        sq += (uint32_t)(raw * raw);
+    }
+    if (m2) {
+        // sum((x - mean)^2) = (n * sum(x^2) - sum(x)^2) / n
+        *m2 = (uint32_t)(((uint64_t)samples * sq - (uint64_t)sum * sum) / samples);
+    }
+    return sum / samples;
+}
+
+/**
+ * @brief Log thermistor temperatures (°C) to a CSV file.
+ *
+ * Thin wrapper around the shared logging core (logger.c). The file is
+ * overwritten and starts with the header "index,temperature_C".
+ *
  * @param path     File path in SPIFFS (e.g., "/spiffs/data.csv")
  * @param samples  Number of rows to log
  * @param period   Delay between samples (ms)
  */
-
 void log_thermistor_samples_csv(const char *path, int samples, int period) {
-    FILE *f = fopen(path, "w");  // write mode - overwrites existing file
-    if (!f) {
-        printf("open for write failed: %s\n", path);
-        return;
-    }
-    
-    // Write header
-    fprintf(f, "index,temperature_C\n");
-
-    for (int i = 0; i < samples; i++) {
-        
-        int raw = adc_read_avg(ADC_CH_THERMISTOR, SAMPLES);
-        
-        // Thermistor temperature calculation using Beta equation
-        const float Vin = 3.3f;           // Supply voltage
-        const float R_fixed = 10000.0f;   // 10k series resistor
-        const float R0 = 10000.0f;        // Thermistor resistance at 25°C
-        const float T0 = 25.0f + 273.15f; // 25°C in Kelvin
-        const float B = 3950.0f;          // Beta coefficient
-        
-        // Convert ADC to voltage
-        float VRT = ((float)raw * Vin) / (float)ADC_MAX;
-        
-        // Calculate thermistor resistance using voltage divider
-        // Divider: Vin -> R_fixed -> node(VRT) -> Thermistor -> GND
-        float RT = (R_fixed * VRT) / (Vin - VRT);
-        
-        // Beta equation: 1/T = 1/T0 + (1/B)*ln(RT/R0)
-        float T_kelvin = 1.0f / ((1.0f / T0) + (logf(RT / R0) / B));
-        float temperature = T_kelvin - 273.15f; // Convert to Celsius
-
-        fprintf(f, "#%d, %.2f°C\n", i, temperature);
-        fflush(f); // flush to SPIFFS
-        vTaskDelay(pdMS_TO_TICKS(period));
-    }
+    logger_run(&LOGGER_CH_THERMISTOR, path, samples, (uint32_t)period * 1000);
+}
 
-    fclose(f);
+/**
+ * @brief Log potentiometer voltages to a CSV file.
+ *
+ * Thin wrapper around the shared logging core (logger.c). The file is
+ * overwritten and starts with the header "index,voltage_V".
+ *
+ * @param path     File path in SPIFFS (e.g., "/spiffs/data.csv")
+ * @param samples  Number of rows to log
+ * @param period   Delay between samples (ms)
+ */
+void log_pot_samples_csv(const char *path, int samples, int period) {
+    logger_run(&LOGGER_CH_POT, path, samples, (uint32_t)period * 1000);
 }
 
+static void fs_print_tagged(blkcache_file_t *f, const char *first_line, int first, int count, bool header);
+
 /**
  * @brief Print only the contents of a CSV file, without extra log messages.
  * 
@@ -237,22 +301,472 @@ void print_csv_file_only(const char *path) {
     // Suppress ESP-IDF info/debug logs so only our CSV is printed
     esp_log_level_set("*", ESP_LOG_WARN);
 
-    // Open file for reading
-    FILE *f = fopen(path, "r");
-    if (f) {
+    // Open file for reading (through the block cache)
+    blkcache_file_t f;
+    if (blkcache_open(&f, path)) {
         char buf[256];
         size_t n;
 
+        // Lazy and lossy files are exported converted/filled in, like any other log
+        buf[0] = '\0';
+        if (blkcache_gets(buf, sizeof buf, &f) && buf[0] == '%') {
+            fs_print_tagged(&f, buf, 0, INT32_MAX, true);
+            blkcache_close(&f);
+            return;
+        }
+        fwrite(buf, 1, strlen(buf), stdout);
+
         // Read chunks from file and print exactly as they are
         // Each chunk may contain multiple CSV lines already ending in '\n'
-        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        while ((n = blkcache_read(&f, buf, sizeof(buf))) > 0) {
             fwrite(buf, 1, n, stdout);  // write to standard output (serial)
         }
-        fclose(f);
-    } else {
+        blkcache_close(&f);
+    } else if (!compact_print_range(path, 0, INT32_MAX, true)) {
         // If file couldn't be opened, still output valid CSV format
         printf("error,message\r\n,Could not open file\r\n");
     }
 }
 
 
+
+/**
+ * @brief Print rows of a lazy file (raw codes) converted with the file's own parameters.
+ *
+ * 'conv_line' is the file's first line, already read from 'f'. The output is
+ * what an eager run with those parameters would have written: the channel's
+ * CSV header (if 'header') and the rows with index [first, first + count). Rows are
+ * converted LOGGER_CONV_BATCH at a time so the per-file setup is paid once
+ * per batch instead of once per row.
+ */
+static void fs_print_lazy(blkcache_file_t *f, const char *conv_line, int first, int count, bool header) {
+    logger_conv_t conv;
+    const logger_channel_t *ch = logger_conv_parse(conv_line, &conv);
+    if (!ch) {
+        printf("error,message\r\n,Unknown conversion parameters\r\n");
+        return;
+    }
+
+    char buf[64];
+    blkcache_gets(buf, sizeof buf, f);   // "index,raw_code"
+    if (header) {
+        printf("%s\n", ch->csv_header);
+    }
+
+    int idx[LOGGER_CONV_BATCH];
+    uint16_t raw[LOGGER_CONV_BATCH];
+    float val[LOGGER_CONV_BATCH];
+    int n = 0;
+    int64_t end = (int64_t)first + count;
+    bool more = true;
+
+    // Rows are selected by their index, like in fs_print_lines()
+    while (more) {
+        more = blkcache_gets(buf, sizeof buf, f);
+        int index, code;
+        if (more && sscanf(buf, "#%d, %d", &index, &code) == 2) {
+            if (index >= end) {
+                more = false;
+            } else if (index >= first) {
+                idx[n] = index;
+                raw[n++] = (uint16_t)code;
+            }
+        }
+        if (n == LOGGER_CONV_BATCH || (!more && n > 0)) {
+            logger_convert_batch(ch, &conv, raw, val, n);
+            for (int i = 0; i < n; i++) {
+                printf(ch->row_fmt, idx[i], val[i]);
+            }
+            n = 0;
+        }
+    }
+}
+
+// Where fs_print_lossy() sends the rebuilt rows
+typedef struct {
+    const logger_channel_t *ch;
+    int first;
+    int end;
+} fs_fill_ctx_t;
+
+static void fs_print_filled(uint32_t index, float value, void *arg) {
+    fs_fill_ctx_t *c = arg;
+    if ((int)index >= c->first && (int)index < c->end) {
+        printf(c->ch->row_fmt, (int)index, value);
+    }
+}
+
+/**
+ * @brief Print rows of a lossy file with the dropped rows filled in again.
+ *
+ * 'lossy_line' is the file's first line, already read from 'f'. A lossy file
+ * skips rows, so [first, first + count) are row indices here, not positions:
+ * every index in the range is printed, stored or rebuilt by lossy_fill().
+ */
+static void fs_print_lossy(blkcache_file_t *f, const char *lossy_line, int first, int count, bool header) {
+    lossy_cfg_t cfg;
+    const logger_channel_t *ch = lossy_parse(lossy_line, &cfg);
+    if (!ch) {
+        printf("error,message\r\n,Unknown compression parameters\r\n");
+        return;
+    }
+
+    char buf[64];
+    blkcache_gets(buf, sizeof buf, f);   // the channel's own header
+    if (header) {
+        printf("%s\n", ch->csv_header);
+    }
+
+    fs_fill_ctx_t ctx = { .ch = ch, .first = first,
+                          .end = count > INT32_MAX - first ? INT32_MAX : first + count };
+    lossy_fill_t fill = { .mode = cfg.mode };
+    // The row after the range is still needed to interpolate up to its end
+    while (blkcache_gets(buf, sizeof buf, f)) {
+        int index;
+        float value;
+        if (sscanf(buf, "#%d, %f", &index, &value) == 2 && index >= 0) {
+            lossy_fill(&fill, (uint32_t)index, value, fs_print_filled, &ctx);
+            if (index >= ctx.end - 1) {
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Print a file whose first line starts with a '%' tag (lazy or lossy).
+ */
+static void fs_print_tagged(blkcache_file_t *f, const char *first_line, int first, int count, bool header) {
+    if (strncmp(first_line, LOSSY_TAG, strlen(LOSSY_TAG)) == 0) {
+        fs_print_lossy(f, first_line, first, count, header);
+    } else {
+        fs_print_lazy(f, first_line, first, count, header);
+    }
+}
+
+/**
+ * @brief Print the header (if 'header') and data rows [first, first + count) of a CSV file.
+ */
+static void fs_print_lines(const char *path, int first, int count, bool header) {
+    blkcache_file_t f;
+    if (!blkcache_open(&f, path)) {
+        // Closed logs may have been compacted (compact.c)
+        if (!compact_print_range(path, first, count, header)) {
+            printf("error,message\r\n,Could not open file\r\n");
+        }
+        return;
+    }
+
+    char buf[LOGGER_CONV_LINE_MAX];   // the first line of a lazy file is the longest
+    if (!blkcache_gets(buf, sizeof buf, &f)) {
+        blkcache_close(&f);
+        return;
+    }
+    if (buf[0] == '%') {
+        fs_print_tagged(&f, buf, first, count, header);
+        blkcache_close(&f);
+        return;
+    }
+    if (header) {
+        printf("%s", buf);
+    }
+
+    // Log rows carry their index ("#<index>, ...") and are selected by it, as
+    // in lossy files: a scope log skips indices, so positions would not match
+    // the rows the hot window returns. Rows of other CSV files go by position.
+    int64_t end = (int64_t)first + count;
+    int row = 0;
+    bool line_start = true;
+    bool in_range = false;
+
+    while (blkcache_gets(buf, sizeof buf, &f)) {
+        if (line_start) {
+            int index = buf[0] == '#' ? atoi(buf + 1) : row;
+            if (index >= end) {
+                break;
+            }
+            in_range = index >= first;
+        }
+        if (in_range) {
+            printf("%s", buf);
+        }
+        // Only count complete lines (a long line may take several fgets calls)
+        line_start = strchr(buf, '\n') != NULL;
+        if (line_start) {
+            row++;
+        }
+    }
+    blkcache_close(&f);
+}
+
+/**
+ * @brief Print a range of rows from a CSV file as pure CSV.
+ *
+ * The header line is always printed; after it, data rows with index
+ * [first, first + count) are printed (the first data row has index 0). Log
+ * rows are selected by their "#<index>", so a scope log with gaps prints the
+ * rows it has in that range; rows of other CSV files go by position.
+ *
+ * @param path   File path in SPIFFS (e.g., "/spiffs/data.csv")
+ * @param first  Index of the first data row to print
+ * @param count  Number of data rows to print
+ */
+void fs_print_range(const char *path, int first, int count) {
+    fs_print_lines(path, first, count, true);
+}
+
+/**
+ * @brief Print data rows [first, first + count) of a CSV file, without the header.
+ *
+ * Used by the hot window for the part of a range that is older than its RAM copy.
+ */
+void fs_print_rows(const char *path, int first, int count) {
+    fs_print_lines(path, first, count, false);
+}
+
+/**
+ * @brief Open any log file for reading its rows one by one (fs_rows_next()).
+ *
+ * Falls back to the compacted segment once the CSV is gone, like the print
+ * functions. Memory use is the reader struct itself, whatever the file size.
+ *
+ * @return false if neither the file nor a segment can be read, or the format is unknown
+ */
+bool fs_rows_open(fs_rows_t *r, const char *path) {
+    memset(r, 0, sizeof *r);
+    if (!blkcache_open(&r->f, path)) {
+        uint8_t id;
+        if (!compact_reader_open(&r->seg, path, &id)) {
+            return false;
+        }
+        r->kind = FS_ROWS_COMPACT;
+        r->ch = logger_channel_by_id(id);
+        if (!r->ch) {
+            compact_reader_close(&r->seg);
+            return false;
+        }
+        return true;
+    }
+
+    char line[LOGGER_CONV_LINE_MAX];
+    if (!blkcache_gets(line, sizeof line, &r->f)) {
+        blkcache_close(&r->f);
+        return false;
+    }
+    lossy_cfg_t lc;
+    if ((r->ch = logger_conv_parse(line, &r->conv)) != NULL) {
+        r->kind = FS_ROWS_LAZY;
+        blkcache_gets(line, sizeof line, &r->f);   // "index,raw_code"
+    } else if ((r->ch = lossy_parse(line, &lc)) != NULL) {
+        r->kind = FS_ROWS_LOSSY;
+        r->mode = lc.mode;
+        blkcache_gets(line, sizeof line, &r->f);   // the channel's own header
+    } else {
+        // A plain CSV: the header tells which channel wrote it
+        line[strcspn(line, "\r\n")] = '\0';
+        for (uint8_t id = 0; logger_channel_by_id(id); id++) {
+            if (strcmp(line, logger_channel_by_id(id)->csv_header) == 0) {
+                r->ch = logger_channel_by_id(id);
+            }
+        }
+        r->kind = FS_ROWS_PLAIN;
+    }
+    if (!r->ch) {
+        blkcache_close(&r->f);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Next "#index, value" line of a CSV file (value as written, or the raw code).
+ */
+static bool fs_rows_line(fs_rows_t *r, int *index, float *value) {
+    char buf[64];
+    while (blkcache_gets(buf, sizeof buf, &r->f)) {
+        if (sscanf(buf, "#%d, %f", index, value) == 2 && *index >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Next row of the file, in index order.
+ *
+ * @return false at the end of the file
+ */
+bool fs_rows_next(fs_rows_t *r, uint32_t *index, float *value) {
+    int i;
+    float v;
+    switch (r->kind) {
+    case FS_ROWS_COMPACT:
+        return compact_reader_next(&r->seg, index, value);
+
+    case FS_ROWS_PLAIN:
+        if (!fs_rows_line(r, &i, &v)) {
+            return false;
+        }
+        *index = (uint32_t)i;
+        *value = v;
+        return true;
+
+    case FS_ROWS_LAZY:
+        // Convert LOGGER_CONV_BATCH codes at a time, as fs_print_lazy() does
+        if (r->pos == r->n) {
+            uint16_t raw[LOGGER_CONV_BATCH];
+            r->n = r->pos = 0;
+            while (r->n < LOGGER_CONV_BATCH && fs_rows_line(r, &i, &v)) {
+                r->idx[r->n] = i;
+                raw[r->n++] = (uint16_t)v;
+            }
+            if (r->n == 0) {
+                return false;
+            }
+            logger_convert_batch(r->ch, &r->conv, raw, r->val, r->n);
+        }
+        *index = (uint32_t)r->idx[r->pos];
+        *value = r->val[r->pos++];
+        return true;
+
+    case FS_ROWS_LOSSY:
+        if (!r->have_next) {
+            if (!fs_rows_line(r, &i, &v)) {
+                return false;
+            }
+            r->next_i = (uint32_t)i;
+            r->next_v = v;
+            r->have_next = true;
+        }
+        // Rows dropped before the next stored one first, then the stored row itself
+        if (r->have_prev && r->fill_i < r->next_i) {
+            *index = r->fill_i;
+            *value = lossy_estimate(r->mode, r->prev_i, r->prev_v, r->next_i, r->next_v, r->fill_i);
+            r->fill_i++;
+            return true;
+        }
+        *index = r->next_i;
+        *value = r->next_v;
+        r->prev_i = r->next_i;
+        r->prev_v = r->next_v;
+        r->fill_i = r->next_i + 1;
+        r->have_prev = true;
+        r->have_next = false;
+        return true;
+    }
+    return false;
+}
+
+void fs_rows_close(fs_rows_t *r) {
+    if (r->kind == FS_ROWS_COMPACT) {
+        compact_reader_close(&r->seg);
+    } else {
+        blkcache_close(&r->f);
+    }
+}
+
+/**
+ * @brief List the files in SPIFFS with their sizes, followed by total/used space.
+ */
+void fs_list(void) {
+    DIR *dir = opendir("/spiffs");
+    if (!dir) {
+        printf("[-] opendir failed: /spiffs\n");
+        return;
+    }
+
+    struct dirent *e;
+    char path[64];
+    while ((e = readdir(dir)) != NULL) {
+        struct stat st;
+        snprintf(path, sizeof path, "/spiffs/%s", e->d_name);
+        if (stat(path, &st) == 0) {
+            printf("%8ld  %s\n", (long)st.st_size, path);
+        }
+    }
+    closedir(dir);
+
+    size_t total = 0, used = 0;
+    esp_spiffs_info(NULL, &total, &used);
+    printf("[*] SPIFFS total=%u bytes, used=%u bytes\n", (unsigned)total, (unsigned)used);
+}
+
+/**
+ * @brief Low-priority task that garbage-collects SPIFFS between foreground writes.
+ *
+ * SPIFFS reclaims deleted pages lazily: when a write finds too few erased
+ * blocks it runs GC (up to CONFIG_SPIFFS_GC_MAX_RUNS passes) inside that
+ * write, which shows up as a latency spike in the logger. This task asks
+ * SPIFFS to keep FS_GC_RESERVE_BYTES ready instead. It is woken right after
+ * each logger commit, i.e. at the start of the longest gap before the next
+ * write, and otherwise checks every FS_GC_IDLE_MS. When enough clean space is
+ * available esp_spiffs_gc() returns without doing any work.
+ */
+static void fs_gc_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FS_GC_IDLE_MS));
+        if (!gc_stats.enabled) {
+            continue;
+        }
+
+        size_t total = 0, used = 0;
+        if (esp_spiffs_info(NULL, &total, &used) != ESP_OK) {
+            continue;
+        }
+        // Never ask for more than half of what is left, or GC can't succeed
+        size_t want = (total - used) / 2;
+        if (want > FS_GC_RESERVE_BYTES) {
+            want = FS_GC_RESERVE_BYTES;
+        }
+        if (want == 0) {
+            continue;
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = esp_spiffs_gc(NULL, want);
+        uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+        gc_stats.calls++;
+        gc_stats.total_us += dt;
+        if (dt > gc_stats.max_us) {
+            gc_stats.max_us = dt;
+        }
+        if (err != ESP_OK) {
+            gc_stats.failures++;
+        }
+    }
+}
+
+/**
+ * @brief Start the background GC task (SPIFFS must be mounted).
+ */
+void fs_gc_start(void) {
+    if (gc_task) {
+        return;
+    }
+    // Priority 1 and the core the acquisition task doesn't use
+    xTaskCreatePinnedToCore(fs_gc_task, "fs_gc", 3072, NULL, 1, &gc_task, 0);
+}
+
+/**
+ * @brief Wake the GC task; called right after a foreground write completes.
+ */
+void fs_gc_kick(void) {
+    if (gc_task) {
+        xTaskNotifyGive(gc_task);
+    }
+}
+
+/**
+ * @brief Enable or disable background GC (e.g. to compare write latency with and without it).
+ */
+void fs_gc_enable(bool on) {
+    gc_stats.enabled = on;
+}
+
+/**
+ * @brief Copy the background GC counters.
+ */
+void fs_gc_get_stats(fs_gc_stats_t *out) {
+    *out = gc_stats;
+}
@@ -1,10 +1,17 @@
 #ifndef FS_HELPERS_H
 #define FS_HELPERS_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "hal/adc_types.h"
+#include "logger.h"
+#include "blkcache.h"
+#include "compact.h"
+#include "lossy.h"
 
 static const char LOG_PATH[]  = "/spiffs/potdata.csv";        // file to store pot samples (Demo 3.2)
 static const char TEMP_PATH[] = "/spiffs/thermodata.csv";     // file to store thermistor samples (Demo 3.2)
+static const char RAWLOG_PATH[] = "/rawlog";                  // log to the raw block log partition instead of SPIFFS (Demo 3.5)
 
 // Potentiometer config (Demo 3.2)
 #define ADC_BITS          12
@@ -19,10 +26,15 @@ static const char TEMP_PATH[] = "/spiffs/thermodata.csv";     // file to store t
 #define ADC_UNIT_ID       ADC_UNIT_1
 #define ADC_CH_THERMISTOR ADC_CHANNEL_4   // GPIO5
 
+// NVS namespace for settings and checkpoints that survive a reboot
+#define NVS_NAMESPACE     "lab6"
+
 // File system & file handling functions (Demo 1, 2.1, 2.2, 3.1)
 void fs_mount_or_die();
+void nvs_init_or_die(void);
 void fs_print_file(const char *path);
 void log_csv_sample(const char *path, int samples);
+void fs_forget(const char *path);   // drop cached blocks, compacted copy and hot window of a file being rewritten
 void log_thermistor_samples_csv(const char *path, int samples, int period);
 
 // ADC functions (Demo 3.2)
@@ -30,9 +42,62 @@ void log_thermistor_samples_csv(const char *path, int samples, int period);
 void log_pot_samples_csv(const char *path, int samples, int period);
 void adc_oneshot_setup();
 int adc_read_avg(adc_channel_t ch, int samples); // Read and average multiple ADC samples from specified channel
+int adc_read_avg_isr(adc_channel_t ch, int samples, uint32_t *m2); // Same, callable from an IRAM ISR (logger timer); m2 = spread of the reads
 
 // csv to excel (Demo 3.3)
 void print_csv_file_only(const char *path); // Function declaration for printing CSV file only over serial
+void fs_print_range(const char *path, int first, int count); // Print the header plus data rows [first, first+count)
+void fs_print_rows(const char *path, int first, int count);  // Same rows without the header
+
+// Pull-style reader of the data rows of any log file: plain, lazy (converted
+// with the file's parameters), lossy (dropped rows rebuilt) or compacted
+typedef enum {
+    FS_ROWS_PLAIN,
+    FS_ROWS_LAZY,
+    FS_ROWS_LOSSY,
+    FS_ROWS_COMPACT,
+} fs_rows_kind_t;
+
+typedef struct {
+    fs_rows_kind_t kind;
+    const logger_channel_t *ch;
+    union {
+        blkcache_file_t f;           // CSV file
+        compact_reader_t seg;        // compacted segment
+    };
+    logger_conv_t conv;              // lazy: the file's conversion parameters
+    int idx[LOGGER_CONV_BATCH];      // lazy: rows converted together
+    float val[LOGGER_CONV_BATCH];
+    int n, pos;
+    lossy_mode_t mode;               // lossy: how dropped rows are rebuilt
+    bool have_prev, have_next;       // lossy: stored rows around the gap being filled
+    uint32_t prev_i, next_i, fill_i;
+    float prev_v, next_v;
+} fs_rows_t;
+
+bool fs_rows_open(fs_rows_t *r, const char *path);
+bool fs_rows_next(fs_rows_t *r, uint32_t *index, float *value);
+void fs_rows_close(fs_rows_t *r);
+
+// Console helpers (Demo 4)
+void fs_list(void); // List SPIFFS files with sizes
+
+// Background SPIFFS garbage collection (Demo 4)
+#define FS_GC_RESERVE_BYTES  (16 * 1024)   // clean space kept ready so appends don't trigger GC
+#define FS_GC_IDLE_MS        1000          // GC check interval when nobody kicks the task
+
+typedef struct {
+    bool     enabled;
+    uint32_t calls;       // esp_spiffs_gc() calls
+    uint32_t failures;    // calls that could not reach the reserve (partition nearly full)
+    uint32_t total_us;    // time spent in GC
+    uint32_t max_us;      // longest single GC call
+} fs_gc_stats_t;
+
+void fs_gc_start(void);                    // start the low-priority GC task
+void fs_gc_kick(void);                     // tell it a write just finished (idle gap starts now)
+void fs_gc_enable(bool on);                // turn background GC on/off (for comparisons)
+void fs_gc_get_stats(fs_gc_stats_t *out);
 
 // Forward declaration of adc_oneshot_setup function
 void adc_oneshot_setup(void);
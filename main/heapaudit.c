@@ -0,0 +1,95 @@
+/**
+ * @file heapaudit.c
+ * @brief Count heap allocations of a task (and of ISRs) over a time window.
+ *
+ * With CONFIG_HEAP_USE_HOOKS the heap calls esp_heap_trace_alloc_hook() and
+ * esp_heap_trace_free_hook() on every successful allocation and free, from
+ * whatever task or interrupt made it. The hooks below only bump counters
+ * (atomically: both cores allocate), attributing each call to the audited
+ * task, to interrupt context or to anyone else. They run inside the heap
+ * functions, so they are in IRAM and must not allocate or block themselves.
+ *
+ * The net change of allocated heap blocks (heap_caps_get_info()) is recorded
+ * as well; it is all there is without the hooks, and it misses an allocation
+ * that is freed again within the window.
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "heapaudit.h"
+
+static heapaudit_t audit;
+static TaskHandle_t audited;
+static int64_t t_begin;
+static size_t blocks_begin;
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    if (!__atomic_load_n(&audit.active, __ATOMIC_RELAXED)) {
+        return;
+    }
+    if (xPortInIsrContext()) {
+        __atomic_fetch_add(&audit.isr_mallocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&audit.bytes, size, __ATOMIC_RELAXED);
+    } else if (xTaskGetCurrentTaskHandle() == audited) {
+        __atomic_fetch_add(&audit.mallocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&audit.bytes, size, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&audit.other_mallocs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+    if (__atomic_load_n(&audit.active, __ATOMIC_RELAXED) && !xPortInIsrContext() &&
+        xTaskGetCurrentTaskHandle() == audited) {
+        __atomic_fetch_add(&audit.frees, 1, __ATOMIC_RELAXED);
+    }
+}
+#endif
+
+static size_t heapaudit_blocks(void) {
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+    return info.allocated_blocks;
+}
+
+/**
+ * @brief Start counting the allocations of 'task' (and of ISRs).
+ */
+void heapaudit_begin(TaskHandle_t task) {
+    __atomic_store_n(&audit.active, false, __ATOMIC_RELAXED);
+    memset(&audit, 0, sizeof audit);
+#ifdef CONFIG_HEAP_USE_HOOKS
+    audit.hooks = true;
+#endif
+    audited = task;
+    blocks_begin = heapaudit_blocks();
+    t_begin = esp_timer_get_time();
+    __atomic_store_n(&audit.active, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Stop counting; the result stays available through heapaudit_get().
+ */
+void heapaudit_end(void) {
+    if (!audit.active) {
+        return;
+    }
+    __atomic_store_n(&audit.active, false, __ATOMIC_RELEASE);
+    audit.net_blocks = (int32_t)heapaudit_blocks() - (int32_t)blocks_begin;
+    audit.window_us = esp_timer_get_time() - t_begin;
+}
+
+/**
+ * @brief Counts of the running or the last audit window.
+ */
+void heapaudit_get(heapaudit_t *out) {
+    *out = audit;
+    if (out->active) {
+        out->net_blocks = (int32_t)heapaudit_blocks() - (int32_t)blocks_begin;
+        out->window_us = esp_timer_get_time() - t_begin;
+    }
+}
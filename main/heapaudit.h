@@ -0,0 +1,31 @@
+#ifndef HEAPAUDIT_H
+#define HEAPAUDIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Heap allocation audit: counts the heap allocations and frees made by one
+// task and by interrupt handlers between heapaudit_begin() and heapaudit_end().
+// The logger audits its storage task (plus the timer ISR) from the start of
+// the sampling loop to its end, i.e. in steady state, after the file and the
+// timer have been set up. Exact counts need CONFIG_HEAP_USE_HOOKS; without it
+// only the net change of allocated heap blocks is available.
+typedef struct {
+    bool     hooks;          // counts come from the heap hooks (exact)
+    bool     active;
+    uint32_t mallocs;        // allocations by the audited task
+    uint32_t frees;
+    uint32_t isr_mallocs;    // allocations from interrupt context
+    uint32_t other_mallocs;  // by other tasks meanwhile (console, ...)
+    uint32_t bytes;          // bytes allocated by the audited task and ISRs
+    int32_t  net_blocks;     // change of allocated heap blocks over the window (all tasks)
+    int64_t  window_us;
+} heapaudit_t;
+
+void heapaudit_begin(TaskHandle_t task);
+void heapaudit_end(void);
+void heapaudit_get(heapaudit_t *out);
+
+#endif
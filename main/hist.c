@@ -0,0 +1,372 @@
+/**
+ * @file hist.c
+ * @brief Compressed in-RAM history of every channel (hours of samples in a few tens of KB).
+ *
+ * The hot window (hotwin.c) keeps the last HOTWIN_LEN records as 24-byte
+ * logger_record_t structs, which is minutes of data. For longer history the
+ * storage loop also pushes the raw 12-bit ADC code of every sample here:
+ *
+ *  - samples are collected in an open block of HIST_BLOCK_LEN codes (2 bytes each);
+ *  - a full block is sealed: its first code goes into the directory, the
+ *    other codes are stored as deltas, zigzag-encoded and bit-packed with the
+ *    smallest width that fits all of them, see codec.c (a slowly changing,
+ *    oversampled signal needs 2-4 bits per sample instead of 16);
+ *  - timestamps are not stored per sample: a block only spans samples with
+ *    a steady interval, so t = t0 + i * dt reproduces them to within the
+ *    sampling jitter. A rate change, a gap or a new run seals
+ *    the block early;
+ *  - the packed data lives in a per-channel ring arena; when it (or the
+ *    directory) is full the oldest blocks are dropped.
+ *
+ * Values are converted with the channel's convert function when read, so the
+ * history is lossless with respect to the stored CSV (same raw code in).
+ * Appending costs a store into the open block, plus one pack of
+ * HIST_BLOCK_LEN deltas per block. Readers copy one block at a time under a
+ * short spinlock and decode outside of it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "logger.h"
+#include "hist.h"
+#include "codec.h"
+
+// Directory entry of a sealed block
+typedef struct {
+    int64_t  t0_us;          // capture time of the first sample
+    uint32_t dt_us;          // average interval between samples
+    uint32_t first_index;    // row index of the first sample
+    uint16_t off;            // packed deltas in the arena
+    uint16_t first_raw;      // first code (stored verbatim)
+    uint8_t  width;          // bits per packed delta (0 = constant block)
+    uint8_t  count;          // samples in the block
+} hist_block_t;
+
+typedef struct {
+    // Sealed blocks: directory ring (oldest = first_seq) + arena ring
+    hist_block_t dir[HIST_DIR_LEN];
+    uint32_t first_seq;      // sequence number of the oldest block
+    uint32_t n;              // blocks in the directory
+    uint32_t wr;             // arena write offset
+    uint32_t used;           // arena bytes held by live blocks
+    uint32_t sealed_samples;
+    uint8_t  arena[HIST_ARENA_BYTES];
+
+    // Open block
+    uint16_t raw[HIST_BLOCK_LEN];
+    uint32_t count;
+    uint32_t first_index;
+    int64_t  t0_us;
+    int64_t  tlast_us;
+} hist_t;
+
+static hist_t hist[HIST_CHANNELS];
+static portMUX_TYPE hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Bytes taken by the packed deltas of a block.
+ */
+static size_t hist_packed_len(uint8_t count, uint8_t width) {
+    return codec_delta_len(count, width);
+}
+
+/**
+ * @brief Delta-pack the codes raw[0..count) (see codec.c).
+ *
+ * @return Bits per delta
+ */
+static uint8_t hist_pack(const uint16_t *raw, int count, uint8_t *out) {
+    int32_t v[HIST_BLOCK_LEN];
+    for (int i = 0; i < count; i++) {
+        v[i] = raw[i];
+    }
+    uint8_t width = codec_delta_width(v, count);
+    codec_delta_pack(v, count, width, out);
+    return width;
+}
+
+/**
+ * @brief Inverse of hist_pack(): rebuild the codes of a block.
+ */
+static void hist_unpack(const hist_block_t *b, const uint8_t *in, uint16_t *raw) {
+    int32_t v[HIST_BLOCK_LEN];
+    codec_delta_unpack(in, b->count, b->width, b->first_raw, v);
+    for (int i = 0; i < b->count; i++) {
+        raw[i] = (uint16_t)v[i];
+    }
+}
+
+/**
+ * @brief Drop the oldest sealed block. Called with hist_lock held.
+ */
+static void hist_evict(hist_t *h) {
+    hist_block_t *b = &h->dir[h->first_seq % HIST_DIR_LEN];
+    h->used -= hist_packed_len(b->count, b->width);
+    h->sealed_samples -= b->count;
+    h->first_seq++;
+    h->n--;
+}
+
+/**
+ * @brief Compress the open block into the arena and the directory.
+ */
+static void hist_seal(hist_t *h) {
+    if (h->count == 0) {
+        return;
+    }
+
+    // Pack outside the lock; only the copy into the ring is done under it
+    uint8_t packed[(HIST_BLOCK_LEN * 16 + 7) / 8];
+    hist_block_t b = {
+        .t0_us = h->t0_us,
+        .dt_us = h->count > 1 ? (uint32_t)((h->tlast_us - h->t0_us) / (h->count - 1)) : 0,
+        .first_index = h->first_index,
+        .first_raw = h->raw[0],
+        .count = (uint8_t)h->count,
+    };
+    b.width = hist_pack(h->raw, h->count, packed);
+    size_t len = hist_packed_len(b.count, b.width);
+
+    portENTER_CRITICAL(&hist_lock);
+    if (h->wr + len > HIST_ARENA_BYTES) {
+        // Wrap: blocks between the write offset and the end are the oldest ones
+        while (h->n > 0) {
+            const hist_block_t *old = &h->dir[h->first_seq % HIST_DIR_LEN];
+            if (old->off < h->wr || (old->off == h->wr && hist_packed_len(old->count, old->width) == 0)) {
+                break;
+            }
+            hist_evict(h);
+        }
+        h->wr = 0;
+    }
+    // Make room: oldest blocks overlapping [wr, wr + len), or a full directory
+    while (h->n > 0) {
+        const hist_block_t *old = &h->dir[h->first_seq % HIST_DIR_LEN];
+        size_t old_len = hist_packed_len(old->count, old->width);
+        bool overlaps = len > 0 && old_len > 0 && old->off < h->wr + len && h->wr < old->off + old_len;
+        if (!overlaps && h->n < HIST_DIR_LEN) {
+            break;
+        }
+        hist_evict(h);
+    }
+    b.off = (uint16_t)h->wr;
+    memcpy(h->arena + h->wr, packed, len);
+    h->dir[(h->first_seq + h->n) % HIST_DIR_LEN] = b;
+    h->n++;
+    h->wr += len;
+    h->used += len;
+    h->sealed_samples += b.count;
+    h->count = 0;
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+/**
+ * @brief Append one sample (storage loop only).
+ *
+ * @param raw  Averaged ADC code, before conversion
+ */
+void hist_push(uint8_t ch_id, uint32_t index, int64_t t_us, int raw) {
+    if (ch_id >= HIST_CHANNELS) {
+        return;
+    }
+    hist_t *h = &hist[ch_id];
+
+    // Seal early if t = t0 + i * dt would no longer describe the block
+    if (h->count > 0) {
+        bool seal = h->count == HIST_BLOCK_LEN || index != h->first_index + h->count;
+        if (!seal && h->count > 1) {
+            int64_t dt = (h->tlast_us - h->t0_us) / (h->count - 1);
+            int64_t dev = (t_us - h->tlast_us) - dt;
+            seal = dev > dt / 2 || dev < -dt / 2;
+        }
+        if (seal) {
+            hist_seal(h);
+        }
+    }
+
+    portENTER_CRITICAL(&hist_lock);
+    if (h->count == 0) {
+        h->first_index = index;
+        h->t0_us = t_us;
+    }
+    h->raw[h->count++] = (uint16_t)raw;
+    h->tlast_us = t_us;
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+/**
+ * @brief Forget a channel's history.
+ */
+void hist_reset(uint8_t ch_id) {
+    if (ch_id >= HIST_CHANNELS) {
+        return;
+    }
+    portENTER_CRITICAL(&hist_lock);
+    hist_t *h = &hist[ch_id];
+    h->first_seq += h->n;
+    h->n = 0;
+    h->wr = 0;
+    h->used = 0;
+    h->sealed_samples = 0;
+    h->count = 0;
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+/**
+ * @brief Decode the samples captured in [from_us, to_us] and pass them to 'fn', oldest first.
+ *
+ * Blocks outside the range are skipped using the directory only.
+ *
+ * @return Samples delivered
+ */
+int hist_read(uint8_t ch_id, int64_t from_us, int64_t to_us, hist_sample_fn fn, void *ctx) {
+    const logger_channel_t *ch = logger_channel_by_id(ch_id);
+    if (ch_id >= HIST_CHANNELS || !ch) {
+        return 0;
+    }
+    hist_t *h = &hist[ch_id];
+
+    uint8_t packed[(HIST_BLOCK_LEN * 16 + 7) / 8];
+    uint16_t raw[HIST_BLOCK_LEN];
+    uint32_t seq = 0;
+    int delivered = 0;
+
+    while (1) {
+        hist_block_t b;
+        bool open = false;
+
+        portENTER_CRITICAL(&hist_lock);
+        if (seq < h->first_seq) {
+            seq = h->first_seq;   // evicted while we were decoding
+        }
+        // Skip blocks that end before the range
+        while (seq - h->first_seq < h->n) {
+            const hist_block_t *d = &h->dir[seq % HIST_DIR_LEN];
+            if (d->t0_us + (int64_t)d->dt_us * (d->count - 1) >= from_us) {
+                break;
+            }
+            seq++;
+        }
+        if (seq - h->first_seq < h->n) {
+            b = h->dir[seq % HIST_DIR_LEN];
+            if (b.t0_us <= to_us) {
+                memcpy(packed, h->arena + b.off, hist_packed_len(b.count, b.width));
+            }
+        } else {
+            // Past the sealed blocks: the open block, copied in the same critical section
+            open = true;
+            b = (hist_block_t){
+                .t0_us = h->t0_us,
+                .dt_us = h->count > 1 ? (uint32_t)((h->tlast_us - h->t0_us) / (h->count - 1)) : 0,
+                .first_index = h->first_index,
+                .count = (uint8_t)h->count,
+            };
+            memcpy(raw, h->raw, h->count * sizeof raw[0]);
+        }
+        portEXIT_CRITICAL(&hist_lock);
+
+        if (b.count == 0 || b.t0_us > to_us) {
+            break;
+        }
+        if (!open) {
+            hist_unpack(&b, packed, raw);
+        }
+        for (int i = 0; i < b.count; i++) {
+            int64_t t = b.t0_us + (int64_t)b.dt_us * i;
+            if (t < from_us) {
+                continue;
+            }
+            if (t > to_us) {
+                return delivered;
+            }
+            delivered++;
+            if (!fn(b.first_index + i, t, ch->convert(raw[i]), ctx)) {
+                return delivered;
+            }
+        }
+        if (open) {
+            break;
+        }
+        seq++;
+    }
+    return delivered;
+}
+
+/**
+ * @brief Report how many samples a channel holds and what they cost in RAM.
+ *
+ * @return false if the channel has no history
+ */
+bool hist_get_stats(uint8_t ch_id, hist_stats_t *out) {
+    if (ch_id >= HIST_CHANNELS) {
+        return false;
+    }
+    hist_t *h = &hist[ch_id];
+
+    portENTER_CRITICAL(&hist_lock);
+    out->samples = h->sealed_samples + h->count;
+    out->blocks = h->n;
+    out->bytes = h->used + h->n * sizeof(hist_block_t) + h->count * sizeof h->raw[0];
+    out->oldest_us = h->n ? h->dir[h->first_seq % HIST_DIR_LEN].t0_us : h->t0_us;
+    out->newest_us = h->tlast_us;
+    portEXIT_CRITICAL(&hist_lock);
+
+    out->footprint = sizeof *h;
+    return out->samples > 0;
+}
+
+/**
+ * @brief hist_sample_fn that only counts.
+ */
+static bool hist_count_fn(uint32_t index, int64_t t_us, float value, void *ctx) {
+    return true;
+}
+
+/**
+ * @brief Fill both histories with 'hours' of synthetic 1 Hz samples and report RAM per sample.
+ *
+ * The thermistor trace drifts slowly with +-2 codes of noise, the pot sits at
+ * a few positions (what the lab setups look like). Prints append and decode
+ * times and how many hours actually fit. Clears the histories afterwards.
+ */
+void hist_bench(int hours) {
+    const uint32_t n = (uint32_t)hours * 3600;
+    uint32_t rng = 1;
+
+    for (uint8_t id = 0; id < HIST_CHANNELS; id++) {
+        hist_reset(id);
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < n; i++) {
+        rng = rng * 1103515245u + 12345u;
+        int noise = (int)((rng >> 16) % 5) - 2;
+        int64_t t = (int64_t)i * 1000000;
+        hist_push(LOGGER_CH_ID_THERMISTOR, i, t, 2048 + (int)(i / 600) % 200 + noise);
+        hist_push(LOGGER_CH_ID_POT, i, t, 1000 * (int)((i / 1800) % 4) + noise / 2);
+    }
+    int64_t t_push = esp_timer_get_time() - t0;
+
+    printf("[*] history bench: %d h at 1 Hz, 2 channels, push %lld ns/sample\n",
+           hours, (long long)(t_push * 1000 / (2 * (int64_t)(n ? n : 1))));
+    for (uint8_t id = 0; id < HIST_CHANNELS; id++) {
+        hist_stats_t st;
+        if (!hist_get_stats(id, &st)) {
+            continue;
+        }
+        t0 = esp_timer_get_time();
+        int got = hist_read(id, st.newest_us - 3600 * 1000000LL, st.newest_us, hist_count_fn, NULL);
+        int64_t t_read = esp_timer_get_time() - t0;
+        printf("    %-10s: %u samples (%.1f h) in %u bytes = %.2f B/sample (CSV ~13), "
+               "last hour decoded in %lld us (%d samples)\n",
+               logger_channel_by_id(id)->name, (unsigned)st.samples,
+               (st.newest_us - st.oldest_us) / 3.6e9, (unsigned)st.bytes,
+               (double)st.bytes / st.samples, (long long)t_read, got);
+    }
+
+    for (uint8_t id = 0; id < HIST_CHANNELS; id++) {
+        hist_reset(id);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compressed in-RAM history: hours of samples per channel without PSRAM.
+// Raw ADC codes are stored in blocks of HIST_BLOCK_LEN samples as a first code
+// plus bit-packed zigzag deltas; a directory entry per block gives its time
+// and index range, so a time range can be decoded without touching the rest.
+#define HIST_BLOCK_LEN     128                 // samples per compressed block
+#define HIST_ARENA_BYTES   (12 * 1024)         // packed deltas per channel
+#define HIST_DIR_LEN       256                 // blocks per channel (directory entries)
+#define HIST_CHANNELS      2                   // indexed by LOGGER_CH_ID_*
+
+// Memory use of one channel's history
+typedef struct {
+    uint32_t samples;        // samples held (sealed blocks + the open one)
+    uint32_t blocks;         // sealed blocks
+    uint32_t bytes;          // packed data + directory entries in use
+    uint32_t footprint;      // static RAM reserved for the channel
+    int64_t  oldest_us;      // capture time of the oldest sample
+    int64_t  newest_us;
+} hist_stats_t;
+
+// Receives decoded samples, oldest first; return false to stop
+typedef bool (*hist_sample_fn)(uint32_t index, int64_t t_us, float value, void *ctx);
+
+void hist_push(uint8_t ch_id, uint32_t index, int64_t t_us, int raw);
+void hist_reset(uint8_t ch_id);
+int hist_read(uint8_t ch_id, int64_t from_us, int64_t to_us, hist_sample_fn fn, void *ctx);
+bool hist_get_stats(uint8_t ch_id, hist_stats_t *out);
+void hist_bench(int hours);
+
+#endif
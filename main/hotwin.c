@@ -0,0 +1,308 @@
+/**
+ * @file hotwin.c
+ * @brief Hot window: the most recent records of each channel, kept in RAM for reads.
+ *
+ * Reading "what happened in the last few minutes" used to mean fopen/fgets
+ * through SPIFFS (or mapping the raw log) for data the logger produced moments
+ * ago, competing with the logger for the flash. The storage loop now also
+ * pushes every stored record into a per-channel ring of HOTWIN_LEN records.
+ * Read APIs ask the ring first and only go to flash for rows older than the
+ * oldest one still in RAM; the latest value of a channel is an O(1) lookup.
+ *
+ * Like the tail ring in logger.c each ring has a single writer (the storage
+ * loop) and lock-free readers: the slot is written before 'head' is advanced,
+ * and a reader re-checks 'head' after copying to detect a slot that was reused
+ * meanwhile. 'gen' is odd while the ring is being switched to another file,
+ * so a reader that overlaps with that simply doesn't use RAM.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fs_helpers.h"
+#include "logger.h"
+#include "blocklog.h"
+#include "hotwin.h"
+
+typedef struct {
+    const logger_channel_t *ch;
+    char path[32];                 // file the records belong to, "" = none
+    uint32_t gen;                  // odd while begin/forget is changing the ring
+    uint32_t start;                // value of 'head' when the current file started
+    uint32_t head;                 // records ever pushed; record n lives in slot n % HOTWIN_LEN
+    logger_record_t ring[HOTWIN_LEN];
+} hotwin_t;
+
+static hotwin_t win[HOTWIN_CHANNELS];
+
+/**
+ * @brief Position of the oldest record of the current file still in the ring.
+ */
+static uint32_t hotwin_lo(const hotwin_t *w, uint32_t head) {
+    return head - w->start > HOTWIN_LEN ? head - HOTWIN_LEN : w->start;
+}
+
+/**
+ * @brief Change which file a ring belongs to ('path' NULL = none). Writer side only.
+ */
+static void hotwin_switch(hotwin_t *w, const logger_channel_t *ch, const char *path) {
+    __atomic_fetch_add(&w->gen, 1, __ATOMIC_ACQ_REL);   // odd: readers stay away
+    w->ch = ch;
+    snprintf(w->path, sizeof w->path, "%s", path ? path : "");
+    w->start = __atomic_load_n(&w->head, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->gen, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Find the ring holding records of 'path' (NULL if none does).
+ */
+static hotwin_t *hotwin_find(const char *path) {
+    for (int i = 0; i < HOTWIN_CHANNELS; i++) {
+        if (win[i].path[0] && strcmp(win[i].path, path) == 0) {
+            return &win[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start (or continue) collecting records of 'ch' written to 'path'.
+ *
+ * Called when a run opens its sink. A run that continues the previous one of
+ * the same channel (raw log, indices picking up where they stopped) keeps the
+ * window; otherwise it is emptied, since a CSV file was just rewritten from
+ * row 0. Any other ring holding 'path' is dropped: its rows are gone.
+ */
+void hotwin_begin(const logger_channel_t *ch, const char *path, uint32_t first_index) {
+    if (ch->id >= HOTWIN_CHANNELS) {
+        return;
+    }
+    hotwin_t *w = &win[ch->id];
+
+    for (int i = 0; i < HOTWIN_CHANNELS; i++) {
+        if (&win[i] != w && strcmp(win[i].path, path) == 0) {
+            hotwin_switch(&win[i], NULL, NULL);
+        }
+    }
+
+    uint32_t head = w->head;
+    bool continues = strcmp(w->path, path) == 0 && head != w->start &&
+                     w->ring[(head - 1) % HOTWIN_LEN].seq + 1 == first_index;
+    if (!continues) {
+        hotwin_switch(w, ch, path);
+    }
+}
+
+/**
+ * @brief Add one stored record to its channel's ring. Storage loop only.
+ */
+void hotwin_push(uint8_t ch_id, uint32_t index, int64_t t_us, float value, uint16_t raw) {
+    if (ch_id >= HOTWIN_CHANNELS) {
+        return;
+    }
+    hotwin_t *w = &win[ch_id];
+    uint32_t head = __atomic_load_n(&w->head, __ATOMIC_RELAXED);
+    logger_record_t *r = &w->ring[head % HOTWIN_LEN];
+    r->ch = ch_id;
+    r->seq = index;
+    r->t_us = t_us;
+    r->value = value;
+    r->raw = raw;
+    __atomic_store_n(&w->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Drop the window of 'path' after the file was deleted or erased.
+ */
+void hotwin_forget(const char *path) {
+    hotwin_t *w = hotwin_find(path);
+    if (w) {
+        hotwin_switch(w, NULL, NULL);
+    }
+}
+
+/**
+ * @brief Most recent record of a channel, without touching flash.
+ *
+ * @return false if nothing was logged on that channel since boot
+ */
+bool hotwin_latest(uint8_t ch_id, logger_record_t *out) {
+    if (ch_id >= HOTWIN_CHANNELS) {
+        return false;
+    }
+    hotwin_t *w = &win[ch_id];
+    while (1) {
+        uint32_t gen = __atomic_load_n(&w->gen, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+        if ((gen & 1) || head == w->start) {
+            return false;
+        }
+        *out = w->ring[(head - 1) % HOTWIN_LEN];
+
+        // Slot reused or ring switched while copying: try again with the new head
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&w->head, __ATOMIC_ACQUIRE) - (head - 1) <= HOTWIN_LEN - 1 &&
+            __atomic_load_n(&w->gen, __ATOMIC_ACQUIRE) == gen) {
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Describe what a channel's window holds (for 'stats').
+ */
+bool hotwin_get_info(uint8_t ch_id, hotwin_info_t *out) {
+    logger_record_t newest;
+    if (!hotwin_latest(ch_id, &newest)) {
+        return false;
+    }
+    hotwin_t *w = &win[ch_id];
+    uint32_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+    uint32_t lo = hotwin_lo(w, head);
+    if (head - lo == HOTWIN_LEN) {
+        lo++;   // the writer fills this slot next
+    }
+    logger_record_t oldest = w->ring[lo % HOTWIN_LEN];
+    out->path = w->path;
+    out->first = oldest.seq;
+    out->next = newest.seq + 1;
+    out->span_us = newest.t_us - oldest.t_us;
+    return true;
+}
+
+/**
+ * @brief Copy up to 'max' records of 'path' with index >= 'from', oldest first.
+ *
+ * '*oldest' receives the index of the oldest record of 'path' still in RAM;
+ * rows before it have to come from flash.
+ *
+ * @return Records copied, or -1 if 'path' has no window (read everything from flash)
+ */
+int hotwin_read(const char *path, uint32_t from, logger_record_t *out, int max, uint32_t *oldest) {
+    hotwin_t *w = hotwin_find(path);
+    if (!w) {
+        return -1;
+    }
+    uint32_t gen = __atomic_load_n(&w->gen, __ATOMIC_ACQUIRE);
+    if (gen & 1) {
+        return -1;
+    }
+
+    uint32_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+    uint32_t lo = hotwin_lo(w, head);
+    if (lo == head) {
+        return -1;
+    }
+    // Leave out the slot the writer may be filling right now
+    if (head - lo == HOTWIN_LEN) {
+        lo++;
+    }
+    *oldest = w->ring[lo % HOTWIN_LEN].seq;
+
+    // Indices only grow, so binary search for the first one >= from
+    uint32_t a = lo, b = head;
+    while (a < b) {
+        uint32_t mid = a + (b - a) / 2;
+        if (w->ring[mid % HOTWIN_LEN].seq < from) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+
+    int n = 0;
+    for (uint32_t pos = a; pos != head && n < max; pos++) {
+        out[n] = w->ring[pos % HOTWIN_LEN];
+
+        // The writer may have reused the slot while we were copying it
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t now = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+        if (now - pos > HOTWIN_LEN - 1) {
+            *oldest = out[n].seq + 1;   // lapped: this and older rows are flash-only now
+            n = 0;
+            continue;
+        }
+        n++;
+    }
+
+    if (__atomic_load_n(&w->gen, __ATOMIC_ACQUIRE) != gen) {
+        return -1;
+    }
+    return n;
+}
+
+/**
+ * @brief blocklog_write_fn printing to stdout (small raw log ranges before the window).
+ */
+static void hotwin_stdout_write(const void *data, size_t len, void *ctx) {
+    fwrite(data, 1, len, stdout);
+}
+
+/**
+ * @brief Print data rows [first, first + count) of 'path' without the header, from flash.
+ */
+static void hotwin_print_flash(const char *path, uint32_t first, uint32_t count) {
+    if (strcmp(path, RAWLOG_PATH) == 0) {
+        blocklog_export_range(first, count, hotwin_stdout_write, NULL);
+    } else {
+        fs_print_rows(path, (int)first, (int)(count > INT32_MAX - first ? INT32_MAX - first : count));
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Print the header plus rows [first, first + count) of 'path', RAM first.
+ *
+ * Same output as fs_print_range()/blocklog_print_range(), but rows still in
+ * the hot window are formatted from RAM; flash is only read for the part of
+ * the range that is older than the window (or for files with no window).
+ */
+void hotwin_print_range(const char *path, uint32_t first, uint32_t count) {
+    // Look the ring up once and take its channel under the generation check:
+    // begin/forget may be switching it to another file right now
+    hotwin_t *w = hotwin_find(path);
+    const logger_channel_t *ch = NULL;
+    if (w) {
+        uint32_t gen = __atomic_load_n(&w->gen, __ATOMIC_ACQUIRE);
+        ch = w->ch;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((gen & 1) || __atomic_load_n(&w->gen, __ATOMIC_ACQUIRE) != gen) {
+            ch = NULL;
+        }
+    }
+    if (!ch) {
+        if (strcmp(path, RAWLOG_PATH) == 0) {
+            blocklog_print_range(first, count);
+        } else {
+            fs_print_range(path, (int)first, (int)count);
+        }
+        return;
+    }
+
+    uint32_t end = count > UINT32_MAX - first ? UINT32_MAX : first + count;
+    uint32_t next = first;
+    logger_record_t recs[16];
+
+    printf("%s\n", ch->csv_header);
+    while (next < end) {
+        uint32_t oldest;
+        int n = hotwin_read(path, next, recs, 16, &oldest);
+        if (n < 0) {
+            hotwin_print_flash(path, next, end - next);   // window went away meanwhile
+            break;
+        }
+        if (next < oldest) {
+            uint32_t stop = oldest < end ? oldest : end;
+            hotwin_print_flash(path, next, stop - next);
+            next = stop;
+            continue;
+        }
+        if (n == 0) {
+            break;   // nothing newer than 'next' yet
+        }
+        for (int i = 0; i < n && recs[i].seq < end; i++) {
+            printf(ch->row_fmt, (int)recs[i].seq, logger_record_value(ch, &recs[i]));
+        }
+        next = recs[n - 1].seq + 1;
+    }
+    fflush(stdout);
+}
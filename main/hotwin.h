@@ -0,0 +1,34 @@
+#ifndef HOTWIN_H
+#define HOTWIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "logger.h"
+
+// Hot window: the most recent records of every channel kept in RAM, so reads of
+// recent data never touch the flash. One ring per channel, each remembering the
+// file (or RAWLOG_PATH) its records belong to.
+#define HOTWIN_MINUTES   10                  // window length at the nominal rate below
+#define HOTWIN_LEN       1024                // records per channel (power of two): 10 min at ~1.7 samples/s
+#define HOTWIN_CHANNELS  2                   // one ring per built-in channel (indexed by LOGGER_CH_ID_*)
+
+// What a channel's ring currently holds
+typedef struct {
+    const char *path;        // file the records belong to, NULL = empty
+    uint32_t first;          // oldest index still in RAM
+    uint32_t next;           // index after the newest one
+    int64_t  span_us;        // time covered (newest - oldest capture time)
+} hotwin_info_t;
+
+// Writer side (logger storage loop only)
+void hotwin_begin(const logger_channel_t *ch, const char *path, uint32_t first_index);
+void hotwin_push(uint8_t ch_id, uint32_t index, int64_t t_us, float value, uint16_t raw);
+void hotwin_forget(const char *path);
+
+// Readers: RAM first, flash only for rows older than the window
+bool hotwin_latest(uint8_t ch_id, logger_record_t *out);
+bool hotwin_get_info(uint8_t ch_id, hotwin_info_t *out);
+int hotwin_read(const char *path, uint32_t from, logger_record_t *out, int max, uint32_t *oldest);
+void hotwin_print_range(const char *path, uint32_t first, uint32_t count);
+
+#endif
@@ -0,0 +1,1729 @@
+/**
+ * @file logger.c
+ * @brief Shared logging core used by the potentiometer and thermistor loggers.
+ *
+ * A logging run is split into two stages so that slow flash writes never
+ * delay the next ADC reading:
+ *
+ *   timer ISR (ADC capture)  --(RAM ring of raw samples)-->  storage (caller's task)
+ *
+ * Acquisition happens in a gptimer alarm ISR, so the sample period is not
+ * limited by the FreeRTOS tick (10 ms at CONFIG_FREERTOS_HZ=100). Everything
+ * the ISR touches is cache-safe: the ISR and adc_read_avg_isr() are in IRAM,
+ * its state and the ring are in DRAM, and the gptimer/ADC drivers are built
+ * with CONFIG_GPTIMER_ISR_IRAM_SAFE and CONFIG_ADC_ONESHOT_CTRL_FUNC_IN_IRAM.
+ * SPIFFS erase/program operations disable the flash cache on both cores, but
+ * the ISR keeps firing on time during them; only the storage side, which
+ * does the float conversion and formatting, waits for the cache.
+ *
+ * The storage side converts each raw code, formats the CSV row into a RAM
+ * write-behind buffer and writes that buffer to SPIFFS one block at a time.
+ * In lazy mode (logger_set_lazy()) CSV files get the raw code instead, plus a
+ * first line with the conversion parameters, raw log blocks get the codes
+ * packed 12 bits each, and the float math moves to export time
+ * (logger_convert_batch()).
+ *
+ * One run can sample several channels at independent rates
+ * (logger_run_multi()): the timer ticks at the greatest common divisor of
+ * their periods, the ISR reads the channels that are due, and the storage
+ * loop hands each sample to its channel's own file.
+ *
+ * In scope mode (scope.c) only the samples around trigger events are kept;
+ * the rest are dropped before they reach the write-behind buffer. Lossy
+ * compression (lossy.c) drops the rows of a CSV file that can be rebuilt from
+ * their neighbours within a given error; readers still see every sample.
+ * In spectrum mode (spectrum.c) the samples only feed an FFT and the file gets
+ * one row of amplitudes or band powers per block instead. With noise-adaptive
+ * averaging (noise.c) the storage loop sets each channel's ADC read count from
+ * the spread of the reads of its previous samples.
+ *
+ * Acquired samples reach their consumers over a publish/subscribe bus
+ * (bus.c): the ISR publishes each block of samples once, and the storage
+ * loop, the running statistics (a task of their own) and live readouts
+ * (logger_watch()) each read it in place at their own pace.
+ *
+ * Every stored record is also published to a small "tail" ring. Live readers
+ * (logger_tail()) follow it with their own cursor, so they can stream data
+ * while the file is still open for writing, and a slow reader only loses
+ * its own records instead of stalling the logger.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gptimer.h"
+#include "nvs.h"
+#include "fs_helpers.h"
+#include "logger.h"
+#include "blocklog.h"
+#include "hotwin.h"
+#include "hist.h"
+#include "blkcache.h"
+#include "compact.h"
+#include "scope.h"
+#include "adapt.h"
+#include "lossy.h"
+#include "chstats.h"
+#include "spectrum.h"
+#include "noise.h"
+#include "pool.h"
+#include "bus.h"
+#include "heapaudit.h"
+
+// Tag used for ESP_LOG macros to identify logs from this file
+static const char *TAG = "LOGGER";
+
+// Largest formatted row we expect; a block is written once less than this is free
+#define LOGGER_MAX_ROW    48
+
+// One raw reading handed from acquisition to storage
+typedef struct {
+    uint32_t seq;     // sample index within the run
+    int64_t  t_us;    // capture time (esp_timer)
+    int      raw;     // averaged ADC code
+    uint8_t  lane;    // channel of the run it belongs to
+    uint8_t  ch;      // LOGGER_CH_ID_* of that channel
+    uint8_t  reads;   // ADC reads averaged into 'raw'
+    uint32_t m2;      // their sum of squared deviations (noise-adaptive averaging)
+} logger_sample_t;
+
+// Samples travel from the ISR to storage in blocks from a fixed pool
+typedef struct {
+    bus_hdr_t h;
+    uint32_t n;                                 // samples filled in
+    logger_sample_t s[LOGGER_ACQ_BLOCK_LEN];
+} logger_acq_blk_t;
+
+// Schedule of one channel in the timer ISR
+typedef struct {
+    adc_channel_t channel;
+    uint8_t ch_id;
+    int oversample;             // reads per sample; the storage loop may change it during a run
+    uint32_t every;             // ticks between two samples
+    uint32_t countdown;         // ticks until the next sample
+    int32_t remaining;          // samples still to take; < 0 = until stopped
+    uint32_t seq;               // index of the next sample
+} logger_acq_lane_t;
+
+// Acquisition state used by the timer ISR. Plain copies of the channel
+// settings live here because the channel descriptions are const data in
+// flash, which the ISR must not touch while the cache is disabled.
+typedef struct {
+    logger_acq_lane_t lane[LOGGER_LANES_MAX];
+    uint32_t n_lanes;
+    uint32_t active;            // lanes with samples still to take
+    uint32_t ticks;             // timer alarms so far
+    uint32_t notify_every;      // wake storage once per this many ticks
+    uint32_t tick_us;           // current alarm period
+    TaskHandle_t storage;       // task running logger_run_multi()
+    logger_acq_blk_t *fill;     // block the ISR is filling (ISR only)
+    volatile bool stop;         // storage asks the ISR to hand over its block and finish
+    volatile bool done;         // all samples taken
+    // Scheduler cost, measured inside the ISR
+    uint32_t idle_max_us;       // slowest tick with nothing due (pure bookkeeping)
+    uint32_t busy_max_us;       // slowest tick with ADC reads
+    uint64_t busy_sum_us;
+    uint32_t busy_ticks;
+    uint32_t coalesced;         // ticks on which more than one channel was read
+} logger_acq_t;
+
+static DRAM_ATTR logger_acq_t acq;
+
+// ISR -> consumers without copies: the ISR writes each sample once, into a
+// block from the pool, and publishes full blocks on the bus as pointers. Every
+// subscriber works on the samples in place; the last one done returns the
+// block to the pool. Storage is a lossless subscriber: while it is a full
+// ring behind, the ISR keeps its full block and drops new samples.
+static DRAM_ATTR uint8_t acq_blk_mem[LOGGER_ACQ_BLOCKS * sizeof(logger_acq_blk_t)] __attribute__((aligned(8)));
+static DRAM_ATTR pool_t acq_pool;
+static DRAM_ATTR bus_hdr_t *acq_ring[LOGGER_BUS_LEN];
+static DRAM_ATTR bus_t acq_bus;
+static DRAM_ATTR bus_sub_t store_sub;
+static volatile uint32_t acq_dropped = 0;
+
+// Running statistics (chstats.c) read the bus from a task of their own
+static bus_sub_t stats_sub;
+static TaskHandle_t stats_task = NULL;
+static volatile bool stats_attached = false;
+static bus_stats_t bus_last;                // subscribers of the last run, as it ended
+
+static logger_stats_t stats;
+
+// Durations of the last LOGGER_LAT_WINDOW block writes (for percentiles)
+static uint32_t write_lat[LOGGER_LAT_WINDOW];
+static uint32_t write_lat_n = 0;
+
+// Background run started by logger_start_multi()
+typedef struct {
+    logger_lane_t lanes[LOGGER_LANES_MAX];
+    char paths[LOGGER_LANES_MAX][32];
+    int n;
+} logger_job_t;
+
+// What logger_resume() restarts after a reboot (NVS key "run")
+typedef struct {
+    uint8_t  active;
+    uint8_t  channel;
+    uint32_t period_us;
+} logger_resume_t;
+
+static logger_job_t job;
+static TaskHandle_t job_task = NULL;
+static volatile bool stop_requested = false;
+
+// New sample period requested by logger_set_period(), 0 = none pending.
+// Applied by the storage loop, which owns the timer.
+static volatile uint32_t pending_period_us = 0;
+
+// Channel of the run currently publishing to the tail ring (the first one of a multi-rate run)
+static const logger_channel_t *volatile active_ch = NULL;
+static const logger_channel_t *active_lanes[LOGGER_LANES_MAX];
+static volatile uint32_t active_n = 0;
+
+// Files written by the current run ("" = none); set before the files are opened
+static char active_path[LOGGER_LANES_MAX][32];
+
+// Store raw codes in CSV files and convert on export (takes effect at the next run)
+static volatile bool lazy_mode = false;
+
+// Tail ring: the last LOGGER_TAIL_LEN stored records. 'tail_head' counts every
+// record ever published, so a record lives in slot (n % LOGGER_TAIL_LEN) until
+// it is overwritten LOGGER_TAIL_LEN records later.
+static logger_record_t tail_ring[LOGGER_TAIL_LEN];
+static uint32_t tail_head = 0;
+
+// Write-behind buffers, one per channel of a run (static so a large block does
+// not live on the caller's stack)
+static char wb[LOGGER_LANES_MAX][LOGGER_BLOCK_SIZE];
+
+const logger_channel_t LOGGER_CH_POT = {
+    .id         = LOGGER_CH_ID_POT,
+    .name       = "pot",
+    .channel    = ADC_CH_POT,
+    .oversample = SAMPLES,
+    .csv_header = "index,voltage_V",
+    .row_fmt    = "#%d, %.3fV\n",
+    .convert    = logger_pot_to_volts,
+};
+
+const logger_channel_t LOGGER_CH_THERMISTOR = {
+    .id         = LOGGER_CH_ID_THERMISTOR,
+    .name       = "thermistor",
+    .channel    = ADC_CH_THERMISTOR,
+    .oversample = SAMPLES,
+    .csv_header = "index,temperature_C",
+    .row_fmt    = "#%d, %.2f°C\n",
+    .convert    = logger_thermistor_to_celsius,
+};
+
+/**
+ * @brief Look up a built-in channel by its id (as stored in raw log blocks).
+ *
+ * @return Channel description, or NULL for an unknown id
+ */
+const logger_channel_t *logger_channel_by_id(uint8_t id) {
+    switch (id) {
+    case LOGGER_CH_ID_POT:        return &LOGGER_CH_POT;
+    case LOGGER_CH_ID_THERMISTOR: return &LOGGER_CH_THERMISTOR;
+    default:                      return NULL;
+    }
+}
+
+logger_conv_t logger_conv = {
+    .vin     = 3.3f,        // Supply voltage
+    .r_fixed = 10000.0f,    // 10k series resistor
+    .r0      = 10000.0f,    // Thermistor resistance at 25°C
+    .t0_c    = 25.0f,
+    .beta    = 3950.0f,     // Beta coefficient
+    .gain    = 1.0f,        // uncalibrated
+    .offset  = 0.0f,
+};
+
+/**
+ * @brief Convert a raw potentiometer reading to the wiper voltage.
+ */
+float logger_pot_to_volts(int raw) {
+    uint16_t r = (uint16_t)raw;
+    float v;
+    logger_convert_batch(&LOGGER_CH_POT, &logger_conv, &r, &v, 1);
+    return v;
+}
+
+/**
+ * @brief Convert a raw thermistor reading to °C using the Beta equation.
+ */
+float logger_thermistor_to_celsius(int raw) {
+    uint16_t r = (uint16_t)raw;
+    float t;
+    logger_convert_batch(&LOGGER_CH_THERMISTOR, &logger_conv, &r, &t, 1);
+    return t;
+}
+
+/**
+ * @brief Convert n raw codes of one channel with explicit parameters.
+ *
+ * Everything that doesn't depend on the sample (scale, 1/B, 1/T0, ...) is
+ * computed once per batch, leaving a multiply-add for the pot and one
+ * divide + logf per thermistor sample. The ESP32-S3 FPU has no SIMD float
+ * path, so batching is what "vectorized" buys here: no per-sample parameter
+ * loads or function pointer calls, and a loop the compiler can pipeline.
+ */
+void logger_convert_batch(const logger_channel_t *ch, const logger_conv_t *conv, const uint16_t *raw, float *out, int n) {
+    // Calibrated voltage: V = gain * raw * Vin / ADC_MAX + offset
+    const float scale = conv->gain * conv->vin / (float)ADC_MAX;
+    const float offset = conv->offset;
+
+    if (ch->id != LOGGER_CH_ID_THERMISTOR) {
+        for (int i = 0; i < n; i++) {
+            out[i] = (float)raw[i] * scale + offset;
+        }
+        return;
+    }
+
+    // Divider: Vin -> R_fixed -> node(VRT) -> Thermistor -> GND, so RT = R_fixed * VRT / (Vin - VRT)
+    // Beta equation: 1/T = 1/T0 + (1/B)*ln(RT/R0)
+    const float vin = conv->vin;
+    const float rf_over_r0 = conv->r_fixed / conv->r0;
+    const float inv_t0 = 1.0f / (conv->t0_c + 273.15f);
+    const float inv_b = 1.0f / conv->beta;
+    for (int i = 0; i < n; i++) {
+        float vrt = (float)raw[i] * scale + offset;
+        float rt_over_r0 = rf_over_r0 * vrt / (vin - vrt);
+        out[i] = 1.0f / (inv_t0 + logf(rt_over_r0) * inv_b) - 273.15f;   // Convert to Celsius
+    }
+}
+
+/**
+ * @brief Value of a tail/hot-window record, converting it now if it was stored lazily.
+ */
+float logger_record_value(const logger_channel_t *ch, const logger_record_t *r) {
+    return isnan(r->value) ? ch->convert(r->raw) : r->value;
+}
+
+/**
+ * @brief Format the first line of a lazy file (tag, channel and conversion parameters).
+ *
+ * @return Length as snprintf()
+ */
+int logger_conv_format(const logger_channel_t *ch, const logger_conv_t *conv, char *buf, size_t len) {
+    // %.9g round-trips a float exactly
+    return snprintf(buf, len, "%s %s vin=%.9g r_fixed=%.9g r0=%.9g t0=%.9g beta=%.9g gain=%.9g offset=%.9g\n",
+                    LOGGER_LAZY_TAG, ch->name, conv->vin, conv->r_fixed, conv->r0, conv->t0_c, conv->beta,
+                    conv->gain, conv->offset);
+}
+
+/**
+ * @brief Parse the first line of a lazy file.
+ *
+ * @return Channel that wrote the file, or NULL if 'line' is not a lazy file header
+ */
+const logger_channel_t *logger_conv_parse(const char *line, logger_conv_t *conv) {
+    char name[16];
+    if (strncmp(line, LOGGER_LAZY_TAG " ", sizeof LOGGER_LAZY_TAG) != 0 ||
+        sscanf(line + sizeof LOGGER_LAZY_TAG, "%15s vin=%f r_fixed=%f r0=%f t0=%f beta=%f gain=%f offset=%f",
+               name, &conv->vin, &conv->r_fixed, &conv->r0, &conv->t0_c, &conv->beta,
+               &conv->gain, &conv->offset) != 8) {
+        return NULL;
+    }
+    for (uint8_t id = 0; logger_channel_by_id(id); id++) {
+        if (strcmp(name, logger_channel_by_id(id)->name) == 0) {
+            return logger_channel_by_id(id);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Re-convert a lazy file: replace its parameters with the current 'logger_conv'.
+ *
+ * Only the first line changes, the raw codes stay as they are; the file is
+ * copied to a temporary one and renamed over the original, since SPIFFS can't
+ * rewrite a line in place when its length changes.
+ *
+ * @return ESP_ERR_INVALID_STATE while the file is being logged,
+ *         ESP_ERR_NOT_SUPPORTED if it is not a lazy file
+ */
+esp_err_t logger_recalibrate(const char *path) {
+    if (logger_is_writing(path)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    char line[LOGGER_CONV_LINE_MAX];
+    logger_conv_t old;
+    const logger_channel_t *ch = fgets(line, sizeof line, in) ? logger_conv_parse(line, &old) : NULL;
+    if (!ch) {
+        fclose(in);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    char tmp_path[40];
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fclose(in);
+        return ESP_FAIL;
+    }
+    logger_conv_format(ch, &logger_conv, line, sizeof line);
+    bool ok = fputs(line, out) >= 0;
+    char buf[256];
+    size_t n;
+    while (ok && (n = fread(buf, 1, sizeof buf, in)) > 0) {
+        ok = fwrite(buf, 1, n, out) == n;
+    }
+    fclose(in);
+    ok = fclose(out) == 0 && ok;
+
+    if (!ok || remove(path) != 0 || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return ESP_FAIL;
+    }
+    blkcache_invalidate(path, 0);
+    hotwin_forget(path);
+    return ESP_OK;
+}
+
+/**
+ * @brief Timer alarm ISR: take the samples that are due and put them in the ring.
+ *
+ * The timer ticks at the greatest common divisor of the channels' periods
+ * (for a single channel: its period); every channel counts down its own
+ * number of ticks. Channels that fall due on the same tick are read back to
+ * back within this one interrupt and share its capture time and wake-up.
+ *
+ * Runs from IRAM and only touches DRAM, so it is not delayed by flash
+ * operations. Never waits for storage: if no sample block is free, or the
+ * bus refuses the full one because storage is a whole ring behind, the
+ * sample is counted as dropped. The work per tick is bounded: at most
+ * LOGGER_LANES_MAX countdowns and reads, no loops over the ring.
+ */
+static void IRAM_ATTR logger_acq_pass(BaseType_t *woken) {
+    logger_acq_blk_t *b = acq.fill;
+    if (b && b->n > 0 && bus_publish(&acq_bus, &b->h, woken)) {
+        acq.fill = NULL;
+    }
+}
+
+static bool IRAM_ATTR logger_timer_isr(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *arg) {
+    if (acq.active == 0) {
+        return false;
+    }
+    BaseType_t woken = pdFALSE;
+    if (acq.stop) {
+        // Stop requested: hand over the last samples, take no more
+        logger_acq_pass(&woken);
+        acq.active = 0;
+        acq.done = true;
+        vTaskNotifyGiveFromISR(acq.storage, &woken);
+        return woken == pdTRUE;
+    }
+    int64_t t0 = esp_timer_get_time();
+    uint32_t reads = 0;
+    bool full = false;
+
+    for (uint32_t i = 0; i < acq.n_lanes; i++) {
+        logger_acq_lane_t *l = &acq.lane[i];
+        if (l->remaining == 0 || --l->countdown != 0) {
+            continue;
+        }
+        l->countdown = l->every;
+
+        if (acq.fill && acq.fill->n == LOGGER_ACQ_BLOCK_LEN) {
+            logger_acq_pass(&woken);        // refused before: storage was a full ring behind
+        }
+        if (!acq.fill && (acq.fill = pool_alloc(&acq_pool)) != NULL) {
+            acq.fill->n = 0;
+        }
+        logger_acq_blk_t *b = acq.fill;
+        if (b && b->n < LOGGER_ACQ_BLOCK_LEN) {
+            logger_sample_t *s = &b->s[b->n++];
+            s->seq = l->seq;
+            s->t_us = t0;
+            s->lane = (uint8_t)i;
+            s->ch = l->ch_id;
+            int k = l->oversample;
+            s->raw = adc_read_avg_isr(l->channel, k, &s->m2);
+            s->reads = (uint8_t)k;
+            if (b->n == LOGGER_ACQ_BLOCK_LEN) {
+                logger_acq_pass(&woken);
+                full = true;
+            }
+        } else {
+            acq_dropped++;
+        }
+        l->seq++;
+        reads++;
+        if (l->remaining > 0 && --l->remaining == 0) {
+            acq.active--;
+        }
+    }
+
+    // Cost of this tick: bookkeeping only, or bookkeeping plus the reads
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    if (reads == 0) {
+        acq.idle_max_us = dt > acq.idle_max_us ? dt : acq.idle_max_us;
+    } else {
+        acq.busy_max_us = dt > acq.busy_max_us ? dt : acq.busy_max_us;
+        acq.busy_sum_us += dt;
+        acq.busy_ticks++;
+        acq.coalesced += reads > 1;
+    }
+
+    if (acq.active == 0) {
+        logger_acq_pass(&woken);
+        acq.done = true;
+        vTaskNotifyGiveFromISR(acq.storage, &woken);
+    } else if (++acq.ticks % acq.notify_every == 0 || full) {
+        // A partly filled block only goes out while storage has caught up; while
+        // it is stalled the blocks fill up completely, so the pool holds
+        // LOGGER_ACQ_LEN samples however slow the rate is
+        if (acq_bus.head == store_sub.cursor) {
+            logger_acq_pass(&woken);
+        }
+        vTaskNotifyGiveFromISR(acq.storage, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief Program the alarm for a new tick (timer counts microseconds).
+ */
+static void logger_timer_period(gptimer_handle_t timer, uint32_t tick_us) {
+    gptimer_alarm_config_t alarm = {
+        .alarm_count = tick_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    gptimer_set_alarm_action(timer, &alarm);
+    acq.tick_us = tick_us;
+
+    // Wake storage roughly every 10 ms, but at least once per quarter ring
+    uint32_t n = 10000 / tick_us;
+    uint32_t max = LOGGER_ACQ_LEN / 4 / acq.n_lanes;
+    acq.notify_every = n < 1 ? 1 : (n > max ? max : n);
+}
+
+/**
+ * @brief Feed the running statistics from the bus, off the storage loop.
+ *
+ * Woken by the ISR on every published block; converts each sample and pushes
+ * it to chstats. A lossless subscriber, so no sample is left out, but it
+ * holds up acquisition if it falls a full ring behind.
+ */
+static void logger_stats_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bus_hdr_t *h;
+        while (stats_attached && (h = bus_next(&acq_bus, &stats_sub)) != NULL) {
+            const logger_acq_blk_t *b = (const logger_acq_blk_t *)h;
+            for (uint32_t i = 0; i < b->n; i++) {
+                const logger_channel_t *ch = logger_channel_by_id(b->s[i].ch);
+                if (ch) {
+                    chstats_push(b->s[i].ch, b->s[i].t_us, ch->convert(b->s[i].raw));
+                }
+            }
+            bus_release(&acq_bus, &stats_sub, h);
+        }
+    }
+}
+
+/**
+ * @brief End of a run: give the statistics a moment to catch up, then close the bus.
+ *
+ * Closing detaches every subscriber (readers such as logger_watch() see
+ * bus_next() return NULL and stop); blocks they still hold go back to the
+ * pool as they release them. The next run waits for that before it sets the
+ * pool up again (logger_pool_idle()).
+ */
+static void logger_bus_close(void) {
+    for (int i = 0; i < 50 && stats_attached && bus_lag(&acq_bus, &stats_sub) > 0; i++) {
+        xTaskNotifyGive(stats_task);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    bus_get_stats(&acq_bus, &bus_last);
+    stats_attached = false;
+    bus_close(&acq_bus);
+}
+
+/**
+ * @brief Wait until every sample block of the last run is back in the pool.
+ *
+ * @return false if a reader still holds one after LOGGER_POOL_WAIT_MS
+ */
+static bool logger_pool_idle(void) {
+    for (int i = 0; i < LOGGER_POOL_WAIT_MS / 10 && __atomic_load_n(&acq_pool.in_use, __ATOMIC_ACQUIRE) > 0; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return __atomic_load_n(&acq_pool.in_use, __ATOMIC_ACQUIRE) == 0;
+}
+
+/**
+ * @brief Make a stored record visible to tail readers.
+ *
+ * Only the storage loop calls this, so there is a single writer. The slot is
+ * filled first and the head is advanced afterwards with release ordering, so a
+ * reader that sees the new head also sees the record.
+ */
+static void logger_publish(uint8_t ch_id, uint32_t seq, int64_t t_us, float value, uint16_t raw) {
+    uint32_t head = __atomic_load_n(&tail_head, __ATOMIC_RELAXED);
+    logger_record_t *r = &tail_ring[head % LOGGER_TAIL_LEN];
+    r->ch = ch_id;
+    r->seq = seq;
+    r->t_us = t_us;
+    r->value = value;
+    r->raw = raw;
+    __atomic_store_n(&tail_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Where committed blocks go: a CSV file on SPIFFS or the raw block log.
+ */
+typedef struct {
+    FILE *f;              // open CSV file, or NULL when writing to the raw log
+    const char *path;     // CSV file path (for read cache invalidation)
+    uint32_t size;        // CSV file size so far
+    bool lazy;            // store raw codes (logger_set_lazy()): text rows in a CSV file, packed in the raw log
+    size_t row_max;       // most bytes one row can take in 'wb'
+    const logger_channel_t *ch;
+    blocklog_hdr_t hdr;   // raw log: header of the block being filled
+    blocklog_stamps_t stamps;   // raw log: capture times of the block being filled
+    uint32_t period_us;   // nominal sample period (for the implicit timestamps)
+    uint16_t raw_min;     // packed raw log block: zone map in raw codes, converted on commit
+    uint16_t raw_max;
+    uint32_t base;        // index of the run's first row (raw log runs continue the log's numbering)
+    lossy_state_t lossy;  // CSV file: deadband/SDT compression before storage (mode LOSSY_OFF = every row)
+    int64_t now_us;       // capture time of the sample being kept (for rows lossy.c stores late)
+    size_t cap;           // usable bytes of 'wb' for this sink
+    size_t len;           // bytes waiting in the write-behind buffer
+    int64_t oldest_us;    // capture time of the oldest buffered row
+    char *wb;             // write-behind buffer of this sink (LOGGER_BLOCK_SIZE bytes)
+} logger_out_t;
+
+/**
+ * @brief Open the storage sink for a run and write the CSV header if needed.
+ *
+ * @return true on success
+ */
+static bool logger_open(logger_out_t *out, const logger_channel_t *ch, const char *path, char *buf) {
+    memset(out, 0, sizeof *out);
+    out->ch = ch;
+    out->wb = buf;
+    out->lazy = lazy_mode;
+    out->row_max = LOGGER_MAX_ROW;
+    lossy_begin(&out->lossy, ch->id);
+
+    if (strcmp(path, RAWLOG_PATH) == 0) {
+        if (out->lossy.cfg.mode != LOSSY_OFF) {
+            // Raw log blocks hold contiguous rows (their timestamps and packed codes rely on it)
+            printf("[-] lossy compression applies to CSV files only, storing every row\n");
+            out->lossy.cfg.mode = LOSSY_OFF;
+        }
+        if (blocklog_init() != ESP_OK) {
+            return false;
+        }
+        out->base = blocklog_next_index();
+        out->hdr.first_index = out->base;
+        out->hdr.channel = ch->id;
+        out->hdr.codec = out->lazy ? BLOCKLOG_CODEC_PACK12 : BLOCKLOG_CODEC_CSV;
+        out->cap = BLOCKLOG_PAYLOAD_MAX;
+        if (out->lazy) {
+            out->row_max = 2;   // a code takes 1.5 bytes: 2 or 1 depending on its position
+        }
+        return true;
+    }
+
+    fs_forget(path);            // older cached or compacted copies of this log are obsolete now
+    out->f = fopen(path, "w");  // write mode - overwrites existing file
+    if (!out->f) {
+        printf("open for write failed: %s\n", path);
+        return false;
+    }
+    // We do our own block buffering, so skip the extra stdio copy
+    setvbuf(out->f, NULL, _IONBF, 0);
+    if (out->lossy.cfg.mode != LOSSY_OFF) {
+        // The stored end points of an SDT segment are computed values, not raw codes
+        char line[LOGGER_CONV_LINE_MAX];
+        lossy_format(ch, &out->lossy.cfg, line, sizeof line);
+        out->size = fprintf(out->f, "%s%s\n", line, ch->csv_header);
+        out->lazy = false;
+    } else if (out->lazy) {
+        char line[LOGGER_CONV_LINE_MAX];
+        logger_conv_format(ch, &logger_conv, line, sizeof line);
+        out->size = fprintf(out->f, "%s%s\n", line, LOGGER_LAZY_HEADER);
+    } else {
+        out->size = fprintf(out->f, "%s\n", ch->csv_header);
+    }
+    out->path = path;
+    out->cap = LOGGER_BLOCK_SIZE;
+    blkcache_invalidate(path, 0);
+    return true;
+}
+
+/**
+ * @brief Bytes still free in the write-behind buffer for rows.
+ *
+ * Raw log blocks keep room for their time trailer plus two more entries
+ * (period change + correction), so the next row always fits with its timestamp.
+ */
+static size_t logger_room(const logger_out_t *out) {
+    size_t reserve = out->f ? 0 : blocklog_stamps_len(&out->stamps) + 2 * sizeof(blocklog_time_exc_t);
+    return out->cap - out->len - reserve;
+}
+
+/**
+ * @brief Write the buffered rows as one block.
+ *
+ * Partial blocks are only committed to SPIFFS files. Every raw log block costs
+ * a whole flash sector, so there we wait until the block is full (or the run
+ * ends, 'final' = true); live readers still see every row via the tail ring.
+ */
+static void logger_commit(logger_out_t *out, bool final) {
+    if (out->len == 0) {
+        return;
+    }
+    if (!out->f && !final && logger_room(out) >= out->row_max &&
+        out->stamps.t.n_exc + 2 <= BLOCKLOG_TIME_EXC_MAX) {
+        return;
+    }
+
+    // Time the write itself: this is where SPIFFS may run garbage collection
+    int64_t t0 = esp_timer_get_time();
+    if (out->f) {
+        fwrite(out->wb, 1, out->len, out->f);
+        blkcache_invalidate(out->path, out->size);   // cached copies of the old last block are stale
+        out->size += out->len;
+    } else {
+        if (out->hdr.codec == BLOCKLOG_CODEC_PACK12) {
+            // Codes, not values: queries convert them with the parameters current then
+            out->hdr.vmin = (float)out->raw_min;
+            out->hdr.vmax = (float)out->raw_max;
+        }
+        out->len += blocklog_stamps_write(&out->stamps, out->wb + out->len);
+        out->hdr.flags = BLOCKLOG_FLAG_TIME;
+        out->hdr.len = out->len;
+        blocklog_append(&out->hdr, out->wb);
+        out->hdr.first_index += out->hdr.count;
+        out->hdr.count = 0;
+    }
+    uint32_t lat = (uint32_t)(esp_timer_get_time() - t0);
+    write_lat[write_lat_n++ % LOGGER_LAT_WINDOW] = lat;
+    if (lat > stats.write_max_us) {
+        stats.write_max_us = lat;
+    }
+
+    stats.blocks++;
+    stats.bytes += out->len;
+    out->len = 0;
+
+    // The next commit is at least a few rows away: a good moment for background GC
+    if (out->f) {
+        fs_gc_kick();
+    }
+}
+
+/**
+ * @brief Add one row to the write-behind buffer, committing it when due.
+ */
+static void logger_store(logger_out_t *out, const logger_channel_t *ch, const logger_sample_t *s, float value) {
+    uint32_t index = out->base + s->seq;
+    if (!out->f) {
+        // Raw log rows are contiguous within a block (index = first_index + row,
+        // which packed rows and the timestamps rely on): a dropped sample ends the block
+        if (out->hdr.count > 0 && index != out->hdr.first_index + out->hdr.count) {
+            logger_commit(out, true);
+        }
+        if (out->hdr.count == 0) {
+            out->hdr.first_index = index;
+        }
+        blocklog_stamps_add(&out->stamps, out->hdr.count, s->t_us, out->period_us);
+    }
+    if (out->len == 0) {
+        out->oldest_us = s->t_us;
+    }
+    if (out->lazy && !out->f) {
+        // 12 bits per code, same layout as codec_pack12(): an even code starts
+        // a byte pair, an odd one fills the high nibble and the next byte
+        uint8_t *p = (uint8_t *)out->wb + out->len;
+        if (out->hdr.count % 2 == 0) {
+            p[0] = (uint8_t)s->raw;
+            p[1] = (uint8_t)((s->raw >> 8) & 0x0F);
+            out->len += 2;
+        } else {
+            p[-1] |= (uint8_t)(s->raw << 4);
+            p[0] = (uint8_t)(s->raw >> 4);
+            out->len += 1;
+        }
+        if (out->hdr.count == 0 || s->raw < out->raw_min) {
+            out->raw_min = s->raw;
+        }
+        if (out->hdr.count == 0 || s->raw > out->raw_max) {
+            out->raw_max = s->raw;
+        }
+        out->hdr.count++;
+    } else if (out->lazy) {
+        out->len += snprintf(out->wb + out->len, out->cap - out->len, LOGGER_LAZY_ROW_FMT, (int)index, s->raw);
+    } else {
+        out->len += snprintf(out->wb + out->len, out->cap - out->len, ch->row_fmt, (int)index, value);
+        blocklog_hdr_add(&out->hdr, value);
+    }
+    stats.written++;
+
+    if (logger_room(out) < out->row_max || out->stamps.t.n_exc + 2 > BLOCKLOG_TIME_EXC_MAX ||
+        s->t_us - out->oldest_us >= (int64_t)LOGGER_FLUSH_MS * 1000) {
+        logger_commit(out, false);
+    }
+}
+
+/**
+ * @brief Store a row chosen by lossy.c ('index' may be the previous sample's).
+ */
+static void logger_lossy_store(uint32_t index, float value, void *arg) {
+    logger_out_t *out = arg;
+    logger_sample_t s = { .seq = index - out->base, .t_us = out->now_us };
+    logger_store(out, out->ch, &s, value);
+}
+
+/**
+ * @brief Store one sample and make it visible to every reader (tail, hot window, history).
+ *
+ * With lossy compression only the file loses rows; the readers in RAM get them all.
+ */
+static void logger_keep(logger_out_t *out, const logger_channel_t *ch, const logger_sample_t *s, float value) {
+    uint32_t index = out->base + s->seq;
+    if (out->lossy.cfg.mode != LOSSY_OFF) {
+        out->now_us = s->t_us;
+        lossy_feed(&out->lossy, index, value, logger_lossy_store, out);
+    } else {
+        logger_store(out, ch, s, value);
+    }
+    logger_publish(ch->id, index, s->t_us, value, s->raw);
+    hotwin_push(ch->id, index, s->t_us, value, s->raw);
+    hist_push(ch->id, index, s->t_us, s->raw);
+}
+
+// Where scope_feed() sends the samples it keeps
+typedef struct {
+    logger_out_t *out;
+    const logger_channel_t *ch;
+} logger_scope_ctx_t;
+
+static void logger_scope_keep(const scope_sample_t *ss, void *arg) {
+    logger_scope_ctx_t *c = arg;
+    logger_sample_t s = { .seq = ss->seq, .t_us = ss->t_us, .raw = ss->raw };
+    // Lazy runs store the raw code; the value was only needed by the trigger
+    logger_keep(c->out, c->ch, &s, c->out->lazy ? NAN : ss->value);
+}
+
+/**
+ * @brief Close the storage sink, committing whatever is still buffered.
+ */
+static void logger_close(logger_out_t *out) {
+    if (out->lossy.cfg.mode != LOSSY_OFF) {
+        lossy_end(&out->lossy, logger_lossy_store, out);
+    }
+    logger_commit(out, true);
+    if (out->f) {
+        fclose(out->f);
+    } else {
+        blocklog_checkpoint(true);
+    }
+}
+
+// Storage side of one channel of a run
+typedef struct {
+    const logger_channel_t *ch;
+    logger_out_t out;
+    uint32_t period_us;   // current sample period (for the jitter statistics)
+    int64_t prev_us;      // capture time of the previous sample
+    bool have_prev;
+    bool noisy;           // read count follows the measured noise (noise.c)
+    noise_state_t noise;
+} logger_lane_run_t;
+
+static logger_lane_run_t runs[LOGGER_LANES_MAX];
+
+/**
+ * @brief Switch a running single-channel log to a new sample period (storage loop only).
+ *
+ * The tick of a single-channel run is its period, so the timer is reprogrammed.
+ */
+static void logger_apply_period(gptimer_handle_t timer, logger_lane_run_t *lr, uint32_t period_us) {
+    logger_timer_period(timer, period_us);
+    stats.period_us = period_us;
+    stats.tick_us = period_us;
+    lr->period_us = period_us;
+
+    lr->out.period_us = period_us;   // the raw log's time trailer notes the change at the next row
+}
+
+static uint32_t logger_gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief Copy the scheduler counters kept by the ISR into 'stats'.
+ */
+static void logger_sched_stats(void) {
+    stats.dropped = acq_dropped;
+    stats.ticks = acq.ticks;
+    stats.coalesced = acq.coalesced;
+    stats.tick_idle_max_us = acq.idle_max_us;
+    stats.tick_busy_max_us = acq.busy_max_us;
+    stats.tick_busy_mean_us = acq.busy_ticks ? (uint32_t)(acq.busy_sum_us / acq.busy_ticks) : 0;
+}
+
+/**
+ * @brief Run one logging session in the calling task.
+ *
+ * Opens 'path' for writing (overwriting any previous log), writes the channel's
+ * CSV header and then stores 'samples' rows taken every 'period_us'.
+ * Rows are committed to SPIFFS when the write-behind buffer fills up or when
+ * the oldest buffered row is LOGGER_FLUSH_MS old, whichever comes first.
+ * Passing RAWLOG_PATH appends the rows to the raw block log instead.
+ *
+ * @param ch         Channel description (e.g. &LOGGER_CH_THERMISTOR)
+ * @param path       File path in SPIFFS (e.g., "/spiffs/data.csv") or RAWLOG_PATH
+ * @param samples    Number of rows to log
+ * @param period_us  Time between samples in microseconds
+ */
+void logger_run(const logger_channel_t *ch, const char *path, int samples, uint32_t period_us) {
+    logger_lane_t lane = { .ch = ch, .path = path, .samples = samples, .period_us = period_us };
+    logger_run_multi(&lane, 1);
+}
+
+/**
+ * @brief Run one logging session of up to LOGGER_LANES_MAX channels at independent rates.
+ *
+ * One timer and one storage loop serve all channels: the timer ticks at the
+ * greatest common divisor of the periods (e.g. 10 ms for a 100 Hz pot and a
+ * 1 Hz thermistor), the ISR reads whichever channels are due on a tick, and
+ * the storage loop sends each sample to its channel's own file, with its own
+ * write-behind buffer, hot window and row numbering. Each channel takes
+ * lanes[i].samples rows (<= 0 = until logger_stop()); the run ends when all
+ * are done.
+ *
+ * Burst capture, the adaptive rate and spectrum mode change the timing or
+ * the storage of a single channel, so they only apply to single-channel runs,
+ * as does logger_set_period().
+ *
+ * @param lanes  Channels with their file, row count and period
+ * @param n      Number of channels (1..LOGGER_LANES_MAX)
+ */
+void logger_run_multi(const logger_lane_t *lanes, int n) {
+    if (n < 1 || n > LOGGER_LANES_MAX) {
+        printf("[-] a run takes 1..%d channels\n", LOGGER_LANES_MAX);
+        return;
+    }
+    uint32_t tick_us = lanes[0].period_us;
+    for (int i = 1; i < n; i++) {
+        tick_us = logger_gcd(tick_us, lanes[i].period_us);
+        for (int j = 0; j < i; j++) {
+            if (strcmp(lanes[i].path, lanes[j].path) == 0) {
+                printf("[-] %s: every channel needs its own file\n", lanes[i].path);
+                return;
+            }
+        }
+    }
+    // A tick costs the ISR time even when nothing is due: keep the tick rate bounded
+    if (tick_us == 0 || (n > 1 && tick_us < LOGGER_TICK_MIN_US)) {
+        printf("[-] the periods need a common tick of at least %u us\n", (unsigned)LOGGER_TICK_MIN_US);
+        return;
+    }
+    // The pool is set up afresh below: not while a reader of the last run holds a block
+    if (!logger_pool_idle()) {
+        printf("[-] sample blocks of the last run are still in use\n");
+        return;
+    }
+
+    memset(&stats, 0, sizeof stats);
+    write_lat_n = 0;
+    // Claim the files and open them in one go, so the compactor can't swap one
+    // of them for a segment in between
+    compact_lock();
+    for (int i = 0; i < n; i++) {
+        snprintf(active_path[i], sizeof active_path[i], "%s", lanes[i].path);
+    }
+
+    // Spectrum mode: the samples go to the FFT, which writes its own file
+    bool spectral = n == 1 && spectrum_enabled() && strcmp(lanes[0].path, RAWLOG_PATH) != 0;
+    if (spectral) {
+        memset(&runs[0], 0, sizeof runs[0]);
+        runs[0].ch = lanes[0].ch;
+        runs[0].period_us = lanes[0].period_us;
+        if (!spectrum_begin(runs[0].ch, lanes[0].path, runs[0].period_us)) {
+            active_path[0][0] = '\0';
+            compact_unlock();
+            return;
+        }
+    } else if (spectrum_enabled()) {
+        printf("[-] spectrum mode needs a single channel and a CSV file\n");
+    }
+
+    for (int i = 0; i < n && !spectral; i++) {
+        logger_lane_run_t *lr = &runs[i];
+        memset(lr, 0, sizeof *lr);
+        lr->ch = lanes[i].ch;
+        lr->period_us = lanes[i].period_us;
+        if (!logger_open(&lr->out, lr->ch, lanes[i].path, wb[i])) {
+            while (--i >= 0) {
+                logger_close(&runs[i].out);
+            }
+            for (int k = 0; k < n; k++) {
+                active_path[k][0] = '\0';
+            }
+            compact_unlock();
+            return;
+        }
+        hotwin_begin(lr->ch, lanes[i].path, lr->out.base);
+        lr->out.period_us = lr->period_us;
+    }
+    compact_unlock();
+    const logger_channel_t *ch = lanes[0].ch;
+
+    // Burst capture: samples go through the trigger instead of straight to storage
+    bool scoped = n == 1 && !spectral && scope_enabled();
+    logger_scope_ctx_t scope_ctx = { .out = &runs[0].out, .ch = ch };
+    if (scoped) {
+        scope_begin();
+    }
+
+    // Adaptive rate: the controller picks the period after every sample
+    adapt_state_t adapt;
+    adapt_begin(&adapt, ch->id, tick_us);
+    bool adaptive = n == 1 && !spectral && adapt.cfg.enabled;
+    if (adaptive) {
+        tick_us = adapt.period_us;
+        runs[0].period_us = tick_us;
+        runs[0].out.period_us = tick_us;
+    } else if (n > 1 && (adapt.cfg.enabled || scope_enabled())) {
+        printf("[-] burst capture and adaptive rate apply to single-channel runs only\n");
+    }
+
+    // Noise-adaptive averaging: every channel's read count follows its own noise.
+    // All channels sample on the first tick (and again whenever their periods
+    // line up), and the ISR reads them all within that one tick: so the reads
+    // of every channel together must fit in half the shortest tick. Channels
+    // with a fixed count take theirs off the top; the rest is shared evenly.
+    uint32_t tick_min = adaptive ? adapt.cfg.min_us : tick_us;
+    int32_t budget = (int32_t)(tick_min / 2);
+    int n_noisy = 0;
+    for (int i = 0; i < n; i++) {
+        noise_cfg_t nc;
+        noise_get(runs[i].ch->id, &nc);
+        if (!spectral && nc.enabled) {
+            n_noisy++;
+        } else {
+            budget -= (spectral ? spectrum_oversample() : lanes[i].ch->oversample) * NOISE_READ_US;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t share = budget > 0 && n_noisy > 0 ? (uint32_t)budget / n_noisy : 0;
+        noise_begin(&runs[i].noise, runs[i].ch->id, share);
+        runs[i].noisy = !spectral && runs[i].noise.cfg.enabled;
+    }
+
+    // Reset the acquisition state before the ISR can run
+    memset(&acq, 0, sizeof acq);
+    for (int i = 0; i < n; i++) {
+        acq.lane[i] = (logger_acq_lane_t){
+            .channel = lanes[i].ch->channel,
+            .ch_id = lanes[i].ch->id,
+            .oversample = spectral ? spectrum_oversample()
+                        : runs[i].noisy ? (int)runs[i].noise.reads_next : lanes[i].ch->oversample,
+            .every = runs[i].period_us / tick_us,
+            .countdown = 1,                         // every channel samples on the first tick
+            .remaining = lanes[i].samples > 0 ? lanes[i].samples : -1,
+        };
+    }
+    acq.n_lanes = n;
+    acq.active = n;
+    acq.storage = xTaskGetCurrentTaskHandle();
+    acq_dropped = 0;
+    pool_init(&acq_pool, "acq", acq_blk_mem, sizeof(logger_acq_blk_t), LOGGER_ACQ_BLOCKS);
+    bus_init(&acq_bus, "acq", &acq_pool, acq_ring, LOGGER_BUS_LEN);
+    bus_subscribe(&acq_bus, &store_sub, "storage", BUS_LOSSLESS, NULL);   // woken by the ISR directly
+    if (chstats_enabled()) {
+        if (!stats_task) {
+            xTaskCreate(logger_stats_task, "chstats", 3072, NULL, 4, &stats_task);
+        }
+        if (stats_task && bus_subscribe(&acq_bus, &stats_sub, "chstats", BUS_LOSSLESS, stats_task) == ESP_OK) {
+            stats_attached = true;
+        }
+    }
+
+    // 1 MHz timer: alarm counts are microseconds
+    gptimer_handle_t timer;
+    gptimer_config_t timer_cfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    ESP_ERROR_CHECK(gptimer_new_timer(&timer_cfg, &timer));
+    gptimer_event_callbacks_t cbs = { .on_alarm = logger_timer_isr };
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(timer, &cbs, NULL));
+    ESP_ERROR_CHECK(gptimer_enable(timer));
+    logger_timer_period(timer, tick_us);
+
+    for (int i = 0; i < n; i++) {
+        active_lanes[i] = runs[i].ch;
+        printf("[+] logging %d %s samples to %s every %u us\n",
+               lanes[i].samples, runs[i].ch->name, lanes[i].path, (unsigned)runs[i].period_us);
+    }
+    if (n > 1) {
+        printf("[+] %d channels on one %u us tick\n", n, (unsigned)tick_us);
+    }
+    active_n = n;
+    active_ch = ch;
+
+    int64_t t_start = esp_timer_get_time();
+    pending_period_us = 0;
+    stats.period_us = runs[0].period_us;
+    stats.tick_us = tick_us;
+    stats.lanes = n;
+    ulTaskNotifyTake(pdTRUE, 0);              // clear a stale notification
+    gptimer_set_raw_count(timer, tick_us - 1);  // first sample right away
+    ESP_ERROR_CHECK(gptimer_start(timer));
+
+    bool stopping = false;
+    logger_acq_blk_t *blk = NULL;
+    uint32_t blk_i = 0;
+    // From here on nothing should touch the heap: samples move in pool blocks
+    heapaudit_begin(xTaskGetCurrentTaskHandle());
+    while (1) {
+        uint32_t new_period = pending_period_us;
+        if (new_period) {
+            pending_period_us = 0;
+            if (spectral) {
+                ESP_LOGW(TAG, "a spectrum run keeps its sample rate (bins depend on it)");
+            } else if (n == 1) {
+                logger_apply_period(timer, &runs[0], new_period);
+            } else {
+                ESP_LOGW(TAG, "a multi-rate run keeps its periods");
+            }
+        }
+
+        // On a stop request the ISR hands over its partly filled block on the next
+        // tick (forced right away) and takes no more samples; then stop the
+        // timer and drain what is left in the ring
+        if (stop_requested && !acq.stop && !acq.done) {
+            acq.stop = true;
+            gptimer_set_raw_count(timer, acq.tick_us - 1);
+        }
+        if (!stopping && acq.done) {
+            gptimer_stop(timer);
+            stopping = true;
+        }
+        // A last block the bus refused (storage was a full ring behind) is
+        // published from here; the ISR is finished, so storage is the producer now
+        if (stopping && acq.fill && (acq.fill->n == 0 || bus_publish(&acq_bus, &acq.fill->h, NULL))) {
+            if (acq.fill->n == 0) {
+                pool_free(&acq_pool, acq.fill);
+            }
+            acq.fill = NULL;
+        }
+
+        if (!blk && (blk = (logger_acq_blk_t *)bus_next(&acq_bus, &store_sub)) != NULL) {
+            blk_i = 0;
+        }
+        if (!blk) {
+            if (stopping && !acq.fill) {
+                break;
+            }
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOGGER_FLUSH_MS)) == 0) {
+                // Nothing new for a while: commit what we have
+                for (int i = 0; i < n; i++) {
+                    logger_commit(&runs[i].out, false);
+                }
+            }
+            continue;
+        }
+
+        // Work on the sample where the ISR wrote it; the block goes back to the
+        // pool once its last sample is done
+        const logger_sample_t *sp = &blk->s[blk_i];
+        logger_lane_run_t *lr = &runs[sp->lane];
+
+        if (stats.samples++ == 0) {
+            stats.first_sample_us = sp->t_us;
+            ESP_LOGI(TAG, "first sample %lld ms after boot", (long long)(sp->t_us / 1000));
+        }
+        if (lr->have_prev) {
+            // Timing quality: deviation of each interval from the channel's nominal period
+            int64_t dt = sp->t_us - lr->prev_us;
+            uint32_t dev = (uint32_t)(dt > lr->period_us ? dt - lr->period_us : lr->period_us - dt);
+            stats.jitter_sum_us += dev;
+            if (dev > stats.jitter_max_us) {
+                stats.jitter_max_us = dev;
+            }
+            if (dt > (int64_t)lr->period_us * 3 / 2) {
+                stats.overruns += (uint32_t)((dt + lr->period_us / 2) / lr->period_us) - 1;
+            }
+        }
+        lr->prev_us = sp->t_us;
+        lr->have_prev = true;
+        logger_sched_stats();
+
+        if (lr->noisy) {
+            uint32_t k = noise_update(&lr->noise, lr->ch->id, sp->reads, sp->m2);
+            __atomic_store_n(&acq.lane[sp->lane].oversample, (int)k, __ATOMIC_RELAXED);
+        }
+
+        // Lazy mode: no float math here unless the trigger or the rate controller need the value
+        float value = !lr->out.lazy || scoped || adaptive || spectral ? lr->ch->convert(sp->raw) : NAN;
+        if (spectral) {
+            spectrum_feed(value);
+        } else if (scoped) {
+            scope_sample_t ss = { .t_us = sp->t_us, .seq = sp->seq, .value = value, .raw = (uint16_t)sp->raw };
+            scope_feed(&ss, logger_scope_keep, &scope_ctx);
+        } else {
+            logger_keep(&lr->out, lr->ch, sp, lr->out.lazy ? NAN : value);
+        }
+        if (adaptive) {
+            uint32_t p = adapt_update(&adapt, value);
+            if (p != lr->period_us) {
+                logger_apply_period(timer, lr, p);
+            }
+        }
+        stats.elapsed_us = sp->t_us - t_start;
+
+        if (++blk_i == blk->n) {
+            bus_release(&acq_bus, &store_sub, &blk->h);
+            blk = NULL;
+        }
+    }
+    heapaudit_end();
+    logger_bus_close();
+
+    gptimer_disable(timer);
+    gptimer_del_timer(timer);
+    logger_sched_stats();
+
+    if (spectral) {
+        spectrum_end();
+    }
+    for (int i = 0; i < n && !spectral; i++) {
+        logger_close(&runs[i].out);
+    }
+    active_ch = NULL;
+    active_n = 0;
+    for (int i = 0; i < n; i++) {
+        active_path[i][0] = '\0';
+    }
+
+    stats.elapsed_us = esp_timer_get_time() - t_start;
+    ESP_LOGI(TAG, "%s%s: %u rows, %u dropped, %u overruns, %u blocks, %u bytes in %lld ms, jitter max %u us",
+             ch->name, n > 1 ? " + others" : "", (unsigned)stats.written, (unsigned)stats.dropped,
+             (unsigned)stats.overruns, (unsigned)stats.blocks, (unsigned)stats.bytes,
+             (long long)(stats.elapsed_us / 1000), (unsigned)stats.jitter_max_us);
+    if (n > 1) {
+        ESP_LOGI(TAG, "scheduler: %u ticks of %u us, %u with coalesced reads, tick cost idle max %u us, "
+                 "with reads max %u / mean %u us",
+                 (unsigned)stats.ticks, (unsigned)stats.tick_us, (unsigned)stats.coalesced,
+                 (unsigned)stats.tick_idle_max_us, (unsigned)stats.tick_busy_max_us,
+                 (unsigned)stats.tick_busy_mean_us);
+    }
+    for (uint32_t i = 0; i < bus_last.n_subs; i++) {
+        ESP_LOGI(TAG, "bus: %s (%s) read %u of %u blocks, missed %u", bus_last.sub[i].name,
+                 bus_last.sub[i].policy == BUS_LOSSLESS ? "lossless" : "drop",
+                 (unsigned)bus_last.sub[i].blocks, (unsigned)bus_last.published, (unsigned)bus_last.sub[i].missed);
+    }
+    pool_stats_t ps;
+    pool_get_stats(&acq_pool, &ps);
+    heapaudit_t ha;
+    heapaudit_get(&ha);
+    ESP_LOGI(TAG, "handoff: %u blocks of %u samples, peak %u in use, %u handed over, %u times exhausted; "
+             "heap %s: %u mallocs by storage, %u in ISRs, %d net blocks",
+             (unsigned)ps.count, LOGGER_ACQ_BLOCK_LEN, (unsigned)ps.peak, (unsigned)ps.allocs,
+             (unsigned)ps.exhausted, ha.hooks ? "audit" : "blocks only", (unsigned)ha.mallocs,
+             (unsigned)ha.isr_mallocs, (int)ha.net_blocks);
+    if (scoped) {
+        scope_stats_t sc;
+        scope_get_stats(&sc);
+        ESP_LOGI(TAG, "scope: %u trigger events, kept %u of %u samples",
+                 (unsigned)sc.events, (unsigned)sc.kept, (unsigned)sc.seen);
+    }
+    for (int i = 0; i < n; i++) {
+        const noise_state_t *ns = &runs[i].noise;
+        if (runs[i].noisy && ns->samples > 0) {
+            ESP_LOGI(TAG, "%s: %u ADC reads for %u samples (%.2f each, fixed: %d), sigma %.2f LSB, "
+                     "standard error %.2f LSB (target %.2f)", runs[i].ch->name, (unsigned)ns->reads,
+                     (unsigned)ns->samples, (double)ns->reads / ns->samples, runs[i].ch->oversample,
+                     sqrtf(ns->var), ns->se_sum / ns->samples, ns->cfg.se_lsb);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        const logger_out_t *out = &runs[i].out;
+        if (out->lossy.cfg.mode != LOSSY_OFF) {
+            ESP_LOGI(TAG, "%s: lossy %s (eps %g): stored %u of %u rows", runs[i].ch->name,
+                     lossy_mode_name(out->lossy.cfg.mode), out->lossy.cfg.eps,
+                     (unsigned)out->lossy.kept, (unsigned)out->lossy.seen);
+        }
+    }
+}
+
+/**
+ * @brief Copy the counters from the last logging run.
+ */
+void logger_get_stats(logger_stats_t *out) {
+    *out = stats;
+}
+
+/**
+ * @brief Subscribers of the sample bus: live during a run, else as the last run ended.
+ */
+void logger_get_bus_stats(bus_stats_t *out) {
+    if (active_ch) {
+        bus_get_stats(&acq_bus, out);
+    } else {
+        *out = bus_last;
+    }
+}
+
+/**
+ * @brief Counters of the sample block pool between the timer ISR and storage.
+ */
+void logger_get_pool_stats(pool_stats_t *out) {
+    pool_get_stats(&acq_pool, out);
+}
+
+static volatile bool hammer_run = false;
+
+/**
+ * @brief Load generator for logger_bench_jitter(): keeps SPIFFS erasing and programming.
+ */
+static void logger_hammer_task(void *arg) {
+    static char junk[1024];
+    memset(junk, 0x5A, sizeof junk);
+
+    while (hammer_run) {
+        FILE *f = fopen("/spiffs/hammer.bin", "w");
+        if (f) {
+            for (int i = 0; i < 32 && hammer_run; i++) {
+                fwrite(junk, 1, sizeof junk, f);
+                fflush(f);
+            }
+            fclose(f);
+        }
+        remove("/spiffs/hammer.bin");   // deleted pages force GC and erases later on
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Measure sample timing jitter while flash is kept busy.
+ *
+ * Logs 'samples' thermistor readings every 'period_us' to a scratch file
+ * while a second task continuously writes and deletes a 32 KB file, so the
+ * flash cache is disabled for erases and page programs throughout the run.
+ * Prints the mean and maximum deviation of the sample intervals from the
+ * nominal period. SPIFFS must be mounted and the ADC set up.
+ */
+void logger_bench_jitter(uint32_t period_us, int samples) {
+    hammer_run = true;
+    xTaskCreatePinnedToCore(logger_hammer_task, "hammer", 3072, NULL, 4, NULL, 0);
+
+    logger_run(&LOGGER_CH_THERMISTOR, "/spiffs/jitter.csv", samples, period_us);
+
+    hammer_run = false;
+    vTaskDelay(pdMS_TO_TICKS(500));
+    remove("/spiffs/jitter.csv");
+
+    uint32_t n = stats.samples > 1 ? stats.samples - 1 : 1;
+    printf("[*] jitter bench: %u samples every %u us under flash load: "
+           "mean %u us, max %u us, %u overruns, %u dropped\n",
+           (unsigned)stats.samples, (unsigned)period_us,
+           (unsigned)(stats.jitter_sum_us / n), (unsigned)stats.jitter_max_us,
+           (unsigned)stats.overruns, (unsigned)stats.dropped);
+}
+
+static int logger_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Percentiles of the block write latency over the last LOGGER_LAT_WINDOW writes.
+ *
+ * Covers fwrite() to SPIFFS (including any garbage collection it triggers) or
+ * the raw log append. Compare runs with fs_gc_enable(true/false) to see the
+ * effect of the background GC task.
+ */
+void logger_get_write_latency(logger_latency_t *out) {
+    static uint32_t sorted[LOGGER_LAT_WINDOW];
+    uint32_t n = write_lat_n < LOGGER_LAT_WINDOW ? write_lat_n : LOGGER_LAT_WINDOW;
+
+    memcpy(sorted, write_lat, n * sizeof sorted[0]);
+    qsort(sorted, n, sizeof sorted[0], logger_cmp_u32);
+
+    out->count = n;
+    out->p50_us = n ? sorted[n / 2] : 0;
+    out->p99_us = n ? sorted[(n * 99) / 100] : 0;
+    out->max_us = stats.write_max_us;
+}
+
+/**
+ * @brief Remember in NVS whether an open-ended raw log run is active, so it can be resumed after a reboot.
+ */
+static void logger_save_resume(bool active) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    logger_resume_t r = {
+        .active = active,
+        .channel = job.lanes[0].ch ? job.lanes[0].ch->id : 0,
+        .period_us = job.lanes[0].period_us,
+    };
+    if (nvs_set_blob(nvs, "run", &r, sizeof r) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+/**
+ * @brief True if the background run is an open-ended single-channel raw log run.
+ *
+ * Only those are resumed after a reboot (see logger_resume()).
+ */
+static bool logger_job_resumable(void) {
+    return job.n == 1 && job.lanes[0].samples <= 0 && strcmp(job.paths[0], RAWLOG_PATH) == 0;
+}
+
+/**
+ * @brief Task body for background runs started with logger_start_multi().
+ */
+static void logger_job_task(void *arg) {
+    logger_run_multi(job.lanes, job.n);
+    job_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Start a logging run in the background and return immediately.
+ *
+ * Same parameters as logger_run(); 'samples' <= 0 logs until logger_stop().
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if a run is already active
+ */
+esp_err_t logger_start(const logger_channel_t *ch, const char *path, int samples, uint32_t period_us) {
+    logger_lane_t lane = { .ch = ch, .path = path, .samples = samples, .period_us = period_us };
+    return logger_start_multi(&lane, 1);
+}
+
+/**
+ * @brief Start a multi-rate run (see logger_run_multi()) in the background.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if a run is already active,
+ *         ESP_ERR_INVALID_ARG for no or too many channels
+ */
+esp_err_t logger_start_multi(const logger_lane_t *lanes, int n) {
+    if (job_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (n < 1 || n > LOGGER_LANES_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < n; i++) {
+        job.lanes[i] = lanes[i];
+        snprintf(job.paths[i], sizeof job.paths[i], "%s", lanes[i].path);
+        job.lanes[i].path = job.paths[i];
+    }
+    job.n = n;
+    stop_requested = false;
+
+    if (xTaskCreate(logger_job_task, "logger", 4096, NULL, 5, &job_task) != pdPASS) {
+        job_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (logger_job_resumable()) {
+        logger_save_resume(true);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Restart the raw log run that was active before the last reboot, if any.
+ *
+ * Call at startup after nvs_init_or_die() and adc_oneshot_setup(). The raw log
+ * cursor comes from its NVS checkpoint, so the first sample is taken without
+ * rescanning the partition, and sample numbering continues where it stopped.
+ *
+ * @return true if a run was resumed
+ */
+bool logger_resume(void) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    logger_resume_t r;
+    size_t len = sizeof r;
+    esp_err_t err = nvs_get_blob(nvs, "run", &r, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK || len != sizeof r || !r.active || r.period_us == 0) {
+        return false;
+    }
+    const logger_channel_t *ch = logger_channel_by_id(r.channel);
+    if (!ch) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "resuming %s logging to raw log every %u us", ch->name, (unsigned)r.period_us);
+    return logger_start(ch, RAWLOG_PATH, 0, r.period_us) == ESP_OK;
+}
+
+/**
+ * @brief Stop a background run and wait until its file is closed.
+ */
+void logger_stop(void) {
+    if (job_task && logger_job_resumable()) {
+        logger_save_resume(false);
+    }
+    stop_requested = true;
+    while (job_task) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    stop_requested = false;
+}
+
+/**
+ * @brief Change the sample period of the active run.
+ *
+ * Takes effect within LOGGER_FLUSH_MS (the storage loop applies it), without
+ * stopping the run or reopening the file. Single-channel runs only.
+ */
+void logger_set_period(uint32_t period_us) {
+    if (period_us > 0) {
+        pending_period_us = period_us;
+        if (job_task && logger_job_resumable()) {
+            job.lanes[0].period_us = period_us;
+            logger_save_resume(true);
+        }
+    }
+}
+
+/**
+ * @brief True if a run (background or not) currently has 'path' open for writing.
+ */
+bool logger_is_writing(const char *path) {
+    for (int i = 0; i < LOGGER_LANES_MAX; i++) {
+        if (active_path[i][0] && strcmp(active_path[i], path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Select lazy (raw codes + parameters) or eager (converted values) CSV files.
+ *
+ * Applies from the next run on; the current file keeps the mode it was opened with.
+ */
+void logger_set_lazy(bool lazy) {
+    lazy_mode = lazy;
+}
+
+bool logger_is_lazy(void) {
+    return lazy_mode;
+}
+
+/**
+ * @brief True while a background run started by logger_start() is active.
+ */
+bool logger_is_running(void) {
+    return job_task != NULL;
+}
+
+/**
+ * @brief Position a cursor so that it only returns records published from now on.
+ */
+void logger_cursor_init(logger_cursor_t *c) {
+    c->next = __atomic_load_n(&tail_head, __ATOMIC_ACQUIRE);
+    c->missed = 0;
+}
+
+/**
+ * @brief Copy up to 'max' new records from the tail ring.
+ *
+ * Never blocks and never takes a lock, so it can't slow down the storage loop.
+ * If the reader fell more than LOGGER_TAIL_LEN records behind, the overwritten
+ * records are skipped and counted in c->missed.
+ *
+ * @return Number of records copied to 'out'
+ */
+int logger_cursor_read(logger_cursor_t *c, logger_record_t *out, int max) {
+    uint32_t head = __atomic_load_n(&tail_head, __ATOMIC_ACQUIRE);
+
+    // Lapped by the writer: jump to the oldest record still in the ring
+    if (head - c->next > LOGGER_TAIL_LEN) {
+        c->missed += head - c->next - LOGGER_TAIL_LEN;
+        c->next = head - LOGGER_TAIL_LEN;
+    }
+
+    int n = 0;
+    while (n < max && c->next != head) {
+        out[n] = tail_ring[c->next % LOGGER_TAIL_LEN];
+
+        // The writer may have reused the slot while we were copying it
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t now = __atomic_load_n(&tail_head, __ATOMIC_ACQUIRE);
+        if (now - c->next > LOGGER_TAIL_LEN - 1) {
+            c->missed++;
+            c->next++;
+            continue;
+        }
+        c->next++;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Stream newly stored records to the console while logging continues ("tail -f").
+ *
+ * Prints the active channel's CSV header and then every record as it is
+ * stored, in the same row format as the file (a multi-rate run prints the
+ * header of each channel, and each row in its channel's format). Returns when
+ * the run ends or after 'duration_ms' (0 = until the run ends).
+ *
+ * Latency is measured from ADC capture to the moment the row has been handed
+ * to the console driver (fflush(stdout) returns once the bytes are in the UART
+ * FIFO), and a summary is printed at the end. Add about 10 bits per character
+ * at CONFIG_ESP_CONSOLE_UART_BAUDRATE for the time on the wire.
+ */
+void logger_tail(uint32_t duration_ms) {
+    // Wait briefly for a run to start publishing
+    for (int i = 0; i < 50 && !active_ch; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    const logger_channel_t *ch = active_ch;
+    if (!ch) {
+        printf("[-] tail: logger is not running\n");
+        return;
+    }
+
+    logger_cursor_t cur;
+    logger_cursor_init(&cur);
+    logger_record_t recs[16];
+    char line[LOGGER_MAX_ROW];
+
+    uint32_t rows = 0;
+    int64_t lat_min = INT64_MAX, lat_max = 0, lat_sum = 0;
+    int64_t t_end = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+
+    for (uint32_t i = 0; i < active_n; i++) {
+        printf("%s\n", active_lanes[i]->csv_header);
+    }
+
+    while (active_ch == ch && (duration_ms == 0 || esp_timer_get_time() < t_end)) {
+        int n = logger_cursor_read(&cur, recs, 16);
+        if (n == 0) {
+            vTaskDelay(pdMS_TO_TICKS(LOGGER_TAIL_POLL_MS));
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            const logger_channel_t *rc = logger_channel_by_id(recs[i].ch);
+            if (!rc) {
+                continue;
+            }
+            int len = snprintf(line, sizeof line, rc->row_fmt, (int)recs[i].seq, logger_record_value(rc, &recs[i]));
+            fwrite(line, 1, len, stdout);
+        }
+        fflush(stdout);
+
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < n; i++) {
+            int64_t lat = now - recs[i].t_us;
+            if (lat < lat_min) lat_min = lat;
+            if (lat > lat_max) lat_max = lat;
+            lat_sum += lat;
+        }
+        rows += n;
+    }
+
+    if (rows > 0) {
+        printf("[*] tail: %u rows, %u missed, latency min/avg/max = %lld/%lld/%lld us\n",
+               (unsigned)rows, (unsigned)cur.missed, (long long)lat_min,
+               (long long)(lat_sum / rows), (long long)lat_max);
+    }
+}
+
+/**
+ * @brief Print the latest acquired value of each channel of the run a few times a second.
+ *
+ * Reads the sample bus directly, so it also shows channels whose samples are
+ * not stored (scope, spectrum and lossy modes). A drop subscriber: if the
+ * console falls behind it skips to the newest block, and the logger never
+ * waits for it. Returns when the run ends or after 'duration_ms' (0 = until
+ * the run ends).
+ */
+void logger_watch(uint32_t duration_ms) {
+    for (int i = 0; i < 50 && !active_ch; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    const logger_channel_t *ch = active_ch;
+    if (!ch) {
+        printf("[-] watch: logger is not running\n");
+        return;
+    }
+
+    static bus_sub_t sub;
+    esp_err_t err = bus_subscribe(&acq_bus, &sub, "watch", BUS_DROP, NULL);
+    if (err != ESP_OK) {
+        printf("[-] watch: %s\n", err == ESP_ERR_NO_MEM ? "too many bus subscribers" : "logger is not running");
+        return;
+    }
+    logger_sample_t last[LOGGER_LANES_MAX];
+    bool seen[LOGGER_LANES_MAX] = { false };
+    uint32_t samples = 0;
+    int64_t t_end = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+    int64_t t_print = esp_timer_get_time();
+
+    // Ends with the run: closing the bus detaches this reader
+    while (bus_attached(&acq_bus, &sub) && (duration_ms == 0 || esp_timer_get_time() < t_end)) {
+        bus_hdr_t *h;
+        while ((h = bus_next(&acq_bus, &sub)) != NULL) {
+            const logger_acq_blk_t *b = (const logger_acq_blk_t *)h;
+            for (uint32_t i = 0; i < b->n; i++) {
+                uint8_t lane = b->s[i].lane;
+                if (lane < LOGGER_LANES_MAX) {
+                    last[lane] = b->s[i];
+                    seen[lane] = true;
+                }
+            }
+            samples += b->n;
+            bus_release(&acq_bus, &sub, h);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - t_print >= LOGGER_WATCH_MS * 1000) {
+            t_print = now;
+            for (int i = 0; i < LOGGER_LANES_MAX; i++) {
+                const logger_channel_t *rc = seen[i] ? logger_channel_by_id(last[i].ch) : NULL;
+                if (rc) {
+                    printf("%s #%u %.3f (raw %d, %lld ms old)  ", rc->name, (unsigned)last[i].seq,
+                           rc->convert(last[i].raw), last[i].raw, (long long)((now - last[i].t_us) / 1000));
+                }
+            }
+            printf("\n");
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOGGER_TAIL_POLL_MS));
+    }
+    bus_unsubscribe(&acq_bus, &sub);
+    printf("[*] watch: %u blocks (%u samples), %u blocks skipped\n",
+           (unsigned)sub.blocks, (unsigned)samples, (unsigned)sub.missed);
+}
@@ -0,0 +1,165 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "hal/adc_types.h"
+#include "pool.h"
+#include "bus.h"
+
+// Write-behind buffer: rows are collected here and written to SPIFFS one block at a time
+#define LOGGER_BLOCK_SIZE     4096   // bytes per write (one flash sector)
+#define LOGGER_FLUSH_MS       1000   // commit a partially filled block after this long
+#define LOGGER_BUS_LEN        32     // sample blocks a subscriber can fall behind the timer ISR (power of two)
+#define LOGGER_ACQ_BLOCKS     (LOGGER_BUS_LEN + 8)   // pool: the bus ring, readers and the block being filled
+#define LOGGER_ACQ_BLOCK_LEN  8      // samples per block
+#define LOGGER_ACQ_LEN        (LOGGER_BUS_LEN * LOGGER_ACQ_BLOCK_LEN)   // samples storage can fall behind
+#define LOGGER_POOL_WAIT_MS   1000   // a new run waits this long for readers of the last one to let go
+#define LOGGER_TAIL_LEN       256    // stored records kept in RAM for live readers
+#define LOGGER_TAIL_POLL_MS   20     // how often logger_tail() checks for new records
+#define LOGGER_WATCH_MS       250    // logger_watch() refresh interval
+#define LOGGER_LAT_WINDOW     256    // block writes kept for latency percentiles
+#define LOGGER_LANES_MAX      2      // channels one run can sample at independent rates
+#define LOGGER_TICK_MIN_US    1000   // finest timer tick of a multi-rate run
+
+// Ids of the built-in channels (stored in raw log block headers)
+#define LOGGER_CH_ID_POT          0
+#define LOGGER_CH_ID_THERMISTOR   1
+
+// Converts an averaged raw ADC code into the value written to the CSV
+typedef float (*logger_convert_fn)(int raw);
+
+// Parameters of the raw code -> value conversions. Lazy files store a copy in
+// their first line, so old data is converted with the parameters it was
+// recorded with, or re-converted after a calibration change.
+typedef struct {
+    float vin;                   // ADC full scale / divider supply (V)
+    float r_fixed;               // thermistor divider series resistor (ohm)
+    float r0;                    // thermistor resistance at t0 (ohm)
+    float t0_c;                  // thermistor reference temperature (°C)
+    float beta;                  // thermistor B coefficient (K)
+    float gain;                  // calibration: V = gain * V_adc + offset
+    float offset;                // (V)
+} logger_conv_t;
+
+extern logger_conv_t logger_conv;   // current parameters (eager conversion, new lazy files)
+
+// Lazy conversion mode: CSV files get raw codes, conversion happens on export
+#define LOGGER_LAZY_TAG        "%conv"          // first line of a lazy file: tag, channel, parameters
+#define LOGGER_LAZY_HEADER     "index,raw_code"
+#define LOGGER_LAZY_ROW_FMT    "#%d, %d\n"
+#define LOGGER_CONV_BATCH      32               // rows converted per batch on export
+#define LOGGER_CONV_LINE_MAX   192              // longest first line of a lazy file, with '\n' and NUL
+
+// Description of one loggable sensor. The pot and thermistor loggers are just
+// two instances of this struct fed to the same logging core.
+typedef struct {
+    uint8_t id;                  // LOGGER_CH_ID_*
+    const char *name;            // short name for log messages ("pot", "thermistor")
+    adc_channel_t channel;       // ADC1 channel to sample
+    int oversample;              // raw reads averaged into one sample
+    const char *csv_header;      // first line written to the file
+    const char *row_fmt;         // printf format for one row: (int index, double value)
+    logger_convert_fn convert;   // raw code -> logged value
+} logger_channel_t;
+
+extern const logger_channel_t LOGGER_CH_POT;
+extern const logger_channel_t LOGGER_CH_THERMISTOR;
+const logger_channel_t *logger_channel_by_id(uint8_t id);
+
+// One channel of a run: logger_run_multi() samples several at independent rates
+typedef struct {
+    const logger_channel_t *ch;
+    const char *path;            // file for this channel (or RAWLOG_PATH); each channel needs its own
+    int samples;                 // rows to log; <= 0 = until logger_stop()
+    uint32_t period_us;          // time between samples of this channel
+} logger_lane_t;
+
+// Counters from the last logging run
+typedef struct {
+    uint32_t samples;            // samples received from acquisition
+    uint32_t written;            // rows written to the file
+    uint32_t dropped;            // samples lost because storage fell behind
+    uint32_t overruns;           // sample periods with no sample (interval > 1.5 periods)
+    uint32_t jitter_max_us;      // largest deviation of a sample interval from the period
+    uint64_t jitter_sum_us;      // sum of deviations (divide by samples - 1 for the mean)
+    uint32_t blocks;             // block writes issued to SPIFFS / the raw log
+    uint32_t bytes;              // bytes written (excluding header)
+    uint32_t write_max_us;       // slowest block write of the run
+    uint32_t period_us;          // current sample period (of the first channel)
+    uint32_t lanes;              // channels sampled by the run
+    uint32_t tick_us;            // timer tick: greatest common divisor of the periods
+    uint32_t ticks;              // timer ticks so far
+    uint32_t coalesced;          // ticks that read more than one channel
+    uint32_t tick_idle_max_us;   // slowest tick with nothing due (scheduler bookkeeping only)
+    uint32_t tick_busy_max_us;   // slowest tick with ADC reads
+    uint32_t tick_busy_mean_us;
+    int64_t  first_sample_us;    // time since boot of the first sample (boot-to-first-sample latency)
+    int64_t  elapsed_us;         // wall time of the run
+} logger_stats_t;
+
+// Block write latency percentiles
+typedef struct {
+    uint32_t count;              // writes in the window
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;             // slowest write of the run
+} logger_latency_t;
+
+// One stored record as seen by live readers (tail mode)
+typedef struct {
+    uint8_t  ch;                 // LOGGER_CH_ID_* of the channel
+    uint32_t seq;                // row index in the file
+    int64_t  t_us;               // capture time (esp_timer)
+    float    value;              // converted value (NAN in lazy mode, see logger_record_value())
+    uint16_t raw;                // averaged ADC code
+} logger_record_t;
+
+// Reader position in the tail ring; each reader owns its own cursor
+typedef struct {
+    uint32_t next;               // next record to read
+    uint32_t missed;             // records overwritten before this reader got to them
+} logger_cursor_t;
+
+// Shared logging core (Demo 3.2/3.3)
+// Acquire 'samples' readings of 'ch' every 'period_us' microseconds and store them as CSV at 'path'
+void logger_run(const logger_channel_t *ch, const char *path, int samples, uint32_t period_us);
+// Several channels at independent rates from one timer and one storage loop
+void logger_run_multi(const logger_lane_t *lanes, int n);
+void logger_get_stats(logger_stats_t *out);
+// Counters of the ISR -> storage block pool (current or last run)
+void logger_get_pool_stats(pool_stats_t *out);
+void logger_get_bus_stats(bus_stats_t *out);
+void logger_get_write_latency(logger_latency_t *out);
+void logger_bench_jitter(uint32_t period_us, int samples);
+
+// Background logging (Demo 3.4): 'samples' <= 0 logs until logger_stop()
+esp_err_t logger_start(const logger_channel_t *ch, const char *path, int samples, uint32_t period_us);
+esp_err_t logger_start_multi(const logger_lane_t *lanes, int n);
+void logger_stop(void);
+bool logger_is_running(void);
+bool logger_is_writing(const char *path);
+void logger_set_period(uint32_t period_us);
+void logger_set_lazy(bool lazy);
+bool logger_is_lazy(void);
+bool logger_resume(void);
+
+// Live tail: stream records to the console while logging continues
+void logger_cursor_init(logger_cursor_t *c);
+int logger_cursor_read(logger_cursor_t *c, logger_record_t *out, int max);
+void logger_tail(uint32_t duration_ms);
+// Live readout of the latest acquired value per channel, read from the sample bus
+void logger_watch(uint32_t duration_ms);
+
+// Conversions used by the built-in channels
+float logger_pot_to_volts(int raw);
+float logger_thermistor_to_celsius(int raw);
+float logger_record_value(const logger_channel_t *ch, const logger_record_t *r);
+void logger_convert_batch(const logger_channel_t *ch, const logger_conv_t *conv, const uint16_t *raw, float *out, int n);
+int logger_conv_format(const logger_channel_t *ch, const logger_conv_t *conv, char *buf, size_t len);
+const logger_channel_t *logger_conv_parse(const char *line, logger_conv_t *conv);
+esp_err_t logger_recalibrate(const char *path);   // give a lazy file the current parameters
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file lossy.c
+ * @brief Deadband and swinging-door compression of slowly varying channels.
+ *
+ * Most consecutive thermistor rows differ by less than the sensor noise, yet
+ * every one of them is formatted and written. With lossy compression enabled
+ * for a channel the storage loop only stores the rows needed to rebuild the
+ * series within 'eps'; the stored rows keep their indices, so a reader knows
+ * which ones are missing and fills them in (lossy_fill()).
+ *
+ * Deadband: a row is stored when it differs from the last stored row by more
+ * than eps. Every dropped row is within eps of the stored row before it, so
+ * the gap is filled with that value (sample and hold).
+ *
+ * Swinging door (SDT): from the last stored row (the pivot) two "doors" are
+ * the steepest and the flattest line that still pass within eps of every row
+ * seen since. Each new row narrows them; when they cross, no straight line from
+ * the pivot fits the new row, so the segment ends at the previous row and that
+ * row becomes the next pivot. The stored end point lies on the middle of the
+ * doors rather than on the measured value, which keeps every dropped row within
+ * eps of the interpolated line.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "lossy.h"
+
+static lossy_cfg_t cfgs[LOSSY_CHANNELS];
+
+static const char *mode_names[] = { "off", "deadband", "sdt" };
+
+/**
+ * @brief Set (or with cfg->mode = LOSSY_OFF, clear) the compression of a channel.
+ *
+ * Used from the next run of that channel on.
+ */
+void lossy_set(uint8_t ch_id, const lossy_cfg_t *cfg) {
+    if (ch_id >= LOSSY_CHANNELS) {
+        return;
+    }
+    lossy_cfg_t c = *cfg;
+    if (!(c.eps >= 0)) {
+        c.eps = 0;   // also catches NaN
+    }
+    cfgs[ch_id] = c;
+}
+
+void lossy_get(uint8_t ch_id, lossy_cfg_t *out) {
+    if (ch_id < LOSSY_CHANNELS) {
+        *out = cfgs[ch_id];
+    } else {
+        memset(out, 0, sizeof *out);
+    }
+}
+
+/**
+ * @brief Start a run of a channel with its configuration.
+ */
+void lossy_begin(lossy_state_t *s, uint8_t ch_id) {
+    memset(s, 0, sizeof *s);
+    lossy_get(ch_id, &s->cfg);
+}
+
+/**
+ * @brief Store a row and make it the new pivot.
+ */
+static void lossy_keep(lossy_state_t *s, uint32_t index, float value, lossy_emit_fn emit, void *ctx) {
+    emit(index, value, ctx);
+    s->kept++;
+    s->a_index = index;
+    s->a_value = value;
+    s->lo = -INFINITY;
+    s->hi = INFINITY;
+    s->have_prev = false;
+}
+
+/**
+ * @brief Value of the middle of the doors at 'index' (SDT).
+ */
+static float lossy_door_mid(const lossy_state_t *s, uint32_t index) {
+    return s->a_value + 0.5f * (s->lo + s->hi) * (float)(index - s->a_index);
+}
+
+/**
+ * @brief Feed one row; 'emit' is called for every row to store, in index order.
+ *
+ * A stored row may be an earlier one than 'index' (SDT ends a segment at the
+ * previous row), so rows reach 'emit' up to one sample late.
+ */
+void lossy_feed(lossy_state_t *s, uint32_t index, float value, lossy_emit_fn emit, void *ctx) {
+    s->seen++;
+    if (!s->started || s->cfg.mode == LOSSY_OFF) {
+        s->started = true;
+        lossy_keep(s, index, value, emit, ctx);
+        return;
+    }
+
+    if (s->cfg.mode == LOSSY_DEADBAND) {
+        if (fabsf(value - s->a_value) > s->cfg.eps) {
+            lossy_keep(s, index, value, emit, ctx);
+            return;
+        }
+    } else {
+        // Narrow the doors: slopes from the pivot that pass within eps of this row
+        float dx = (float)(index - s->a_index);
+        float lo = fmaxf(s->lo, (value - s->cfg.eps - s->a_value) / dx);
+        float hi = fminf(s->hi, (value + s->cfg.eps - s->a_value) / dx);
+        if (lo > hi && s->have_prev) {
+            // The doors crossed: close the segment at the previous row
+            lossy_keep(s, s->p_index, lossy_door_mid(s, s->p_index), emit, ctx);
+            dx = (float)(index - s->a_index);
+            lo = (value - s->cfg.eps - s->a_value) / dx;
+            hi = (value + s->cfg.eps - s->a_value) / dx;
+        }
+        s->lo = lo;
+        s->hi = hi;
+    }
+    s->have_prev = true;
+    s->p_index = index;
+    s->p_value = value;
+}
+
+/**
+ * @brief End of the run: store the last row, so readers know where the series ends.
+ */
+void lossy_end(lossy_state_t *s, lossy_emit_fn emit, void *ctx) {
+    if (!s->have_prev) {
+        return;
+    }
+    float v = s->cfg.mode == LOSSY_SDT ? lossy_door_mid(s, s->p_index) : s->p_value;
+    lossy_keep(s, s->p_index, v, emit, ctx);
+}
+
+/**
+ * @brief Format the first line of a lossy file (tag, channel, mode and eps).
+ *
+ * @return Length as snprintf()
+ */
+int lossy_format(const logger_channel_t *ch, const lossy_cfg_t *cfg, char *buf, size_t len) {
+    return snprintf(buf, len, "%s %s %s eps=%.9g\n", LOSSY_TAG, ch->name,
+                    lossy_mode_name(cfg->mode), cfg->eps);
+}
+
+/**
+ * @brief Parse the first line of a lossy file.
+ *
+ * @return Channel that wrote the file, or NULL if 'line' is not a lossy file header
+ */
+const logger_channel_t *lossy_parse(const char *line, lossy_cfg_t *cfg) {
+    char name[16], mode[16];
+    if (strncmp(line, LOSSY_TAG " ", sizeof LOSSY_TAG) != 0 ||
+        sscanf(line + sizeof LOSSY_TAG, "%15s %15s eps=%f", name, mode, &cfg->eps) != 3 ||
+        !lossy_parse_mode(mode, &cfg->mode)) {
+        return NULL;
+    }
+    for (uint8_t id = 0; logger_channel_by_id(id); id++) {
+        if (strcmp(name, logger_channel_by_id(id)->name) == 0) {
+            return logger_channel_by_id(id);
+        }
+    }
+    return NULL;
+}
+
+const char *lossy_mode_name(lossy_mode_t mode) {
+    return (unsigned)mode < sizeof mode_names / sizeof mode_names[0] ? mode_names[mode] : "?";
+}
+
+/**
+ * @brief Compression mode from its console name.
+ */
+bool lossy_parse_mode(const char *name, lossy_mode_t *out) {
+    for (int i = 0; i < (int)(sizeof mode_names / sizeof mode_names[0]); i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            *out = (lossy_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Rebuilt value of dropped row 'k' between the stored rows (i0, v0) and (i1, v1).
+ *
+ * The previous stored value (deadband) or the straight line between the two (SDT).
+ */
+float lossy_estimate(lossy_mode_t mode, uint32_t i0, float v0, uint32_t i1, float v1, uint32_t k) {
+    if (mode != LOSSY_SDT) {
+        return v0;
+    }
+    return v0 + (v1 - v0) * (float)(k - i0) / (float)(i1 - i0);
+}
+
+/**
+ * @brief Reader side: pass on one stored row, preceded by the rows dropped before it.
+ */
+void lossy_fill(lossy_fill_t *f, uint32_t index, float value, lossy_emit_fn emit, void *ctx) {
+    if (f->have && index > f->index + 1) {
+        for (uint32_t k = f->index + 1; k < index; k++) {
+            emit(k, lossy_estimate(f->mode, f->index, f->value, index, value, k), ctx);
+        }
+    }
+    emit(index, value, ctx);
+    f->have = true;
+    f->index = index;
+    f->value = value;
+}
@@ -0,0 +1,69 @@
+#ifndef LOSSY_H
+#define LOSSY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "logger.h"
+
+// Optional lossy compression of a channel before it is stored. Only the rows
+// needed to rebuild the series within 'eps' are written (their indices show
+// the gaps); export fills the gaps again.
+//   deadband: a row is kept when it differs from the last kept one by more
+//             than eps; the gap is filled with the last kept value
+//   SDT:      swinging-door trending; the gap is filled by linear
+//             interpolation, and every dropped row is within eps of the line
+// Either way the first and the last row of a run are kept.
+#define LOSSY_TAG        "%lossy"              // first line of a lossy file: tag, channel, mode, eps
+#define LOSSY_CHANNELS   2                     // indexed by LOGGER_CH_ID_*
+
+typedef enum {
+    LOSSY_OFF,
+    LOSSY_DEADBAND,
+    LOSSY_SDT,
+} lossy_mode_t;
+
+typedef struct {
+    lossy_mode_t mode;
+    float eps;               // max. reconstruction error, in channel units
+} lossy_cfg_t;
+
+// Writer state for one run
+typedef struct {
+    lossy_cfg_t cfg;
+    bool     started;
+    uint32_t a_index;        // last kept row (SDT: the pivot of the doors)
+    float    a_value;
+    float    lo, hi;         // SDT: slopes still possible from the pivot
+    bool     have_prev;      // a row since the pivot that isn't stored yet
+    uint32_t p_index;
+    float    p_value;
+    uint32_t seen;
+    uint32_t kept;
+} lossy_state_t;
+
+// Reader state: fills the gaps between kept rows
+typedef struct {
+    lossy_mode_t mode;
+    bool     have;
+    uint32_t index;
+    float    value;
+} lossy_fill_t;
+
+// Receives the rows to store (writer) or the rebuilt series (reader)
+typedef void (*lossy_emit_fn)(uint32_t index, float value, void *ctx);
+
+void lossy_set(uint8_t ch_id, const lossy_cfg_t *cfg);
+void lossy_get(uint8_t ch_id, lossy_cfg_t *out);
+void lossy_begin(lossy_state_t *s, uint8_t ch_id);
+void lossy_feed(lossy_state_t *s, uint32_t index, float value, lossy_emit_fn emit, void *ctx);
+void lossy_end(lossy_state_t *s, lossy_emit_fn emit, void *ctx);
+
+int lossy_format(const logger_channel_t *ch, const lossy_cfg_t *cfg, char *buf, size_t len);
+const logger_channel_t *lossy_parse(const char *line, lossy_cfg_t *cfg);
+const char *lossy_mode_name(lossy_mode_t mode);
+bool lossy_parse_mode(const char *name, lossy_mode_t *out);
+float lossy_estimate(lossy_mode_t mode, uint32_t i0, float v0, uint32_t i1, float v1, uint32_t k);
+void lossy_fill(lossy_fill_t *f, uint32_t index, float value, lossy_emit_fn emit, void *ctx);
+
+#endif
@@ -5,6 +5,10 @@
 #include "esp_adc/adc_oneshot.h"
 #include "esp_spiffs.h"
 #include "fs_helpers.h"
+#include "logger.h"
+#include "blocklog.h"
+#include "compact.h"
+#include "console_cmds.h"
 
 /**
  * Mount SPIFFS, open/write/read files, log fake and real samples to CSV,
@@ -196,7 +200,7 @@ void app_main() {
 
     //---------------------------------------------------------
 
-    // Demo 3.3 Thermistor: CSV to Excel
+    /* Demo 3.3 Thermistor: CSV to Excel
     
     fs_mount_or_die(); // make /spiffs available
     adc_oneshot_setup(); // init ADC channel
@@ -214,5 +218,63 @@ void app_main() {
 
     // Unmount SPIFFS and end the program
     esp_vfs_spiffs_unregister(NULL);
+
+    */
+
+    //---------------------------------------------------------
+
+    /* Demo 3.4 Thermistor: live tail while logging
+
+    fs_mount_or_die();
+    adc_oneshot_setup();
+
+    // Log at 10 Hz in the background until we stop it
+    logger_start(&LOGGER_CH_THERMISTOR, TEMP_PATH, 0, 100 * 1000);
+
+    // Stream rows to the serial monitor for 30 s while the file keeps growing
+    logger_tail(30000);
+
+    logger_stop();
+    esp_vfs_spiffs_unregister(NULL);
+
+    */
+
+    //---------------------------------------------------------
+
+    /* Demo 3.5 Thermistor: raw block log + zero-copy export
+
+    fs_mount_or_die();
+    adc_oneshot_setup();
+
+    // 200 samples at 10 Hz into the "rawlog" partition instead of a SPIFFS file
+    log_thermistor_samples_csv(RAWLOG_PATH, 200, 100);
+
+    // Export straight from memory-mapped flash to the UART
+    blocklog_print_csv();
+    vTaskDelay(pdMS_TO_TICKS(2000));
+
+    // Compare against the SPIFFS + stdio export path (overwrites the raw log)
+    blocklog_bench_export(5000);
+    esp_vfs_spiffs_unregister(NULL);
+
+    */
+
+    //---------------------------------------------------------
+
+    // Demo 4: interactive shell
+    // Type "help" in the serial monitor. Logging, export, stats and benchmarks
+    // are all commands, so nothing needs to be reflashed to change what runs.
+
+    nvs_init_or_die(); // checkpoints and settings live in NVS
+    fs_mount_or_die(); // make /spiffs available
+    fs_gc_start(); // keep SPIFFS garbage collection out of the logger's writes
+    compact_start(); // rewrite closed CSV logs into compact segments in the background
+    adc_oneshot_setup(); // init ADC channels
+
+    // Continue an open-ended raw log run from before the reboot (start <ch> <ms> 0 raw);
+    // the log prints how long locating the append point took and when the first sample came
+    logger_resume();
+
+    console_start(); // REPL runs in its own task; app_main can return
     
 }
\ No newline at end of file
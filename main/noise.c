@@ -0,0 +1,181 @@
+/**
+ * @file noise.c
+ * @brief Noise-adaptive averaging: pick each channel's ADC read count from its measured noise.
+ *
+ * Every sample used to be the mean of SAMPLES = 8 reads, whatever the
+ * channel. A quiet channel wastes most of them (two reads already give the
+ * resolution it has), while a noisy one would need more than eight. The
+ * standard error of a mean of k reads is sigma / sqrt(k), so for a target
+ * error se the smallest sufficient count is k = sigma^2 / se^2.
+ *
+ * The ISR stays integer-only: besides the mean it returns m2, the sum of the
+ * squared deviations of its reads. The storage loop turns m2 / (k - 1) into
+ * a running variance estimate and writes the next read count back into the
+ * channel's acquisition state, where the ISR picks it up on its next tick.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_timer.h"
+#include "fs_helpers.h"
+#include "noise.h"
+
+static noise_cfg_t cfgs[NOISE_CHANNELS];
+static noise_stats_t stats[NOISE_CHANNELS];
+
+/**
+ * @brief Set (or with cfg->enabled = false, clear) adaptive averaging of a channel.
+ *
+ * Used from the next run of that channel on.
+ */
+void noise_set(uint8_t ch_id, const noise_cfg_t *cfg) {
+    if (ch_id >= NOISE_CHANNELS) {
+        return;
+    }
+    noise_cfg_t c = *cfg;
+    c.min_reads = c.min_reads < 1 ? 1 : c.min_reads;
+    c.max_reads = c.max_reads > NOISE_READS_MAX || c.max_reads == 0 ? NOISE_READS_MAX : c.max_reads;
+    c.min_reads = c.min_reads > c.max_reads ? c.max_reads : c.min_reads;
+    cfgs[ch_id] = c;
+}
+
+void noise_get(uint8_t ch_id, noise_cfg_t *out) {
+    if (ch_id < NOISE_CHANNELS) {
+        *out = cfgs[ch_id];
+    } else {
+        memset(out, 0, sizeof *out);
+    }
+}
+
+static void noise_init(noise_state_t *n, const noise_cfg_t *cfg, uint32_t budget_us) {
+    memset(n, 0, sizeof *n);
+    n->cfg = *cfg;
+    // The reads of one sample must fit in the time the caller can spare for them
+    uint32_t cap = budget_us / NOISE_READ_US;
+    if (n->cfg.max_reads > cap) {
+        n->cfg.max_reads = cap < 1 ? 1 : cap;
+    }
+    if (n->cfg.min_reads > n->cfg.max_reads) {
+        n->cfg.min_reads = n->cfg.max_reads;
+    }
+    // Until the noise is known: the fixed count, within the limits
+    uint32_t k = NOISE_PROBE_READS;
+    k = k < n->cfg.min_reads ? n->cfg.min_reads : k;
+    n->reads_next = k > n->cfg.max_reads ? n->cfg.max_reads : k;
+}
+
+/**
+ * @brief Start a run of a channel with its configuration.
+ *
+ * 'budget_us' is the ADC time one sample of the channel may take; it caps the
+ * read count. The timer ISR reads every channel due on a tick in that tick,
+ * so the caller shares the tick between the channels that can fall due together.
+ */
+void noise_begin(noise_state_t *n, uint8_t ch_id, uint32_t budget_us) {
+    noise_cfg_t cfg;
+    noise_get(ch_id, &cfg);
+    noise_init(n, &cfg, budget_us);
+    if (ch_id < NOISE_CHANNELS) {
+        memset(&stats[ch_id], 0, sizeof stats[ch_id]);
+        stats[ch_id].cfg = n->cfg;
+    }
+}
+
+/**
+ * @brief Account for one sample of 'reads' reads with spread 'm2' and choose the next count.
+ */
+static uint32_t noise_step(noise_state_t *n, uint32_t reads, uint32_t m2) {
+    n->samples++;
+    n->reads += reads;
+    if (reads >= 2) {
+        float s2 = (float)m2 / (reads - 1);
+        n->var = n->have_var ? n->var + (s2 - n->var) / NOISE_SMOOTH : s2;
+        n->have_var = true;
+    }
+    if (n->have_var) {
+        n->se_sum += sqrtf(n->var / reads);
+    }
+
+    uint32_t k = n->reads_next;
+    if (n->have_var) {
+        float se2 = n->cfg.se_lsb * n->cfg.se_lsb;
+        float want = se2 > 0 ? ceilf(n->var / se2) : n->cfg.max_reads;
+        k = want < n->cfg.min_reads ? n->cfg.min_reads : (want > n->cfg.max_reads ? n->cfg.max_reads : (uint32_t)want);
+    }
+    // Single reads carry no noise information: probe now and then
+    if (k < 2 && n->cfg.max_reads >= 2 && ++n->since_probe >= NOISE_PROBE_EVERY) {
+        n->since_probe = 0;
+        n->probes++;
+        k = NOISE_PROBE_READS > n->cfg.max_reads ? n->cfg.max_reads : NOISE_PROBE_READS;
+    }
+    n->reads_next = k;
+    return k;
+}
+
+/**
+ * @brief Feed one sample of a channel (storage loop only); returns the read count for the next one.
+ */
+uint32_t noise_update(noise_state_t *n, uint8_t ch_id, uint32_t reads, uint32_t m2) {
+    uint32_t k = noise_step(n, reads, m2);
+    if (ch_id < NOISE_CHANNELS) {
+        noise_stats_t *s = &stats[ch_id];
+        s->samples = n->samples;
+        s->reads = n->reads;
+        s->probes = n->probes;
+        s->reads_now = k;
+        s->sigma_lsb = sqrtf(n->var);
+        s->se_lsb = n->samples ? (float)(n->se_sum / n->samples) : 0;
+    }
+    return k;
+}
+
+/**
+ * @brief Counters of a channel's current or last run with adaptive averaging.
+ */
+void noise_get_stats(uint8_t ch_id, noise_stats_t *out) {
+    if (ch_id < NOISE_CHANNELS) {
+        *out = stats[ch_id];
+    } else {
+        memset(out, 0, sizeof *out);
+    }
+}
+
+/**
+ * @brief Take 'samples' samples of a channel with SAMPLES reads each, then with adaptive counts.
+ *
+ * Reports the conversions and the ADC time of both, and the spread of the
+ * resulting samples (their standard deviation, which for a steady input is
+ * the standard error actually achieved). Leave the input alone meanwhile.
+ * Must not run while the logger does (the ISR read path takes no lock).
+ */
+void noise_bench(const logger_channel_t *ch, float se_lsb, int samples) {
+    noise_cfg_t cfg = { .enabled = true, .se_lsb = se_lsb, .min_reads = 1, .max_reads = NOISE_READS_MAX };
+    printf("[*] %s: %d samples, target standard error %.2f LSB\n", ch->name, samples, se_lsb);
+
+    for (int adaptive = 0; adaptive <= 1; adaptive++) {
+        noise_state_t n;
+        noise_init(&n, &cfg, UINT32_MAX);
+        uint32_t reads = 0;
+        int64_t adc_us = 0;
+        double mean = 0, m2s = 0;
+        for (int i = 0; i < samples; i++) {
+            uint32_t k = adaptive ? n.reads_next : SAMPLES;
+            uint32_t m2;
+            int64_t t0 = esp_timer_get_time();
+            int raw = adc_read_avg_isr(ch->channel, (int)k, &m2);
+            adc_us += esp_timer_get_time() - t0;
+            reads += k;
+            noise_step(&n, k, m2);
+
+            double d = raw - mean;
+            mean += d / (i + 1);
+            m2s += d * (raw - mean);
+        }
+        printf("    %-9s %6u reads (%.2f per sample), ADC %lld us (%.2f us per read), "
+               "sample sd %.3f LSB, read sigma %.3f LSB\n",
+               adaptive ? "adaptive" : "fixed", (unsigned)reads, (double)reads / samples,
+               (long long)adc_us, reads ? (double)adc_us / reads : 0.0,
+               samples > 1 ? sqrt(m2s / (samples - 1)) : 0.0, sqrtf(n.var));
+    }
+}
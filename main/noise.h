@@ -0,0 +1,64 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "logger.h"
+
+// Noise-adaptive averaging: instead of a fixed SAMPLES reads per sample, the
+// storage loop picks each channel's read count from the spread of the reads it
+// just got, so that the standard error of the averaged code meets 'se_lsb'
+// with as few ADC conversions as possible:
+//
+//   reads = ceil(sigma^2 / se_lsb^2), clamped to [min_reads, max_reads]
+//
+// sigma^2 is a running estimate of the per-read variance. A sample of a
+// single read says nothing about the noise, so while a channel gets away with
+// one read every NOISE_PROBE_EVERY-th sample takes NOISE_PROBE_READS reads.
+#define NOISE_CHANNELS      2                  // indexed by LOGGER_CH_ID_*
+#define NOISE_READS_MAX     64                 // sum of squares of 12-bit reads fits in 32 bits
+#define NOISE_PROBE_EVERY   16
+#define NOISE_PROBE_READS   8                  // = SAMPLES, the fixed count
+#define NOISE_SMOOTH        16                 // variance estimate: exponential average over ~16 samples
+#define NOISE_READ_US       20                 // assumed cost of one read when capping reads by the tick
+
+typedef struct {
+    bool     enabled;
+    float    se_lsb;         // target standard error of a sample, in ADC codes
+    uint16_t min_reads;
+    uint16_t max_reads;
+} noise_cfg_t;
+
+// Controller state of one channel for one run (storage loop only)
+typedef struct {
+    noise_cfg_t cfg;
+    float    var;            // per-read variance estimate (codes^2)
+    bool     have_var;
+    uint32_t reads_next;     // read count the ISR should use from now on
+    uint32_t since_probe;
+    uint32_t samples;
+    uint32_t reads;          // conversions done
+    uint32_t probes;
+    double   se_sum;         // achieved standard error, summed over the samples
+} noise_state_t;
+
+typedef struct {
+    noise_cfg_t cfg;
+    uint32_t samples;
+    uint32_t reads;
+    uint32_t probes;
+    uint32_t reads_now;      // current read count
+    float    sigma_lsb;      // noise of a single read
+    float    se_lsb;         // mean achieved standard error of a sample
+} noise_stats_t;
+
+void noise_set(uint8_t ch_id, const noise_cfg_t *cfg);
+void noise_get(uint8_t ch_id, noise_cfg_t *out);
+void noise_begin(noise_state_t *n, uint8_t ch_id, uint32_t budget_us);
+uint32_t noise_update(noise_state_t *n, uint8_t ch_id, uint32_t reads, uint32_t m2);
+void noise_get_stats(uint8_t ch_id, noise_stats_t *out);
+
+// Sample a channel with SAMPLES reads and with adaptive reads; compare ADC time and spread
+void noise_bench(const logger_channel_t *ch, float se_lsb, int samples);
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * @file pool.c
+ * @brief Fixed-size block pool with a lock-free, ISR-safe free list.
+ *
+ * The free blocks form a singly linked list (a Treiber stack): the first word
+ * of a free block holds the index of the next one, the pool's 'head' word the
+ * index of the first. Allocation pops and freeing pushes with one 32-bit
+ * compare-and-swap each, retried if another core or an interrupt got there
+ * first. No critical section, so interrupts are never masked and neither side
+ * ever waits for the other.
+ *
+ * A pop reads the next index from the head block before its CAS. If the
+ * block is popped, reused and pushed back in between, the head index looks
+ * unchanged but the link read is stale (the ABA problem); the upper 16 bits of
+ * 'head' count every change, so that CAS fails and the pop is retried.
+ *
+ * Everything the ISR path touches is in IRAM/DRAM, so blocks can be taken
+ * while the flash cache is disabled.
+ */
+
+#include <string.h>
+#include "esp_attr.h"
+#include "pool.h"
+
+FORCE_INLINE_ATTR uint32_t *pool_link(pool_t *p, uint16_t index) {
+    return (uint32_t *)(p->mem + (size_t)index * p->block_size);
+}
+
+/**
+ * @brief Set up a pool over 'count' blocks of 'block_size' bytes at 'mem'; all blocks free.
+ *
+ * Not thread-safe: call before the pool is shared.
+ */
+void pool_init(pool_t *p, const char *name, void *mem, size_t block_size, size_t count) {
+    memset(p, 0, sizeof *p);
+    p->name = name;
+    p->mem = mem;
+    p->block_size = (uint16_t)((block_size + 3) & ~(size_t)3);
+    p->count = (uint16_t)(count < POOL_MAX_BLOCKS ? count : POOL_MAX_BLOCKS - 1);
+    for (uint16_t i = 0; i < p->count; i++) {
+        *pool_link(p, i) = i + 1 < p->count ? i + 1 : POOL_NIL;
+    }
+    p->head = p->count ? 0 : POOL_NIL;
+}
+
+/**
+ * @brief Take a free block. Safe from ISRs; never blocks.
+ *
+ * @return the block, or NULL if all are in use (counted in 'exhausted')
+ */
+void * IRAM_ATTR pool_alloc(pool_t *p) {
+    uint32_t old = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+    uint32_t index;
+    for (;;) {
+        index = old & 0xFFFF;
+        if (index == POOL_NIL) {
+            __atomic_fetch_add(&p->exhausted, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        uint32_t next = __atomic_load_n(pool_link(p, (uint16_t)index), __ATOMIC_RELAXED) & 0xFFFF;
+        uint32_t new = (old & 0xFFFF0000) + 0x10000 + next;
+        if (__atomic_compare_exchange_n(&p->head, &old, new, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    __atomic_fetch_add(&p->allocs, 1, __ATOMIC_RELAXED);
+    uint32_t used = __atomic_add_fetch(&p->in_use, 1, __ATOMIC_RELAXED);
+    uint32_t peak = __atomic_load_n(&p->peak, __ATOMIC_RELAXED);
+    while (used > peak && !__atomic_compare_exchange_n(&p->peak, &peak, used, false,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return p->mem + (size_t)index * p->block_size;
+}
+
+/**
+ * @brief Return a block taken with pool_alloc(). Safe from ISRs; never blocks.
+ */
+void IRAM_ATTR pool_free(pool_t *p, void *block) {
+    if (!block) {
+        return;
+    }
+    uint16_t index = (uint16_t)(((uint8_t *)block - p->mem) / p->block_size);
+    uint32_t old = __atomic_load_n(&p->head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(pool_link(p, index), old & 0xFFFF, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&p->head, &old, (old & 0xFFFF0000) + 0x10000 + index,
+                                          false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&p->frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&p->in_use, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Copy of a pool's counters.
+ */
+void pool_get_stats(const pool_t *p, pool_stats_t *out) {
+    out->name = p->name;
+    out->block_size = p->block_size;
+    out->count = p->count;
+    out->in_use = __atomic_load_n(&p->in_use, __ATOMIC_RELAXED);
+    out->peak = __atomic_load_n(&p->peak, __ATOMIC_RELAXED);
+    out->allocs = __atomic_load_n(&p->allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&p->frees, __ATOMIC_RELAXED);
+    out->exhausted = __atomic_load_n(&p->exhausted, __ATOMIC_RELAXED);
+}
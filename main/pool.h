@@ -0,0 +1,45 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fixed-size block pool: 'count' blocks of 'block_size' bytes in static
+// storage supplied by the owner, handed out and taken back through a
+// lock-free free list. pool_alloc()/pool_free() never block and may be called
+// from ISRs and tasks on either core, so pipeline stages can pass block
+// pointers to each other instead of copying data, without touching the heap.
+#define POOL_NIL        0xFFFF               // end of the free list
+#define POOL_MAX_BLOCKS 0xFFFF
+
+typedef struct {
+    const char *name;
+    uint8_t  *mem;           // count * block_size bytes (owner's static storage)
+    uint16_t block_size;     // >= 4 and a multiple of 4: a free block keeps the list link in its first word
+    uint16_t count;
+    uint32_t head;           // free list: (tag << 16) | index of the first free block; the tag defeats ABA
+    uint32_t in_use;
+    uint32_t peak;           // most blocks in use at once
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t exhausted;      // pool_alloc() calls that found no free block
+} pool_t;
+
+typedef struct {
+    const char *name;
+    uint16_t block_size;
+    uint16_t count;
+    uint32_t in_use;
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t exhausted;
+} pool_stats_t;
+
+void pool_init(pool_t *p, const char *name, void *mem, size_t block_size, size_t count);
+void *pool_alloc(pool_t *p);                 // NULL when exhausted
+void pool_free(pool_t *p, void *block);
+void pool_get_stats(const pool_t *p, pool_stats_t *out);
+
+#endif
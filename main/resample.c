@@ -0,0 +1,261 @@
+/**
+ * @file resample.c
+ * @brief Streaming resampler: merge channel logs onto one time grid for export.
+ *
+ * Channels logged at different rates (see logger_run_multi()) end up in
+ * separate files with their own row numbering, while the Excel users of
+ * print_csv_file_only() want one table with a time column. The resampler
+ * walks a common grid t_k = k * grid_us and pulls rows from every file only as
+ * far as the current grid point needs, so each channel keeps just the one or
+ * two samples around it plus its file reader:
+ *
+ *   linear:   straight line between the samples just before and after t_k
+ *   hold:     the last sample at or before t_k (zero-order hold)
+ *   decimate: weighted mean of the samples within one grid step of t_k, with
+ *             weight 1 - |t - t_k| / grid_us. Downsampling by plain picking
+ *             would alias noise above half the grid rate into the result;
+ *             the triangular window (two boxcars in a row) suppresses it.
+ *             Every sample falls between two grid points and only feeds those
+ *             two, so two accumulators per channel are enough.
+ *
+ * Decimation only makes sense for channels sampled faster than the grid;
+ * slower channels are interpolated linearly instead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "fs_helpers.h"
+#include "resample.h"
+
+// One input file on its way to the grid
+typedef struct {
+    fs_rows_t rows;
+    const logger_channel_t *ch;
+    uint32_t period_us;
+    resample_mode_t mode;      // effective mode of this channel
+    int decimals;              // as in the channel's row format
+    bool eof;
+    bool have_prev, have_next;
+    int64_t prev_t, next_t;    // sample times (us since the start of the run)
+    float prev_v, next_v;
+    int64_t last_t;            // time of the last sample read, -1 = none yet
+    double acc, wsum;          // decimate: the current grid point
+    double acc_nx, wsum_nx;    // decimate: the next one
+} resample_src_t;
+
+static resample_src_t src[RESAMPLE_SOURCES_MAX];
+static resample_stats_t stats;
+
+/**
+ * @brief Read the next sample of a source into 'next'.
+ */
+static bool resample_pull(resample_src_t *s) {
+    uint32_t index;
+    float v;
+    if (s->eof || !fs_rows_next(&s->rows, &index, &v)) {
+        s->eof = true;
+        return false;
+    }
+    s->next_t = (int64_t)index * s->period_us;
+    s->next_v = v;
+    s->have_next = true;
+    s->last_t = s->next_t;
+    stats.rows_in++;
+    return true;
+}
+
+/**
+ * @brief Value of a linear or hold source at grid time 't'.
+ *
+ * @return false if the source has no value there (before its first or after its last sample)
+ */
+static bool resample_interp(resample_src_t *s, int64_t t, float *out) {
+    // Move the pair of samples forward until prev_t <= t < next_t
+    while ((s->have_next || resample_pull(s)) && s->next_t <= t) {
+        s->prev_t = s->next_t;
+        s->prev_v = s->next_v;
+        s->have_prev = true;
+        s->have_next = false;
+    }
+    if (!s->have_prev) {
+        return false;
+    }
+    if (s->mode == RESAMPLE_HOLD) {
+        // Past the last sample the value only holds for one more period
+        if (!s->have_next && t >= s->prev_t + s->period_us) {
+            return false;
+        }
+        *out = s->prev_v;
+        return true;
+    }
+    if (t == s->prev_t) {
+        *out = s->prev_v;
+        return true;
+    }
+    if (!s->have_next) {
+        return false;
+    }
+    *out = s->prev_v + (s->next_v - s->prev_v) * (float)(t - s->prev_t) / (float)(s->next_t - s->prev_t);
+    return true;
+}
+
+/**
+ * @brief Anti-alias filtered value of a decimating source at grid time 't'.
+ *
+ * Adds the samples in [t, t + grid) to this grid point and the next one;
+ * those in (t - grid, t) were already added while computing the previous one.
+ */
+static bool resample_decimate(resample_src_t *s, int64_t t, uint32_t grid_us, float *out) {
+    while ((s->have_next || resample_pull(s)) && s->next_t < t + grid_us) {
+        double w = (double)(s->next_t - t) / grid_us;
+        if (w >= 0) {
+            s->acc += (1.0 - w) * s->next_v;
+            s->wsum += 1.0 - w;
+            s->acc_nx += w * s->next_v;
+            s->wsum_nx += w;
+        }
+        s->have_next = false;
+    }
+    bool ok = s->wsum > 0;
+    if (ok) {
+        *out = (float)(s->acc / s->wsum);
+    }
+    s->acc = s->acc_nx;
+    s->wsum = s->wsum_nx;
+    s->acc_nx = s->wsum_nx = 0;
+    return ok;
+}
+
+/**
+ * @brief True once a source can't contribute to grid time 't' or any later one.
+ */
+static bool resample_done(const resample_src_t *s, int64_t t, uint32_t grid_us) {
+    if (!s->eof || s->have_next) {
+        return false;
+    }
+    switch (s->mode) {
+    case RESAMPLE_HOLD:     return t >= s->last_t + s->period_us;
+    case RESAMPLE_DECIMATE: return t >= s->last_t + grid_us;
+    default:                return t > s->last_t;
+    }
+}
+
+/**
+ * @brief Length of a row after an snprintf() into a 'size'-byte buffer.
+ *
+ * snprintf() returns the length it would have written, so a value wider than
+ * expected (e.g. a huge float) would push the next write past the buffer;
+ * the row is cut short instead.
+ */
+static int resample_fit(int len, size_t size) {
+    return len < 0 ? 0 : (size_t)len >= size ? (int)size - 1 : len;
+}
+
+/**
+ * @brief Number of decimals printed by a row format ("%.3f" -> 3).
+ */
+static int resample_decimals(const char *row_fmt) {
+    const char *p = strstr(row_fmt, "%.");
+    return p && p[2] >= '0' && p[2] <= '9' ? p[2] - '0' : 4;
+}
+
+/**
+ * @brief Print 'n' logs as one CSV table on a grid of 'grid_us'.
+ *
+ * Header "time_s,<column of each log>", then one row per grid point while any
+ * log still has data; a channel without a value at a grid point (not started
+ * yet, or already ended) gets an empty cell. ESP-IDF logs are suppressed so the
+ * output is pure CSV, as with print_csv_file_only().
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for bad parameters, ESP_ERR_NOT_FOUND if a log can't be read
+ */
+esp_err_t resample_export(const resample_src_cfg_t *srcs, int n, uint32_t grid_us, resample_mode_t mode) {
+    if (n < 1 || n > RESAMPLE_SOURCES_MAX || grid_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&stats, 0, sizeof stats);
+    int64_t t0 = esp_timer_get_time();
+
+    for (int i = 0; i < n; i++) {
+        resample_src_t *s = &src[i];
+        memset(s, 0, sizeof *s);
+        if (srcs[i].period_us == 0 || !fs_rows_open(&s->rows, srcs[i].path)) {
+            esp_err_t err = srcs[i].period_us == 0 ? ESP_ERR_INVALID_ARG : ESP_ERR_NOT_FOUND;
+            while (--i >= 0) {
+                fs_rows_close(&src[i].rows);
+            }
+            return err;
+        }
+        s->ch = s->rows.ch;
+        s->period_us = srcs[i].period_us;
+        s->mode = mode == RESAMPLE_DECIMATE && s->period_us >= grid_us ? RESAMPLE_LINEAR : mode;
+        s->decimals = resample_decimals(s->ch->row_fmt);
+        s->last_t = -1;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    printf("time_s");
+    for (int i = 0; i < n; i++) {
+        const char *col = strchr(src[i].ch->csv_header, ',');
+        printf(",%s", col ? col + 1 : src[i].ch->name);
+    }
+    printf("\n");
+
+    char row[32 + RESAMPLE_SOURCES_MAX * 16];
+    for (int64_t t = 0;; t += grid_us) {
+        int len = resample_fit(snprintf(row, sizeof row, grid_us % 1000 == 0 ? "%.3f" : "%.6f", t / 1e6), sizeof row);
+        bool any = false, done = true;
+        for (int i = 0; i < n; i++) {
+            resample_src_t *s = &src[i];
+            float v;
+            bool ok = s->mode == RESAMPLE_DECIMATE ? resample_decimate(s, t, grid_us, &v)
+                                                   : resample_interp(s, t, &v);
+            if (ok) {
+                len = resample_fit(len + snprintf(row + len, sizeof row - len, ",%.*f", s->decimals, v), sizeof row);
+                any = true;
+            } else {
+                len = resample_fit(len + snprintf(row + len, sizeof row - len, ","), sizeof row);
+            }
+            done = done && resample_done(s, t, grid_us);
+        }
+        if (any) {
+            printf("%s\n", row);
+            stats.rows_out++;
+        }
+        if (done) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        fs_rows_close(&src[i].rows);
+    }
+    stats.sources = n;
+    stats.state_bytes = n * sizeof src[0];
+    stats.elapsed_us = esp_timer_get_time() - t0;
+    return ESP_OK;
+}
+
+/**
+ * @brief Counters of the last export.
+ */
+void resample_get_stats(resample_stats_t *out) {
+    *out = stats;
+}
+
+/**
+ * @brief Resampling mode from its console name.
+ */
+bool resample_parse_mode(const char *name, resample_mode_t *out) {
+    static const char *names[] = { "linear", "hold", "decimate" };
+    for (int i = 0; i < (int)(sizeof names / sizeof names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (resample_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Export several channel logs as one CSV table on a common time grid, e.g. a
+// 100 Hz pot log and a 1 Hz thermistor log as one row every 100 ms. Row i of
+// a log was taken at i * period_us after the start of the run (runs started
+// with 'multi' sample all channels on their first tick). Files are streamed
+// through fs_rows_next(), so memory use doesn't depend on their size.
+#define RESAMPLE_SOURCES_MAX   4
+
+typedef enum {
+    RESAMPLE_LINEAR,         // straight line between the samples around a grid point
+    RESAMPLE_HOLD,           // last sample at or before the grid point
+    RESAMPLE_DECIMATE,       // anti-alias filtered: triangular window of +-one grid step
+} resample_mode_t;
+
+typedef struct {
+    const char *path;        // CSV log (plain, lazy, lossy or compacted)
+    uint32_t period_us;      // sample period it was logged with
+} resample_src_cfg_t;
+
+typedef struct {
+    uint32_t sources;
+    uint32_t rows_in;        // samples read from all files
+    uint32_t rows_out;       // grid rows printed
+    uint32_t state_bytes;    // RAM used by the resampler, file readers included
+    int64_t  elapsed_us;
+} resample_stats_t;
+
+esp_err_t resample_export(const resample_src_cfg_t *srcs, int n, uint32_t grid_us, resample_mode_t mode);
+void resample_get_stats(resample_stats_t *out);
+bool resample_parse_mode(const char *name, resample_mode_t *out);
+
+#endif
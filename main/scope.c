@@ -0,0 +1,135 @@
+/**
+ * @file scope.c
+ * @brief Burst capture: sample at kHz rates, store only the samples around trigger events.
+ *
+ * At the default 0.5 Hz a fast pot movement or a thermal transient falls
+ * between two samples. Sampling every channel at kHz rates all the time would
+ * fill the flash in minutes, though, and most of it would show nothing. In
+ * scope mode the logger runs at a fast rate but hands every sample to
+ * scope_feed() instead of storing it:
+ *
+ *   armed:      the sample goes into the pre-trigger ring (the last 'pre'
+ *               samples are always available) and is checked against the
+ *               trigger;
+ *   triggered:  the ring is flushed to storage oldest first, followed by the
+ *               trigger sample and the next 'post' - 1 samples, then the
+ *               trigger re-arms with an empty ring.
+ *
+ * Only the storage loop calls scope_begin()/scope_feed(), so the ring needs
+ * no locking; the post-trigger window also acts as the trigger hold-off.
+ */
+
+#include <string.h>
+#include "scope.h"
+
+static scope_cfg_t next_cfg;           // set by scope_set(), picked up by the next run
+static scope_stats_t st;               // current run (st.cfg is the run's configuration)
+
+static scope_sample_t ring[SCOPE_RING_LEN];
+static uint32_t ring_head;             // samples ever put into the ring since it was emptied
+static uint32_t post_left;             // samples still to keep after a trigger
+static bool have_prev;
+static float prev;
+
+/**
+ * @brief Configure burst capture for the next run (NULL or SCOPE_OFF = store every sample).
+ */
+void scope_set(const scope_cfg_t *cfg) {
+    scope_cfg_t c = { .trig = SCOPE_OFF };
+    if (cfg) {
+        c = *cfg;
+    }
+    if (c.pre > SCOPE_RING_LEN) {
+        c.pre = SCOPE_RING_LEN;
+    }
+    if (c.post > SCOPE_POST_MAX) {
+        c.post = SCOPE_POST_MAX;
+    }
+    if (c.post == 0) {
+        c.post = 1;   // at least the trigger sample
+    }
+    next_cfg = c;
+}
+
+bool scope_enabled(void) {
+    return next_cfg.trig != SCOPE_OFF;
+}
+
+/**
+ * @brief Start of a run: take over the configuration, empty the ring, arm the trigger.
+ */
+void scope_begin(void) {
+    memset(&st, 0, sizeof st);
+    st.cfg = next_cfg;
+    ring_head = 0;
+    post_left = 0;
+    have_prev = false;
+}
+
+/**
+ * @brief Check the trigger condition between the previous and the current value.
+ */
+static bool scope_fires(float v) {
+    if (!have_prev) {
+        return false;
+    }
+    float level = st.cfg.level;
+    switch (st.cfg.trig) {
+    case SCOPE_RISING:  return prev < level && v >= level;
+    case SCOPE_FALLING: return prev > level && v <= level;
+    case SCOPE_EITHER:  return (prev < level && v >= level) || (prev > level && v <= level);
+    case SCOPE_SLOPE:   return v - prev >= level || prev - v >= level;
+    case SCOPE_OFF:     break;
+    }
+    return false;
+}
+
+/**
+ * @brief Run one sample through the trigger; 'keep' is called for every sample to store.
+ */
+void scope_feed(const scope_sample_t *s, scope_keep_fn keep, void *ctx) {
+    st.seen++;
+
+    if (post_left > 0) {
+        keep(s, ctx);
+        st.kept++;
+        post_left--;
+    } else if (scope_fires(s->value)) {
+        // Pre-trigger history first, oldest sample first
+        uint32_t n = ring_head < st.cfg.pre ? ring_head : st.cfg.pre;
+        for (uint32_t i = ring_head - n; i != ring_head; i++) {
+            keep(&ring[i % SCOPE_RING_LEN], ctx);
+        }
+        keep(s, ctx);
+        st.kept += n + 1;
+        st.events++;
+        post_left = st.cfg.post - 1;
+        ring_head = 0;
+    } else if (st.cfg.pre > 0) {
+        ring[ring_head++ % SCOPE_RING_LEN] = *s;
+    }
+
+    prev = s->value;
+    have_prev = true;
+}
+
+/**
+ * @brief Counters of the current (or last) run.
+ */
+void scope_get_stats(scope_stats_t *out) {
+    *out = st;
+}
+
+/**
+ * @brief Trigger type from its console name.
+ */
+bool scope_parse_trig(const char *name, scope_trig_t *out) {
+    static const char *names[] = { "off", "rising", "falling", "either", "slope" };
+    for (int i = 0; i < (int)(sizeof names / sizeof names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (scope_trig_t)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Burst capture ("oscilloscope mode"): a run samples fast but only keeps the
+// samples around trigger events. Every sample goes through a RAM ring of the
+// last SCOPE_RING_LEN samples; when the trigger fires, up to 'pre' of them plus
+// the next 'post' samples are stored, everything else is dropped.
+#define SCOPE_RING_LEN   512                 // max. pre-trigger samples (0.5 s at 1 kHz)
+#define SCOPE_POST_MAX   4096                // max. post-trigger samples
+
+typedef enum {
+    SCOPE_OFF,               // normal logging: every sample is stored
+    SCOPE_RISING,            // value crosses 'level' upwards
+    SCOPE_FALLING,           // value crosses 'level' downwards
+    SCOPE_EITHER,            // either crossing
+    SCOPE_SLOPE,             // |value - previous value| >= 'level' (units per sample)
+} scope_trig_t;
+
+typedef struct {
+    scope_trig_t trig;
+    float    level;          // trigger level, in the channel's units
+    uint16_t pre;            // samples kept before the trigger (<= SCOPE_RING_LEN)
+    uint16_t post;           // samples kept after it, trigger sample included (<= SCOPE_POST_MAX)
+} scope_cfg_t;
+
+// One sample as seen by the trigger
+typedef struct {
+    int64_t  t_us;           // capture time (esp_timer)
+    uint32_t seq;            // sample index within the run
+    float    value;          // converted value (the trigger needs it even in lazy mode)
+    uint16_t raw;            // averaged ADC code
+} scope_sample_t;
+
+typedef struct {
+    scope_cfg_t cfg;
+    uint32_t seen;           // samples taken this run
+    uint32_t kept;           // samples stored
+    uint32_t events;         // trigger events
+} scope_stats_t;
+
+// Receives the samples to store, in capture order
+typedef void (*scope_keep_fn)(const scope_sample_t *s, void *ctx);
+
+void scope_set(const scope_cfg_t *cfg);      // used by the next run; NULL = off
+bool scope_enabled(void);
+void scope_begin(void);                      // start of a run: empty ring, trigger armed
+void scope_feed(const scope_sample_t *s, scope_keep_fn keep, void *ctx);
+void scope_get_stats(scope_stats_t *out);
+bool scope_parse_trig(const char *name, scope_trig_t *out);
+
+#endif
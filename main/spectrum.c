@@ -0,0 +1,433 @@
+/**
+ * @file spectrum.c
+ * @brief Spectral analysis mode: FFT of fast sample blocks, stored as spectra or band powers.
+ *
+ * Mains hum and ADC noise are invisible in logs of 8-sample boxcar averages
+ * taken every few hundred ms: they alias into slow wander or average out. In
+ * spectrum mode the logger samples one channel at kHz rates (by default without
+ * oversampling) and hands every sample to spectrum_feed(), which collects
+ * blocks of n samples and per block:
+ *
+ *   1. removes the block mean (kept as its own column) and applies a periodic
+ *      Hann window against leakage between bins;
+ *   2. runs an n-point radix-2 FFT: ESP-DSP's dsps_fft2r_fc32() (assembly on
+ *      the S3) when the component is available, otherwise a portable scalar
+ *      version of the same algorithm, which also serves host-side checks;
+ *   3. adds |X_k|^2 to a per-bin power accumulator.
+ *
+ * Every 'avg' blocks one row is written: the amplitudes of bins 1..n/2,
+ * scaled so a sine of amplitude A reads A at its bin, or the RMS of 'bands'
+ * equal-width bands (noise of the whole band, from Parseval with the window's
+ * power sum). Averaging the power of several blocks (Welch) steadies the noise
+ * floor; band rows shrink the export to a few values per n * avg samples.
+ *
+ * Only the storage loop calls spectrum_begin()/spectrum_feed()/spectrum_end().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spectrum.h"
+#include "fs_helpers.h"
+
+#if __has_include("esp_dsp.h")
+#include "esp_dsp.h"
+#define SPECTRUM_HAVE_DSP 1
+#else
+#define SPECTRUM_HAVE_DSP 0
+#endif
+
+static const char *TAG = "SPECTRUM";
+
+static spectrum_cfg_t next_cfg;        // set by spectrum_set(), picked up by the next run
+static spectrum_stats_t st;            // current run (st.cfg is the run's configuration)
+
+static float blk[SPECTRUM_N_MAX];                          // samples of the block being filled
+static float fft_buf[2 * SPECTRUM_N_MAX] __attribute__((aligned(16)));   // re, im interleaved
+static float win[SPECTRUM_N_MAX];
+static float pwr[SPECTRUM_N_MAX / 2 + 1];                  // |X_k|^2 summed over the row's blocks
+static float win_sum, win_sq;          // sum of w and of w^2 (amplitude and power scaling)
+static uint32_t fill;                  // samples in 'blk'
+static uint32_t row_blocks;            // blocks in 'pwr'
+static double mean_sum;                // block means of the row
+static uint64_t fft_sum_us;
+
+static FILE *f;
+static char row[256];                  // rows are written in pieces: full spectra are long
+static size_t row_len;
+static bool row_cells;                 // the current row has cells already (next one needs a comma)
+
+#if SPECTRUM_HAVE_DSP
+static float fft_table[SPECTRUM_N_MAX] __attribute__((aligned(16)));   // twiddles for every n <= SPECTRUM_N_MAX (no malloc in dsps)
+static bool dsp_ready;
+#endif
+
+/**
+ * @brief Configure spectrum mode for the next run (NULL or n = 0 = off).
+ *
+ * Out-of-range values are clamped; n is rounded down to a power of two.
+ */
+void spectrum_set(const spectrum_cfg_t *cfg) {
+    spectrum_cfg_t c = { 0 };
+    if (cfg && cfg->n > 0) {
+        c = *cfg;
+        uint16_t n = SPECTRUM_N_MIN;
+        while (n * 2 <= c.n && n < SPECTRUM_N_MAX) {
+            n *= 2;
+        }
+        c.n = n;
+        c.avg = c.avg ? c.avg : 1;
+        c.bands = c.bands > SPECTRUM_BANDS_MAX ? SPECTRUM_BANDS_MAX : c.bands;
+        c.bands = c.bands > c.n / 2 ? c.n / 2 : c.bands;
+        c.oversample = c.oversample ? c.oversample : 1;
+    }
+    next_cfg = c;
+}
+
+bool spectrum_enabled(void) {
+    return next_cfg.n != 0;
+}
+
+/**
+ * @brief ADC reads per sample for the next run.
+ */
+int spectrum_oversample(void) {
+    return next_cfg.oversample;
+}
+
+/**
+ * @brief In-place radix-2 decimation-in-time FFT of 'n' interleaved complex values.
+ *
+ * Same structure as dsps_fft2r_fc32() followed by dsps_bit_rev_fc32(): output
+ * bins in natural order. The twiddle factor of each stage is advanced by a
+ * complex multiplication rather than a sinf()/cosf() per butterfly group.
+ */
+static void spectrum_fft_scalar(float *x, int n) {
+    // Bit-reversal permutation
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            float tr = x[2 * i], ti = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = tr;
+            x[2 * j + 1] = ti;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double a = -2 * M_PI / len;
+        float sr = (float)cos(a), si = (float)sin(a);
+        float wr = 1, wi = 0;
+        for (int k = 0; k < len / 2; k++) {
+            for (int i = k; i < n; i += len) {
+                int j = i + len / 2;
+                float tr = wr * x[2 * j] - wi * x[2 * j + 1];
+                float ti = wr * x[2 * j + 1] + wi * x[2 * j];
+                x[2 * j] = x[2 * i] - tr;
+                x[2 * j + 1] = x[2 * i + 1] - ti;
+                x[2 * i] += tr;
+                x[2 * i + 1] += ti;
+            }
+            float t = wr * sr - wi * si;
+            wi = wr * si + wi * sr;
+            wr = t;
+        }
+    }
+}
+
+/**
+ * @brief FFT of 'fft_buf' with the fastest implementation available.
+ */
+static void spectrum_fft(int n) {
+#if SPECTRUM_HAVE_DSP
+    if (dsp_ready) {
+        dsps_fft2r_fc32(fft_buf, n);
+        dsps_bit_rev_fc32(fft_buf, n);
+        return;
+    }
+#endif
+    spectrum_fft_scalar(fft_buf, n);
+}
+
+/**
+ * @brief Append one CSV cell to the row, writing out the part that is full.
+ */
+static void spectrum_put(const char *text) {
+    size_t len = strlen(text);
+    if (row_len + len + 2 > sizeof row) {
+        st.bytes += fwrite(row, 1, row_len, f);
+        row_len = 0;
+    }
+    row_len += snprintf(row + row_len, sizeof row - row_len, "%s%s", row_cells ? "," : "", text);
+    row_cells = true;
+}
+
+static void spectrum_put_float(float v) {
+    char cell[16];
+    snprintf(cell, sizeof cell, "%.5g", v);
+    spectrum_put(cell);
+}
+
+static void spectrum_end_row(void) {
+    row[row_len++] = '\n';
+    st.bytes += fwrite(row, 1, row_len, f);
+    row_len = 0;
+    row_cells = false;
+}
+
+/**
+ * @brief First bin of band 'b' (bands cover bins 1..n/2).
+ */
+static int spectrum_band_lo(int b) {
+    return 1 + b * (st.cfg.n / 2) / st.cfg.bands;
+}
+
+/**
+ * @brief Write the CSV header: row, t_s, mean, then one column per bin or band.
+ */
+static void spectrum_header(void) {
+    float df = 1e6f / (st.period_us * (float)st.cfg.n);
+    char cell[32];
+    spectrum_put("row");
+    spectrum_put("t_s");
+    spectrum_put("mean");
+    if (st.cfg.bands == 0) {
+        for (int k = 1; k <= st.cfg.n / 2; k++) {
+            snprintf(cell, sizeof cell, "%.5gHz", k * df);
+            spectrum_put(cell);
+        }
+    } else {
+        for (int b = 0; b < st.cfg.bands; b++) {
+            snprintf(cell, sizeof cell, "rms_%.5g-%.5gHz", (spectrum_band_lo(b) - 0.5f) * df,
+                     (spectrum_band_lo(b + 1) - 0.5f) * df);
+            spectrum_put(cell);
+        }
+    }
+    spectrum_end_row();
+}
+
+/**
+ * @brief Write one row from the accumulated power of 'row_blocks' blocks.
+ */
+static void spectrum_write_row(void) {
+    int half = st.cfg.n / 2;
+    float df = 1e6f / (st.period_us * (float)st.cfg.n);
+    char cell[24];
+    snprintf(cell, sizeof cell, "%u", (unsigned)st.rows);
+    spectrum_put(cell);
+    // Start of the row's first block: rows follow each other without gaps
+    uint64_t first = (uint64_t)st.rows * st.cfg.avg * st.cfg.n;
+    snprintf(cell, sizeof cell, "%.6f", first * (double)st.period_us / 1e6);
+    spectrum_put(cell);
+    spectrum_put_float((float)(mean_sum / row_blocks));
+
+    // Amplitude of a sine at bin k: |X_k| = A * sum(w) / 2 (the Nyquist bin has no mirror)
+    float peak = 0;
+    int peak_k = 0;
+    for (int k = 1; k <= half; k++) {
+        float amp = sqrtf(pwr[k] / row_blocks) * (k < half ? 2 : 1) / win_sum;
+        if (amp > peak) {
+            peak = amp;
+            peak_k = k;
+        }
+        if (st.cfg.bands == 0) {
+            spectrum_put_float(amp);
+        }
+    }
+    if (st.cfg.bands > 0) {
+        // Mean square of the signal in a band: 2 * sum |X_k|^2 / (n * sum(w^2))
+        for (int b = 0; b < st.cfg.bands; b++) {
+            double ms = 0;
+            for (int k = spectrum_band_lo(b); k < spectrum_band_lo(b + 1); k++) {
+                ms += pwr[k] * (k < half ? 2.0 : 1.0);
+            }
+            spectrum_put_float((float)sqrt(ms / row_blocks / (st.cfg.n * (double)win_sq)));
+        }
+    }
+    spectrum_end_row();
+
+    st.rows++;
+    st.peak_hz = peak_k * df;
+    st.peak_amp = peak;
+    memset(pwr, 0, sizeof pwr);
+    mean_sum = 0;
+    row_blocks = 0;
+}
+
+/**
+ * @brief Start of a run: take over the configuration and open the output file.
+ *
+ * @return false if the file can't be created
+ */
+bool spectrum_begin(const logger_channel_t *ch, const char *path, uint32_t period_us) {
+    memset(&st, 0, sizeof st);
+    st.cfg = next_cfg;
+    st.period_us = period_us;
+    fill = 0;
+    row_blocks = 0;
+    mean_sum = 0;
+    fft_sum_us = 0;
+    row_len = 0;
+    row_cells = false;
+    memset(pwr, 0, sizeof pwr);
+
+#if SPECTRUM_HAVE_DSP
+    if (!dsp_ready) {
+        dsp_ready = dsps_fft2r_init_fc32(fft_table, SPECTRUM_N_MAX) == ESP_OK;
+        if (!dsp_ready) {
+            ESP_LOGW(TAG, "ESP-DSP FFT init failed, using the scalar FFT");
+        }
+    }
+    st.dsp = dsp_ready;
+#endif
+
+    // Periodic Hann window: the n-point DFT sees it as one smooth period
+    int n = st.cfg.n;
+    win_sum = win_sq = 0;
+    for (int i = 0; i < n; i++) {
+        win[i] = 0.5f - 0.5f * cosf(2 * (float)M_PI * i / n);
+        win_sum += win[i];
+        win_sq += win[i] * win[i];
+    }
+
+    fs_forget(path);
+    f = fopen(path, "w");
+    if (!f) {
+        printf("open for write failed: %s\n", path);
+        return false;
+    }
+    spectrum_header();
+    printf("[+] %s spectrum: %d-point FFT (%s), %u block(s) per row, %.2f Hz per bin, %s\n",
+           ch->name, n, st.dsp ? "ESP-DSP" : "scalar", (unsigned)st.cfg.avg,
+           1e6 / ((double)period_us * n),
+           st.cfg.bands ? "band RMS" : "amplitude per bin");
+    return true;
+}
+
+/**
+ * @brief Add one sample; a full block is transformed right away.
+ */
+void spectrum_feed(float value) {
+    if (!f) {
+        return;
+    }
+    st.samples++;
+    blk[fill++] = value;
+    if (fill < st.cfg.n) {
+        return;
+    }
+    fill = 0;
+
+    int64_t t0 = esp_timer_get_time();
+    int n = st.cfg.n;
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += blk[i];
+    }
+    float mean = (float)(sum / n);
+    for (int i = 0; i < n; i++) {
+        fft_buf[2 * i] = (blk[i] - mean) * win[i];
+        fft_buf[2 * i + 1] = 0;
+    }
+    spectrum_fft(n);
+    for (int k = 0; k <= n / 2; k++) {
+        pwr[k] += fft_buf[2 * k] * fft_buf[2 * k] + fft_buf[2 * k + 1] * fft_buf[2 * k + 1];
+    }
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    st.fft_max_us = dt > st.fft_max_us ? dt : st.fft_max_us;
+    fft_sum_us += dt;
+    st.blocks++;
+    st.fft_mean_us = (uint32_t)(fft_sum_us / st.blocks);
+
+    mean_sum += mean;
+    if (++row_blocks == st.cfg.avg) {
+        spectrum_write_row();
+    }
+}
+
+/**
+ * @brief End of the run: close the file. Samples of an incomplete row are dropped.
+ */
+void spectrum_end(void) {
+    if (!f) {
+        return;
+    }
+    fclose(f);
+    f = NULL;
+    ESP_LOGI(TAG, "%u rows from %u blocks (%u samples), %u bytes; FFT mean %u us, max %u us; "
+             "last peak %.2f Hz, amplitude %.4g",
+             (unsigned)st.rows, (unsigned)st.blocks, (unsigned)st.samples, (unsigned)st.bytes,
+             (unsigned)st.fft_mean_us, (unsigned)st.fft_max_us, st.peak_hz, st.peak_amp);
+}
+
+/**
+ * @brief Counters of the current or last spectrum run.
+ */
+void spectrum_get_stats(spectrum_stats_t *out) {
+    *out = st;
+}
+
+/**
+ * @brief Time the FFT implementations on a test signal and check they agree.
+ *
+ * The signal is a sine of amplitude 1 at bin 10 plus one of amplitude 0.01
+ * at bin 50; the scalar result is the reference for ESP-DSP.
+ */
+void spectrum_bench(int n) {
+    if (n < SPECTRUM_N_MIN || n > SPECTRUM_N_MAX || (n & (n - 1))) {
+        printf("n must be a power of two in %d..%d\n", SPECTRUM_N_MIN, SPECTRUM_N_MAX);
+        return;
+    }
+    const int reps = 20;
+    static float ref[2 * SPECTRUM_N_MAX];
+    for (int i = 0; i < n; i++) {
+        ref[2 * i] = sinf(2 * (float)M_PI * 10 * i / n) + 0.01f * sinf(2 * (float)M_PI * 50 * i / n);
+        ref[2 * i + 1] = 0;
+    }
+
+    int64_t t0, dt = 0;
+    for (int r = 0; r < reps; r++) {
+        memcpy(fft_buf, ref, 2 * n * sizeof(float));
+        t0 = esp_timer_get_time();
+        spectrum_fft_scalar(fft_buf, n);
+        dt += esp_timer_get_time() - t0;
+    }
+    memcpy(ref, fft_buf, 2 * n * sizeof(float));
+    printf("[*] %d-point FFT, scalar : %.1f us (bin 10 %.4f, bin 50 %.4f)\n", n, (double)dt / reps,
+           hypotf(ref[20], ref[21]) * 2 / n, hypotf(ref[100], ref[101]) * 2 / n);
+
+#if SPECTRUM_HAVE_DSP
+    if (!dsp_ready) {
+        dsp_ready = dsps_fft2r_init_fc32(fft_table, SPECTRUM_N_MAX) == ESP_OK;
+    }
+    if (dsp_ready) {
+        // Same input again (the scalar pass overwrote 'ref' with its output)
+        float diff = 0;
+        dt = 0;
+        for (int r = 0; r < reps; r++) {
+            for (int i = 0; i < n; i++) {
+                fft_buf[2 * i] = sinf(2 * (float)M_PI * 10 * i / n) + 0.01f * sinf(2 * (float)M_PI * 50 * i / n);
+                fft_buf[2 * i + 1] = 0;
+            }
+            t0 = esp_timer_get_time();
+            dsps_fft2r_fc32(fft_buf, n);
+            dsps_bit_rev_fc32(fft_buf, n);
+            dt += esp_timer_get_time() - t0;
+        }
+        for (int i = 0; i < 2 * n; i++) {
+            float d = fabsf(fft_buf[i] - ref[i]);
+            diff = d > diff ? d : diff;
+        }
+        printf("[*] %d-point FFT, ESP-DSP: %.1f us, max difference to scalar %.2g\n",
+               n, (double)dt / reps, diff);
+    }
+#else
+    printf("[*] ESP-DSP not available in this build, spectra use the scalar FFT\n");
+#endif
+}
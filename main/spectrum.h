@@ -0,0 +1,48 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "logger.h"
+
+// Spectral analysis mode: a single-channel run samples fast and, instead of
+// the samples, stores one row per 'avg' blocks of 'n' samples: the block mean
+// followed by either the amplitude of every FFT bin or the RMS of 'bands'
+// equal-width frequency bands. The file is a plain CSV table (one row per
+// spectrum), exported like any other log.
+#define SPECTRUM_N_MIN       64
+#define SPECTRUM_N_MAX       1024               // FFT length limit (static buffers)
+#define SPECTRUM_BANDS_MAX   32
+#define SPECTRUM_PERIOD_MIN  250                // us: 4 kHz, 2 kHz Nyquist
+
+typedef struct {
+    uint16_t n;              // FFT length (power of two, SPECTRUM_N_MIN..SPECTRUM_N_MAX); 0 = off
+    uint16_t avg;            // blocks averaged (power) per stored row, >= 1
+    uint16_t bands;          // 0 = every bin, else band RMS values (<= SPECTRUM_BANDS_MAX)
+    uint16_t oversample;     // ADC reads averaged per sample (1 = none: keep the noise visible)
+} spectrum_cfg_t;
+
+typedef struct {
+    spectrum_cfg_t cfg;
+    uint32_t period_us;
+    uint32_t samples;        // samples taken this run
+    uint32_t blocks;         // FFTs computed
+    uint32_t rows;           // rows stored
+    uint32_t bytes;          // CSV bytes written
+    uint32_t fft_max_us;     // slowest window + FFT + magnitude pass
+    uint32_t fft_mean_us;
+    float    peak_hz;        // strongest bin of the last row (DC excluded)
+    float    peak_amp;
+    bool     dsp;            // FFT done by ESP-DSP (false: scalar fallback)
+} spectrum_stats_t;
+
+void spectrum_set(const spectrum_cfg_t *cfg);    // used by the next run; NULL = off
+bool spectrum_enabled(void);
+int  spectrum_oversample(void);
+bool spectrum_begin(const logger_channel_t *ch, const char *path, uint32_t period_us);
+void spectrum_feed(float value);                 // storage loop only
+void spectrum_end(void);
+void spectrum_get_stats(spectrum_stats_t *out);
+void spectrum_bench(int n);
+
+#endif
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Compression ratio vs. max error of deadband and swinging-door compression.
+
+Runs the algorithms of main/lossy.c over recorded logs (CSV files exported with
+'cat' / 'export', or serial captures such as log.lab6.*.txt) and prints, for a
+range of eps values, how many rows and bytes each mode keeps and the error of
+the series rebuilt the way export does it (hold for deadband, linear
+interpolation for SDT).
+
+    python3 tools/lossy_report.py log.lab6.20251027121401.txt
+    python3 tools/lossy_report.py --eps 0.01,0.02,0.05 therm.csv
+
+The math is done in double precision, lossy.c uses float; the rows kept can
+differ by one at the edge of a door, the error bound is the same.
+"""
+
+import argparse
+import math
+import re
+import sys
+
+ROW = re.compile(r"^#(-?\d+),\s*([-+0-9.eE]+)")
+
+
+def load(path):
+    """(index, value, stored row length) of every data row of a log."""
+    rows = []
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = ROW.match(line)
+            if m:
+                rows.append((int(m.group(1)), float(m.group(2)), len(line.rstrip("\r\n").encode()) + 1))
+    return rows
+
+
+def deadband(rows, eps):
+    """Indices of the rows lossy.c stores in deadband mode."""
+    kept = [0]
+    a = rows[0][1]
+    for i in range(1, len(rows)):
+        if abs(rows[i][1] - a) > eps:
+            kept.append(i)
+            a = rows[i][1]
+    if kept[-1] != len(rows) - 1:
+        kept.append(len(rows) - 1)
+    return [(i, rows[i][1]) for i in kept]
+
+
+def sdt(rows, eps):
+    """(row, stored value) of the rows lossy.c stores in swinging-door mode."""
+    out = [(0, rows[0][1])]
+    ax, av = rows[0][0], rows[0][1]
+    lo, hi = -math.inf, math.inf
+    prev = None
+    for i in range(1, len(rows)):
+        x, v = rows[i][0], rows[i][1]
+        nlo = max(lo, (v - eps - av) / (x - ax))
+        nhi = min(hi, (v + eps - av) / (x - ax))
+        if nlo > nhi and prev is not None:
+            px = rows[prev][0]
+            pv = av + 0.5 * (lo + hi) * (px - ax)
+            out.append((prev, pv))
+            ax, av = px, pv
+            nlo = (v - eps - av) / (x - ax)
+            nhi = (v + eps - av) / (x - ax)
+        lo, hi = nlo, nhi
+        prev = i
+    if prev is not None:
+        out.append((prev, av + 0.5 * (lo + hi) * (rows[prev][0] - ax)))
+    return out
+
+
+def rebuild_error(rows, kept, linear):
+    """Max and mean error of the series rebuilt from the kept rows (as lossy_fill() does)."""
+    est = [0.0] * len(rows)
+    for (i, vi), (j, vj) in zip(kept, kept[1:]):
+        xi, xj = rows[i][0], rows[j][0]
+        for k in range(i, j):
+            est[k] = vi + (vj - vi) * (rows[k][0] - xi) / (xj - xi) if linear else vi
+    est[kept[-1][0]] = kept[-1][1]
+    errs = [abs(e - r[1]) for e, r in zip(est, rows)]
+    return max(errs), sum(errs) / len(errs)
+
+
+def default_eps(rows):
+    """Powers of two times the smallest step between values (about one LSB)."""
+    steps = [abs(b[1] - a[1]) for a, b in zip(rows, rows[1:]) if b[1] != a[1]]
+    lsb = min(steps) if steps else 0.01
+    return [lsb * 2 ** k for k in range(0, 8)]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("files", nargs="+", help="recorded logs ('#index, value' rows)")
+    ap.add_argument("--eps", help="comma-separated eps values (default: 1..128 x the smallest step)")
+    args = ap.parse_args()
+
+    for path in args.files:
+        rows = load(path)
+        if len(rows) < 2:
+            print(f"{path}: fewer than 2 data rows, skipped", file=sys.stderr)
+            continue
+        eps_list = [float(e) for e in args.eps.split(",")] if args.eps else default_eps(rows)
+        total_bytes = sum(r[2] for r in rows)
+
+        print(f"{path}: {len(rows)} rows, {total_bytes} bytes")
+        print(f"{'mode':9} {'eps':>9} {'rows':>7} {'ratio':>7} {'bytes':>8} {'ratio':>7} {'max err':>9} {'mean err':>9}")
+        for eps in eps_list:
+            for name, fn, linear in (("deadband", deadband, False), ("sdt", sdt, True)):
+                kept = fn(rows, eps)
+                err_max, err_mean = rebuild_error(rows, kept, linear)
+                nbytes = sum(rows[i][2] for i, _ in kept)
+                print(f"{name:9} {eps:9.4g} {len(kept):7d} {len(rows) / len(kept):6.2f}x "
+                      f"{nbytes:8d} {total_bytes / nbytes:6.2f}x {err_max:9.4g} {err_mean:9.4g}")
+        print()
+
+
+if __name__ == "__main__":
+    main()